@@ -14,3 +14,7 @@ AM_CPPFLAGS += -I"$(top_srcdir)/lib"			\
 if USE_POSTGRES
 AM_CPPFLAGS += -DUSE_POSTGRES=1 $(libpq_CFLAGS)
 endif # USE_POSTGRES
+
+if USE_ZLIB
+AM_CPPFLAGS += -DUSE_ZLIB=1 $(zlib_CFLAGS)
+endif # USE_ZLIB
@@ -8,6 +8,8 @@
 // else.
 #include "util/asio.h"
 #include "bucket/BucketApplicator.h"
+#include "bucket/BucketIndex.h"
+#include "bucket/BucketKeySet.h"
 #include "bucket/BucketList.h"
 #include "bucket/BucketManager.h"
 #include "bucket/LedgerCmp.h"
@@ -31,8 +33,13 @@
 #include "util/XDRStream.h"
 #include "util/make_unique.h"
 #include "xdrpp/message.h"
+#include "xdrpp/printer.h"
+#include <algorithm>
 #include <cassert>
+#include <fstream>
 #include <future>
+#include <limits>
+#include <map>
 
 namespace stellar
 {
@@ -52,8 +59,9 @@ randomBucketName(std::string const& tmpDir)
     }
 }
 
-Bucket::Bucket(std::string const& filename, Hash const& hash)
-    : mFilename(filename), mHash(hash)
+Bucket::Bucket(std::string const& filename, Hash const& hash,
+               std::shared_ptr<BucketIndex const> index)
+    : mFilename(filename), mHash(hash), mIndex(index)
 {
     assert(filename.empty() || fs::exists(filename));
     if (!filename.empty())
@@ -69,6 +77,10 @@ Bucket::~Bucket()
     {
         CLOG(TRACE, "Bucket") << "Bucket::~Bucket removing file: " << mFilename;
         std::remove(mFilename.c_str());
+        if (mIndex)
+        {
+            std::remove(BucketIndex::indexFilename(mFilename).c_str());
+        }
     }
 }
 
@@ -88,59 +100,178 @@ Bucket::getFilename() const
     return mFilename;
 }
 
+std::shared_ptr<BucketIndex const> const&
+Bucket::getIndex() const
+{
+    return mIndex;
+}
+
 void
 Bucket::setRetain(bool r)
 {
     mRetain = r;
 }
 
+size_t
+Bucket::decodeEntryKey(char const* data, size_t len, BucketEntryType& type,
+                       LedgerKey& key)
+{
+    // The XDR of a LedgerKey is a prefix of the XDR of the LedgerEntry's data
+    // it identifies: both start with the entry type, followed by the fields
+    // that make up the key (see Stellar-ledger.x). A live BucketEntry puts
+    // its own type and the entry's lastModifiedLedgerSeq in front of that; a
+    // dead one only its type.
+    xdr::xdr_get g(data, data + len);
+    xdr::xdr_argpack_archive(g, type);
+    size_t offset = 4;
+    if (type == LIVEENTRY)
+    {
+        uint32_t lastModified;
+        xdr::xdr_argpack_archive(g, lastModified);
+        offset += 4;
+    }
+    xdr::xdr_argpack_archive(g, key);
+    return offset;
+}
+
+std::shared_ptr<BucketKeySet const>
+Bucket::getKeySet() const
+{
+    std::lock_guard<std::mutex> lock(mKeySetMutex);
+    if (!mKeySet && !mFilename.empty())
+    {
+        mKeySet = BucketKeySet::build(mFilename);
+    }
+    return mKeySet;
+}
+
 /**
  * Helper class that reads from the file underlying a bucket, keeping the bucket
  * alive for the duration of its existence.
+ *
+ * Entries are read as raw records and only decoded on demand: `key` and
+ * `type` decode just the head of the record, and `operator*` the whole entry.
+ * Code that only needs to order entries and copy them through unchanged (such
+ * as merging) never decodes them in full.
  */
 class Bucket::InputIterator
 {
     std::shared_ptr<Bucket const> mBucket;
 
     // Validity and current-value of the iterator is funneled into a pointer. If
-    // non-null, it points to mEntry.
-    BucketEntry const* mEntryPtr;
+    // non-null, it points to the current record in mIn's buffer.
+    char const* mRecord{nullptr};
+    size_t mRecordSize{0};
     XDRInputFileStream mIn;
+    size_t mEntryPos{0};
+
+    BucketEntryType mType{LIVEENTRY};
+    LedgerKey mKey;
+    size_t mKeyOffset{0};
+    size_t mKeySize{0};
+    uint64_t mKeyHash{0};
+    bool mHaveKey{false};
+    bool mHaveKeyHash{false};
     BucketEntry mEntry;
+    bool mHaveEntry{false};
 
     void
     loadEntry()
     {
-        if (mIn.readOne(mEntry))
+        mEntryPos = mIn.pos();
+        mHaveKey = false;
+        mHaveKeyHash = false;
+        mHaveEntry = false;
+        if (!mIn.readRecord(mRecord, mRecordSize))
         {
-            mEntryPtr = &mEntry;
+            mRecord = nullptr;
         }
-        else
+    }
+
+    void
+    loadKey()
+    {
+        if (!mHaveKey)
         {
-            mEntryPtr = nullptr;
+            mKeyOffset =
+                4 + decodeEntryKey(mRecord + 4, mRecordSize - 4, mType, mKey);
+            mKeySize = xdr::xdr_size(mKey);
+            mHaveKey = true;
         }
     }
 
   public:
     operator bool() const
     {
-        return mEntryPtr != nullptr;
+        return mRecord != nullptr;
     }
 
     BucketEntry const& operator*()
     {
-        return *mEntryPtr;
+        if (!mHaveEntry)
+        {
+            xdr::xdr_get g(mRecord + 4, mRecord + mRecordSize);
+            xdr::xdr_argpack_archive(g, mEntry);
+            mHaveEntry = true;
+        }
+        return mEntry;
+    }
+
+    BucketEntryType
+    type()
+    {
+        loadKey();
+        return mType;
     }
 
-    InputIterator(std::shared_ptr<Bucket const> bucket)
-        : mBucket(bucket), mEntryPtr(nullptr)
+    // The key of the current entry, whether it is live or dead.
+    LedgerKey const&
+    key()
+    {
+        loadKey();
+        return mKey;
+    }
+
+    // Return true if the current entry's key is in `keys`.
+    bool
+    keyIn(BucketKeySet const& keys)
+    {
+        loadKey();
+        auto k = reinterpret_cast<uint8_t const*>(mRecord + mKeyOffset);
+        if (!mHaveKeyHash)
+        {
+            mKeyHash = BucketKeySet::hashKey(k, mKeySize);
+            mHaveKeyHash = true;
+        }
+        return keys.contains(mKeyHash, k, mKeySize);
+    }
+
+    // The current entry's record, exactly as it appears in the bucket file.
+    char const*
+    record() const
+    {
+        return mRecord;
+    }
+
+    size_t
+    recordSize() const
+    {
+        return mRecordSize;
+    }
+
+    // Iterators that only read a small part of the bucket (such as point
+    // lookups) should pass a `bufferSize` to match, rather than reading the
+    // file in large blocks.
+    InputIterator(std::shared_ptr<Bucket const> bucket,
+                  size_t bufferSize = XDRInputFileStream::kDefaultBufferSize)
+        : mBucket(bucket)
     {
         if (!mBucket->mFilename.empty())
         {
             CLOG(TRACE, "Bucket")
                 << "Bucket::InputIterator opening file to read: "
                 << mBucket->mFilename;
-            mIn.open(mBucket->mFilename);
+            mIn.open(mBucket->mFilename, bufferSize);
             loadEntry();
         }
     }
@@ -150,6 +281,22 @@ class Bucket::InputIterator
         mIn.close();
     }
 
+    // Return the byte offset of the current entry in the bucket file. Only
+    // meaningful while the iterator is valid.
+    size_t
+    pos() const
+    {
+        return mEntryPos;
+    }
+
+    // Reposition the iterator at the entry starting at byte `offset`.
+    void
+    seek(size_t offset)
+    {
+        mIn.seek(offset);
+        loadEntry();
+    }
+
     InputIterator& operator++()
     {
         if (mIn)
@@ -158,7 +305,7 @@ class Bucket::InputIterator
         }
         else
         {
-            mEntryPtr = nullptr;
+            mRecord = nullptr;
         }
         return *this;
     }
@@ -172,23 +319,65 @@ class Bucket::OutputIterator
 {
     std::string mFilename;
     XDROutputFileStream mOut;
-    BucketEntryIdCmp mCmp;
-    std::unique_ptr<BucketEntry> mBuf;
+    LedgerEntryIdCmp mCmp;
+
+    // The most recently put record and its key, held back until a record with
+    // a greater key shows that it has not been superseded.
+    std::vector<char> mPending;
+    LedgerKey mPendingKey;
+    bool mHavePending{false};
+
     std::unique_ptr<SHA256> mHasher;
+    BucketIndex::Builder mIndexBuilder;
     size_t mBytesPut{0};
     size_t mObjectsPut{0};
     bool mKeepDeadEntries{true};
 
+    void
+    writePending()
+    {
+        mIndexBuilder.add(mPendingKey, mBytesPut);
+        mOut.writeRecord(mPending.data(), mPending.size(), mHasher.get(),
+                         &mBytesPut);
+        mObjectsPut++;
+    }
+
+    // Make `key` the key of the pending record, first writing out the current
+    // pending record unless `key` supersedes it.
+    void
+    setPendingKey(LedgerKey const& key)
+    {
+        // Check to see if there's an existing pending record.
+        if (mHavePending)
+        {
+            // mCmp(key, mPendingKey) means key < mPendingKey; this should never
+            // be true since it would mean that we're getting entries out of
+            // order.
+            assert(!mCmp(key, mPendingKey));
+
+            // Check to see if the new entry should flush (greater identity),
+            // or merely replace (same identity), the pending one.
+            if (mCmp(mPendingKey, key))
+            {
+                writePending();
+            }
+        }
+        mPendingKey = key;
+        mHavePending = true;
+    }
+
   public:
-    OutputIterator(std::string const& tmpDir, bool keepDeadEntries)
+    // The bucket file is written block-compressed if `compress` is set; its
+    // hash, and the offsets in its index, are those of the plain XDR.
+    OutputIterator(std::string const& tmpDir, bool keepDeadEntries,
+                   bool compress = false)
         : mFilename(randomBucketName(tmpDir))
-        , mBuf(nullptr)
         , mHasher(SHA256::create())
         , mKeepDeadEntries(keepDeadEntries)
     {
         CLOG(TRACE, "Bucket")
             << "Bucket::OutputIterator opening file to write: " << mFilename;
-        mOut.open(mFilename);
+        mOut.open(mFilename, compress);
     }
 
     void
@@ -198,40 +387,34 @@ class Bucket::OutputIterator
         {
             return;
         }
+        setPendingKey(e.type() == LIVEENTRY ? LedgerEntryKey(e.liveEntry())
+                                            : e.deadEntry());
+        XDROutputFileStream::encodeRecord(e, mPending);
+    }
 
-        // Check to see if there's an existing buffered entry.
-        if (mBuf)
-        {
-            // mCmp(e, *mBuf) means e < *mBuf; this should never be true since
-            // it would mean that we're getting entries out of order.
-            assert(!mCmp(e, *mBuf));
-
-            // Check to see if the new entry should flush (greater identity), or
-            // merely replace (same identity), the buffered entry.
-            if (mCmp(*mBuf, e))
-            {
-                mOut.writeOne(*mBuf, mHasher.get(), &mBytesPut);
-                mObjectsPut++;
-            }
-        }
-        else
+    // Put the current entry of `in`, copying its record through without
+    // decoding or re-encoding it.
+    void
+    putRecord(Bucket::InputIterator& in)
+    {
+        if (!mKeepDeadEntries && in.type() == DEADENTRY)
         {
-            mBuf = make_unique<BucketEntry>();
+            return;
         }
-
-        // In any case, replace *mBuf with e.
-        *mBuf = e;
+        setPendingKey(in.key());
+        mPending.assign(in.record(), in.record() + in.recordSize());
+        // Written records always have the 'continuation' bit set.
+        mPending[0] |= '\x80';
     }
 
     std::shared_ptr<Bucket>
     getBucket(BucketManager& bucketManager)
     {
         assert(mOut);
-        if (mBuf)
+        if (mHavePending)
         {
-            mOut.writeOne(*mBuf, mHasher.get(), &mBytesPut);
-            mObjectsPut++;
-            mBuf.reset();
+            writePending();
+            mHavePending = false;
         }
 
         mOut.close();
@@ -244,22 +427,56 @@ class Bucket::OutputIterator
             return std::make_shared<Bucket>();
         }
         return bucketManager.adoptFileAsBucket(mFilename, mHasher->finish(),
-                                               mObjectsPut, mBytesPut);
+                                               mObjectsPut, mBytesPut,
+                                               mIndexBuilder.finish(mBytesPut));
     }
 };
 
 bool
 Bucket::containsBucketIdentity(BucketEntry const& id) const
 {
-    BucketEntryIdCmp cmp;
-    Bucket::InputIterator iter(shared_from_this());
-    while (iter)
+    BucketEntry e;
+    auto key = id.type() == LIVEENTRY ? LedgerEntryKey(id.liveEntry())
+                                      : id.deadEntry();
+    return getBucketEntry(key, e);
+}
+
+bool
+Bucket::getBucketEntry(LedgerKey const& key, BucketEntry& out) const
+{
+    if (mFilename.empty())
+    {
+        return false;
+    }
+
+    size_t begin = 0;
+    size_t end = std::numeric_limits<size_t>::max();
+    if (mIndex && !mIndex->lookup(key, begin, end))
+    {
+        return false;
+    }
+
+    LedgerEntryIdCmp cmp;
+    Bucket::InputIterator iter(shared_from_this(),
+                               mIndex ? BucketIndex::kPageBytes
+                                      : XDRInputFileStream::kDefaultBufferSize);
+    if (begin != 0)
     {
-        if (!(cmp(*iter, id) || cmp(id, *iter)))
+        iter.seek(begin);
+    }
+    for (; iter && iter.pos() < end; ++iter)
+    {
+        if (cmp(iter.key(), key))
         {
-            return true;
+            continue;
         }
-        ++iter;
+        if (cmp(key, iter.key()))
+        {
+            // Entries are sorted, so we've passed where `key` would be.
+            return false;
+        }
+        out = *iter;
+        return true;
     }
     return false;
 }
@@ -271,7 +488,7 @@ Bucket::countLiveAndDeadEntries() const
     Bucket::InputIterator iter(shared_from_this());
     while (iter)
     {
-        if ((*iter).type() == LIVEENTRY)
+        if (iter.type() == LIVEENTRY)
         {
             ++live;
         }
@@ -299,74 +516,82 @@ Bucket::fresh(BucketManager& bucketManager,
               std::vector<LedgerEntry> const& liveEntries,
               std::vector<LedgerKey> const& deadEntries)
 {
-    std::vector<BucketEntry> live, dead, combined;
+    // The entries come out of an (unordered) LedgerDelta, so they still have
+    // to be sorted; sort pointers to them rather than copies, and merge the
+    // two sorted runs straight into the bucket's file instead of writing a
+    // live and a dead bucket and merging those.
+    LedgerEntryIdCmp cmp;
+    std::vector<LedgerEntry const*> live;
+    std::vector<LedgerKey const*> dead;
     live.reserve(liveEntries.size());
     dead.reserve(deadEntries.size());
-
     for (auto const& e : liveEntries)
     {
-        BucketEntry ce;
-        ce.type(LIVEENTRY);
-        ce.liveEntry() = e;
-        live.push_back(ce);
+        live.push_back(&e);
     }
-
     for (auto const& e : deadEntries)
     {
-        BucketEntry ce;
-        ce.type(DEADENTRY);
-        ce.deadEntry() = e;
-        dead.push_back(ce);
+        dead.push_back(&e);
     }
 
-    std::sort(live.begin(), live.end(), BucketEntryIdCmp());
-
-    std::sort(dead.begin(), dead.end(), BucketEntryIdCmp());
-
-    OutputIterator liveOut(bucketManager.getTmpDir(), true);
-    OutputIterator deadOut(bucketManager.getTmpDir(), true);
-    for (auto const& e : live)
+    // Stable, so that the last of several entries with the same key is the
+    // one the output iterator keeps.
+    std::stable_sort(live.begin(), live.end(),
+                     [&cmp](LedgerEntry const* a, LedgerEntry const* b) {
+                         return cmp(*a, *b);
+                     });
+    std::stable_sort(dead.begin(), dead.end(),
+                     [&cmp](LedgerKey const* a, LedgerKey const* b) {
+                         return cmp(*a, *b);
+                     });
+
+    OutputIterator out(bucketManager.getTmpDir(), true,
+                       bucketManager.getCompressBuckets());
+    BucketEntry e;
+    auto putLive = [&](LedgerEntry const& le) {
+        e.type(LIVEENTRY);
+        e.liveEntry() = le;
+        out.put(e);
+    };
+    auto putDead = [&](LedgerKey const& lk) {
+        e.type(DEADENTRY);
+        e.deadEntry() = lk;
+        out.put(e);
+    };
+
+    auto li = live.begin();
+    auto di = dead.begin();
+    while (li != live.end() || di != dead.end())
     {
-        liveOut.put(e);
-    }
-    for (auto const& e : dead)
-    {
-        deadOut.put(e);
+        // A key that is both live and dead ends up dead, as it would merging
+        // the dead bucket over the live one.
+        if (di == dead.end() || (li != live.end() && !cmp(**di, **li)))
+        {
+            putLive(**li++);
+        }
+        else
+        {
+            putDead(**di++);
+        }
     }
-
-    auto liveBucket = liveOut.getBucket(bucketManager);
-    auto deadBucket = deadOut.getBucket(bucketManager);
-    return Bucket::merge(bucketManager, liveBucket, deadBucket);
+    return out.getBucket(bucketManager);
 }
 
 inline void
-maybe_put(BucketEntryIdCmp const& cmp, Bucket::OutputIterator& out,
-          Bucket::InputIterator& in,
-          std::vector<Bucket::InputIterator>& shadowIterators)
+maybe_put(Bucket::OutputIterator& out, Bucket::InputIterator& in,
+          std::vector<std::shared_ptr<BucketKeySet const>> const& shadowKeys)
 {
-    for (auto& si : shadowIterators)
+    for (auto const& keys : shadowKeys)
     {
-        // Advance the shadowIterator while it's less than the candidate
-        while (si && cmp(*si, *in))
-        {
-            ++si;
-        }
-        // We have stepped si forward to the point that either si is exhausted,
-        // or else *si >= *in; we now check the opposite direction to see if we
-        // have equality.
-        if (si && !cmp(*in, *si))
+        if (in.keyIn(*keys))
         {
             // If so, then *in is shadowed in at least one level and we will
-            // not be doing a 'put'; we return early. There is no need to
-            // advance
-            // the other iterators, they will advance as and if necessary in
-            // future
-            // calls to maybe_put.
+            // not be doing a 'put'.
             return;
         }
     }
     // Nothing shadowed.
-    out.put(*in);
+    out.putRecord(in);
 }
 
 std::shared_ptr<Bucket>
@@ -378,7 +603,8 @@ Bucket::merge(BucketManager& bucketManager,
 {
     // This is the key operation in the scheme: merging two (read-only)
     // buckets together into a new 3rd bucket, while calculating its hash,
-    // in a single pass.
+    // in a single pass. Entries are only ever compared by key and copied
+    // through as raw records, so none of them are decoded in full.
 
     assert(oldBucket);
     assert(newBucket);
@@ -386,43 +612,53 @@ Bucket::merge(BucketManager& bucketManager,
     Bucket::InputIterator oi(oldBucket);
     Bucket::InputIterator ni(newBucket);
 
-    std::vector<Bucket::InputIterator> shadowIterators(shadows.begin(),
-                                                       shadows.end());
+    // Shadowing is checked against the in-memory key set of each shadow,
+    // which is built once per bucket and shared by every merge it shadows.
+    std::vector<std::shared_ptr<BucketKeySet const>> shadowKeys;
+    for (auto const& s : shadows)
+    {
+        auto keys = s->getKeySet();
+        if (keys && keys->size() != 0)
+        {
+            shadowKeys.push_back(keys);
+        }
+    }
 
     auto timer = bucketManager.getMergeTimer().TimeScope();
-    Bucket::OutputIterator out(bucketManager.getTmpDir(), keepDeadEntries);
+    Bucket::OutputIterator out(bucketManager.getTmpDir(), keepDeadEntries,
+                               bucketManager.getCompressBuckets());
 
-    BucketEntryIdCmp cmp;
+    LedgerEntryIdCmp cmp;
     while (oi || ni)
     {
         if (!ni)
         {
             // Out of new entries, take old entries.
-            maybe_put(cmp, out, oi, shadowIterators);
+            maybe_put(out, oi, shadowKeys);
             ++oi;
         }
         else if (!oi)
         {
             // Out of old entries, take new entries.
-            maybe_put(cmp, out, ni, shadowIterators);
+            maybe_put(out, ni, shadowKeys);
             ++ni;
         }
-        else if (cmp(*oi, *ni))
+        else if (cmp(oi.key(), ni.key()))
         {
             // Next old-entry has smaller key, take it.
-            maybe_put(cmp, out, oi, shadowIterators);
+            maybe_put(out, oi, shadowKeys);
             ++oi;
         }
-        else if (cmp(*ni, *oi))
+        else if (cmp(ni.key(), oi.key()))
         {
             // Next new-entry has smaller key, take it.
-            maybe_put(cmp, out, ni, shadowIterators);
+            maybe_put(out, ni, shadowKeys);
             ++ni;
         }
         else
         {
             // Old and new are for the same key, take new.
-            maybe_put(cmp, out, ni, shadowIterators);
+            maybe_put(out, ni, shadowKeys);
             ++oi;
             ++ni;
         }
@@ -442,74 +678,203 @@ compareSizes(std::string const& objType, uint64_t inDatabase,
     }
 }
 
-// FIXME issue NNN: this should be refactored to run in a read-transaction on a
-// background thread and take a soci::session& rather than Database&. For now we
-// code it to run on main thread because there's a bunch of code to move around
-// in the ledger frames and db layer to make that work.
+// Live entries are checked against the database in batches of (at most) this
+// many entries of one type, each loaded with a single SELECT. Kept below
+// SQLite's default limit of 999 parameters per statement.
+static size_t const kCheckDBBatchSize = 500;
 
-void
-checkDBAgainstBuckets(medida::MetricsRegistry& metrics,
-                      BucketManager& bucketManager, Database& db,
-                      BucketList& bl)
+static void
+checkBatchAgainstDatabase(std::vector<LedgerEntry> const& batch,
+                          soci::session& sess)
 {
-    CLOG(INFO, "Bucket") << "CheckDB starting";
-    auto execTimer =
-        metrics.NewTimer({"bucket", "checkdb", "execute"}).TimeScope();
+    if (batch.empty())
+    {
+        return;
+    }
+
+    std::map<LedgerKey, LedgerEntry const*, LedgerEntryIdCmp> expected;
+    for (auto const& e : batch)
+    {
+        expected.emplace(LedgerEntryKey(e), &e);
+    }
+
+    // Batches are loaded by account where the table is keyed by account, so
+    // other entries of the same accounts may be returned too; those are
+    // checked with their own batches.
+    auto check = [&expected](LedgerEntry const& fromDb) {
+        auto i = expected.find(LedgerEntryKey(fromDb));
+        if (i == expected.end())
+        {
+            return;
+        }
+        if (!(fromDb == *i->second))
+        {
+            std::string s;
+            s = "Inconsistent state between objects: ";
+            s += xdr::xdr_to_string(fromDb, "db");
+            s += xdr::xdr_to_string(*i->second, "live");
+            throw std::runtime_error(s);
+        }
+        expected.erase(i);
+    };
+
+    // Entries arrive in key order, so entries of the same account are
+    // adjacent.
+    std::vector<AccountID> accountIDs;
+    auto addAccount = [&accountIDs](AccountID const& id) {
+        if (accountIDs.empty() || !(accountIDs.back() == id))
+        {
+            accountIDs.push_back(id);
+        }
+    };
 
-    // Step 1: Collect all buckets to merge.
-    std::vector<std::shared_ptr<Bucket>> buckets;
-    for (size_t i = 0; i < BucketList::kNumLevels; ++i)
+    switch (batch.front().data.type())
     {
-        CLOG(INFO, "Bucket") << "CheckDB collecting buckets from level " << i;
-        auto& level = bl.getLevel(i);
-        auto& next = level.getNext();
-        if (next.isLive())
+    case ACCOUNT:
+        for (auto const& e : batch)
+        {
+            addAccount(e.data.account().accountID);
+        }
+        AccountFrame::loadAccounts(sess, accountIDs, check);
+        break;
+    case TRUSTLINE:
+        for (auto const& e : batch)
         {
-            CLOG(INFO, "Bucket") << "CheckDB resolving future bucket on level "
-                                 << i;
-            buckets.push_back(next.resolve());
+            addAccount(e.data.trustLine().accountID);
         }
-        buckets.push_back(level.getCurr());
-        buckets.push_back(level.getSnap());
+        TrustFrame::loadLines(sess, accountIDs, check);
+        break;
+    case OFFER:
+    {
+        std::vector<uint64_t> offerIDs;
+        for (auto const& e : batch)
+        {
+            offerIDs.push_back(e.data.offer().offerID);
+        }
+        OfferFrame::loadOffers(sess, offerIDs, check);
+        break;
+    }
+    case DATA:
+        for (auto const& e : batch)
+        {
+            addAccount(e.data.data().accountID);
+        }
+        DataFrame::loadData(sess, accountIDs, check);
+        break;
     }
 
-    if (buckets.empty())
+    if (!expected.empty())
     {
-        CLOG(INFO, "Bucket") << "CheckDB found no buckets, returning";
-        return;
+        std::string s;
+        s = "Inconsistent state between objects: missing from db: ";
+        s += xdr::xdr_to_string(*expected.begin()->second, "live");
+        throw std::runtime_error(s);
     }
+}
+
+void
+checkDBAgainstBuckets(medida::MetricsRegistry& metrics,
+                      std::vector<std::shared_ptr<Bucket>> const& buckets,
+                      soci::session& sess)
+{
+    CLOG(INFO, "Bucket") << "CheckDB starting";
+    auto execTimer =
+        metrics.NewTimer({"bucket", "checkdb", "execute"}).TimeScope();
 
-    // Step 2: merge all buckets into a single super-bucket.
-    auto i = buckets.begin();
-    assert(i != buckets.end());
-    std::shared_ptr<Bucket> superBucket = *i;
-    while (++i != buckets.end())
+    // Step 1: open an iterator on every bucket. Buckets are ordered newest
+    // first, so for any key the iterator with the lowest index holds its
+    // current state.
+    std::vector<std::unique_ptr<Bucket::InputIterator>> iters;
+    for (auto const& b : buckets)
     {
-        auto mergeTimer =
-            metrics.NewTimer({"bucket", "checkdb", "merge"}).TimeScope();
-        assert(superBucket);
-        assert(*i);
-        superBucket = Bucket::merge(bucketManager, *i, superBucket);
-        assert(superBucket);
+        iters.emplace_back(make_unique<Bucket::InputIterator>(b));
     }
 
+    // Step 2: merge all buckets in a single pass, with a heap of iterators
+    // ordered by their next key and, for equal keys, newest bucket first.
+    // std heaps put the greatest element on top, hence the reversed order.
+    LedgerEntryIdCmp cmp;
+    auto after = [&iters, &cmp](size_t a, size_t b) {
+        auto const& ka = iters[a]->key();
+        auto const& kb = iters[b]->key();
+        if (cmp(ka, kb))
+        {
+            return false;
+        }
+        if (cmp(kb, ka))
+        {
+            return true;
+        }
+        return a > b;
+    };
+    std::vector<size_t> heap;
+    for (size_t i = 0; i < iters.size(); ++i)
+    {
+        if (*iters[i])
+        {
+            heap.push_back(i);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), after);
+    auto advance = [&iters, &heap, &after](size_t i) {
+        ++*iters[i];
+        if (*iters[i])
+        {
+            heap.push_back(i);
+            std::push_heap(heap.begin(), heap.end(), after);
+        }
+    };
+
     CLOG(INFO, "Bucket") << "CheckDB starting object comparison";
 
-    // Step 3: scan the superbucket, checking each object against the DB and
-    // counting objects along the way.
+    // Step 3: check the live entries that come out of the merge against the
+    // DB in batches of one type, counting objects along the way.
     uint64_t nAccounts = 0, nTrustLines = 0, nOffers = 0, nData = 0;
     {
         auto& meter = metrics.NewMeter({"bucket", "checkdb", "object-compare"},
                                        "comparison");
         auto compareTimer =
             metrics.NewTimer({"bucket", "checkdb", "compare"}).TimeScope();
-        for (Bucket::InputIterator iter(superBucket); iter; ++iter)
+        std::vector<LedgerEntry> batch;
+        uint64_t nextReport = 100000;
+        auto flush = [&]() {
+            checkBatchAgainstDatabase(batch, sess);
+            meter.Mark(batch.size());
+            batch.clear();
+            if (meter.count() >= nextReport)
+            {
+                CLOG(INFO, "Bucket")
+                    << "CheckDB compared " << meter.count() << " objects";
+                nextReport += 100000;
+            }
+        };
+
+        while (!heap.empty())
         {
-            meter.Mark();
-            auto& e = *iter;
-            if (e.type() == LIVEENTRY)
+            std::pop_heap(heap.begin(), heap.end(), after);
+            size_t top = heap.back();
+            heap.pop_back();
+            auto& iter = *iters[top];
+
+            // Skip the same key in older buckets.
+            while (!heap.empty() &&
+                   !cmp(iter.key(), iters[heap.front()]->key()))
             {
-                switch (e.liveEntry().data.type())
+                std::pop_heap(heap.begin(), heap.end(), after);
+                size_t shadowed = heap.back();
+                heap.pop_back();
+                advance(shadowed);
+            }
+
+            if (iter.type() == LIVEENTRY)
+            {
+                auto const& e = (*iter).liveEntry();
+                if (!batch.empty() &&
+                    batch.front().data.type() != e.data.type())
+                {
+                    flush();
+                }
+                switch (e.data.type())
                 {
                 case ACCOUNT:
                     ++nAccounts;
@@ -524,18 +889,18 @@ checkDBAgainstBuckets(medida::MetricsRegistry& metrics,
                     ++nData;
                     break;
                 }
-                EntryFrame::checkAgainstDatabase(e.liveEntry(), db);
-                if (meter.count() % 100 == 0)
+                batch.push_back(e);
+                if (batch.size() == kCheckDBBatchSize)
                 {
-                    CLOG(INFO, "Bucket") << "CheckDB compared " << meter.count()
-                                         << " objects";
+                    flush();
                 }
             }
+            advance(top);
         }
+        flush();
     }
 
     // Step 4: confirm size of datasets matches size of datasets in DB.
-    soci::session& sess = db.getSession();
     compareSizes("account", AccountFrame::countObjects(sess), nAccounts);
     compareSizes("trustline", TrustFrame::countObjects(sess), nTrustLines);
     compareSizes("offer", OfferFrame::countObjects(sess), nOffers);
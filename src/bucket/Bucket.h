@@ -6,13 +6,21 @@
 
 #include "overlay/StellarXDR.h"
 #include "util/NonCopyable.h"
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace medida
 {
 class MetricsRegistry;
 }
 
+namespace soci
+{
+class session;
+}
+
 namespace stellar
 {
 
@@ -27,6 +35,8 @@ namespace stellar
  * merged in sorted order, and all elements are hashed while being added.
  */
 
+class BucketIndex;
+class BucketKeySet;
 class BucketManager;
 class BucketList;
 class Database;
@@ -37,8 +47,14 @@ class Bucket : public std::enable_shared_from_this<Bucket>,
 
     std::string const mFilename;
     Hash const mHash;
+    std::shared_ptr<BucketIndex const> const mIndex;
     bool mRetain{false};
 
+    // Lazily-built cache of the bucket's keys; derived from the (immutable)
+    // file, so it does not make the bucket any less immutable.
+    mutable std::mutex mKeySetMutex;
+    mutable std::shared_ptr<BucketKeySet const> mKeySet;
+
   public:
     // Helper class that reads through the entries in a bucket, used internally
     // during merging.
@@ -52,18 +68,24 @@ class Bucket : public std::enable_shared_from_this<Bucket>,
     // filename is the empty string.
     Bucket();
 
-    // Destroy a bucket, deleting its underlying file if the bucket is not
-    // 'retained'. See `setRetain`.
+    // Destroy a bucket, deleting its underlying file (and index file, if any)
+    // if the bucket is not 'retained'. See `setRetain`.
     ~Bucket();
 
-    // Construct a bucket with a given filename and hash. Asserts that the file
-    // exists, but does not check that the hash is the bucket's hash. Caller
-    // needs to ensure that.
-    Bucket(std::string const& filename, Hash const& hash);
+    // Construct a bucket with a given filename, hash and optional index.
+    // Asserts that the file exists, but does not check that the hash is the
+    // bucket's hash, nor that the index describes the file. Caller needs to
+    // ensure that.
+    Bucket(std::string const& filename, Hash const& hash,
+           std::shared_ptr<BucketIndex const> index = nullptr);
 
     Hash const& getHash() const;
     std::string const& getFilename() const;
 
+    // Return the bucket's key index, or nullptr if it has none. Buckets
+    // managed by the BucketManager always have one.
+    std::shared_ptr<BucketIndex const> const& getIndex() const;
+
     // Sets or clears the `retain` flag on the bucket. A retained bucket will
     // not be deleted (from the filesystem) when the Bucket object is deleted. A
     // non-retained bucket _will_ delete the underlying file. Buckets should
@@ -76,6 +98,23 @@ class Bucket : public std::enable_shared_from_this<Bucket>,
     // BucketEntry exists in the bucket. For testing.
     bool containsBucketIdentity(BucketEntry const& id) const;
 
+    // Look up the entry (live or dead) for `key` in this bucket, returning
+    // true and setting `out` if there is one. Uses the bucket's index to seek
+    // directly to the single page that could hold `key`, falling back to a
+    // full scan if the bucket has no index.
+    bool getBucketEntry(LedgerKey const& key, BucketEntry& out) const;
+
+    // Decode just the type and key of the BucketEntry whose XDR is the `len`
+    // bytes at `data`, without decoding the rest of the entry. Returns the
+    // offset in `data` at which the XDR of `key` appears verbatim.
+    static size_t decodeEntryKey(char const* data, size_t len,
+                                 BucketEntryType& type, LedgerKey& key);
+
+    // Return the set of keys in this bucket, building it on first use and
+    // caching it for the lifetime of the bucket. Used to check merges against
+    // this bucket when it shadows them.
+    std::shared_ptr<BucketKeySet const> getKeySet() const;
+
     // Return the count of live and dead BucketEntries in the bucket. For
     // testing.
     std::pair<size_t, size_t> countLiveAndDeadEntries() const;
@@ -107,7 +146,14 @@ class Bucket : public std::enable_shared_from_this<Bucket>,
           bool keepDeadEntries = true);
 };
 
+// Check the live entries of `buckets` -- the buckets of a BucketList, newest
+// first, as returned by BucketList::getBuckets -- against the database read
+// through `sess`, and check that the database holds no other entries. The
+// buckets are merged in a single streaming pass and compared in batches, so
+// this can run on a worker thread given a pooled session, ideally one in a
+// transaction whose snapshot matches the buckets. Throws on the first
+// inconsistency.
 void checkDBAgainstBuckets(medida::MetricsRegistry& metrics,
-                           BucketManager& bucketManager, Database& db,
-                           BucketList& bl);
+                           std::vector<std::shared_ptr<Bucket>> const& buckets,
+                           soci::session& sess);
 }
@@ -5,15 +5,40 @@
 #include "util/asio.h"
 #include "bucket/Bucket.h"
 #include "bucket/BucketApplicator.h"
-#include "ledger/LedgerDelta.h"
+#include "ledger/EntryFrame.h"
+#include "ledger/OrderBook.h"
 #include "util/Logging.h"
+#include "util/make_unique.h"
+#include <exception>
+#include <future>
 
 namespace stellar
 {
 
+size_t const BucketApplicator::kEntriesPerAdvance = 4096;
+
 BucketApplicator::BucketApplicator(Database& db,
                                    std::shared_ptr<const Bucket> bucket)
-    : mDb(db), mBucket(bucket)
+    : mDb(&db)
+    , mSess(db.getSession())
+    , mBucket(bucket)
+    , mInlineSigners(db.hasInlineAccountSigners())
+{
+    if (!bucket->getFilename().empty())
+    {
+        mIn.open(bucket->getFilename());
+    }
+}
+
+BucketApplicator::BucketApplicator(soci::session& sess,
+                                   std::shared_ptr<const Bucket> bucket,
+                                   LedgerEntryType type, bool inlineSigners)
+    : mDb(nullptr)
+    , mSess(sess)
+    , mBucket(bucket)
+    , mInlineSigners(inlineSigners)
+    , mFiltered(true)
+    , mType(type)
 {
     if (!bucket->getFilename().empty())
     {
@@ -23,41 +48,153 @@ BucketApplicator::BucketApplicator(Database& db,
 
 BucketApplicator::operator bool() const
 {
-    return (bool)mIn;
+    return !mDone && (bool)mIn;
+}
+
+void
+BucketApplicator::flush()
+{
+    EntryFrame::storeDeleteBulk(mSess, mDead);
+    EntryFrame::storeAddBulk(mSess, mLive, mInlineSigners);
+    mDead.clear();
+    mLive.clear();
 }
 
 void
 BucketApplicator::advance()
 {
-    soci::transaction sqlTx(mDb.getSession());
+    // Checked on first use rather than on construction, as applicators for
+    // several buckets may be created before any of them is applied.
+    if (!mCheckedEmptyTypes)
+    {
+        for (auto type : {ACCOUNT, TRUSTLINE, OFFER, DATA})
+        {
+            if ((!mFiltered || type == mType) &&
+                EntryFrame::storeIsEmpty(mSess, type))
+            {
+                mEmptyTypes.insert(type);
+            }
+        }
+        mCheckedEmptyTypes = true;
+    }
+
+    std::unique_ptr<soci::transaction> sqlTx;
+    if (mDb)
+    {
+        sqlTx = make_unique<soci::transaction>(mSess);
+    }
     BucketEntry entry;
-    while (mIn && mIn.readOne(entry))
+    LedgerEntryType batchType = mType;
+    size_t n = 0;
+    while (n < kEntriesPerAdvance && mIn && mIn.readOne(entry))
     {
-        LedgerHeader lh;
-        LedgerDelta delta(lh, mDb, false);
-        if (entry.type() == LIVEENTRY)
+        LedgerKey key = entry.type() == LIVEENTRY
+                            ? LedgerEntryKey(entry.liveEntry())
+                            : entry.deadEntry();
+        if (mFiltered && key.type() != mType)
+        {
+            // Buckets are sorted by type first: skip to our type's entries
+            // and stop after them.
+            if (key.type() > mType)
+            {
+                mDone = true;
+                break;
+            }
+            continue;
+        }
+        if (key.type() != batchType)
         {
-            EntryFrame::pointer ep = EntryFrame::FromXDR(entry.liveEntry());
-            ep->storeAddOrChange(delta, mDb);
+            flush();
+            batchType = key.type();
         }
-        else
+        if (mEmptyTypes.find(batchType) == mEmptyTypes.end())
         {
-            EntryFrame::storeDelete(delta, mDb, entry.deadEntry());
+            mDead.emplace_back(std::move(key));
         }
-        // No-op, just to avoid needless rollback.
-        delta.commit();
-        if ((++mSize & 0xff) == 0xff)
+        if (entry.type() == LIVEENTRY)
         {
-            break;
+            mLive.emplace_back(entry.liveEntry());
         }
+        ++n;
+        ++mSize;
+    }
+    flush();
+    if (mDb)
+    {
+        sqlTx->commit();
+        // The bulk helpers bypass the entry cache and the order book.
+        mDb->getEntryCache().clear();
+        mDb->getOrderBook().clear();
     }
-    sqlTx.commit();
-    mDb.clearPreparedStatementCache();
 
-    if (!mIn || (mSize & 0xfff) == 0xfff)
+    // Log about every 64k entries, and at the end.
+    if (!*this || (mSize & 0xffff) < n)
     {
-        CLOG(INFO, "Bucket") << "Bucket-apply: committed " << mSize
+        CLOG(INFO, "Bucket") << "Bucket-apply: applied " << mSize
                              << " entries";
     }
 }
+
+void
+BucketApplicator::applyInParallel(
+    soci::connection_pool& pool,
+    std::vector<std::shared_ptr<const Bucket>> const& buckets,
+    bool inlineSigners)
+{
+    std::vector<LedgerEntryType> const types{ACCOUNT, TRUSTLINE, OFFER, DATA};
+    std::vector<std::unique_ptr<soci::session>> sessions;
+    std::vector<std::unique_ptr<soci::transaction>> txs;
+    for (size_t i = 0; i < types.size(); ++i)
+    {
+        sessions.emplace_back(make_unique<soci::session>(pool));
+        txs.emplace_back(make_unique<soci::transaction>(*sessions.back()));
+    }
+
+    std::vector<std::future<void>> applied;
+    for (size_t i = 0; i < types.size(); ++i)
+    {
+        soci::session& sess = *sessions[i];
+        LedgerEntryType type = types[i];
+        applied.emplace_back(
+            std::async(std::launch::async, [&sess, type, &buckets,
+                                            inlineSigners]() {
+                for (auto const& b : buckets)
+                {
+                    BucketApplicator applicator(sess, b, type, inlineSigners);
+                    while (applicator)
+                    {
+                        applicator.advance();
+                    }
+                }
+            }));
+    }
+
+    std::exception_ptr err;
+    for (auto& f : applied)
+    {
+        try
+        {
+            f.get();
+        }
+        catch (...)
+        {
+            if (!err)
+            {
+                err = std::current_exception();
+            }
+        }
+    }
+    if (err)
+    {
+        for (auto& tx : txs)
+        {
+            tx->rollback();
+        }
+        std::rethrow_exception(err);
+    }
+    for (auto& tx : txs)
+    {
+        tx->commit();
+    }
+}
 }
@@ -8,6 +8,8 @@
 #include "database/Database.h"
 #include "util/XDRStream.h"
 #include <memory>
+#include <set>
+#include <vector>
 
 namespace stellar
 {
@@ -17,17 +19,62 @@ class Database;
 // Class that represents a single apply-bucket-to-database operation in
 // progress. Used during history catchup to split up the task of applying
 // bucket into scheduler-friendly, bite-sized pieces.
+//
+// Entries are applied in batches of a single type with multi-row statements:
+// the keys of the batch are deleted, then its live entries inserted, so no
+// entry is ever probed for first. Entry types whose table is empty when the
+// bucket starts being applied skip the deletes too, since a bucket never holds
+// two entries with the same key.
+//
+// An applicator either applies the whole bucket on the main session,
+// committing after each advance(), or only the entries of one type on a
+// session of the caller's, leaving transactions to the caller. Entries of
+// different types touch disjoint tables, so applicators of the latter kind
+// can run concurrently; see applyInParallel.
 
 class BucketApplicator
 {
-    Database& mDb;
+    Database* mDb;
+    soci::session& mSess;
     std::shared_ptr<const Bucket> mBucket;
+    bool mInlineSigners;
     XDRInputFileStream mIn;
     size_t mSize{0};
 
+    bool mFiltered{false};
+    LedgerEntryType mType{ACCOUNT};
+    bool mDone{false};
+
+    bool mCheckedEmptyTypes{false};
+    std::set<LedgerEntryType> mEmptyTypes;
+
+    // Pending batch, all of one type.
+    std::vector<LedgerEntry> mLive;
+    std::vector<LedgerKey> mDead;
+
+    void flush();
+
   public:
+    // Number of entries applied per call to advance(), in one transaction.
+    static size_t const kEntriesPerAdvance;
+
     BucketApplicator(Database& db, std::shared_ptr<const Bucket> bucket);
+    BucketApplicator(soci::session& sess, std::shared_ptr<const Bucket> bucket,
+                     LedgerEntryType type, bool inlineSigners);
     operator bool() const;
     void advance();
+
+    // Apply `buckets`, in order, with one thread and one session of `pool`
+    // per entry type. Each type is applied in a single transaction; they are
+    // committed in type order once all have succeeded, or all rolled back if
+    // any failed, in which case the first error is rethrown. Needs four
+    // sessions of the pool; may be called from any thread, but leaves the
+    // entry cache for the caller to clear. Accounts are stored with their
+    // signers inline if `inlineSigners` (see
+    // Database::hasInlineAccountSigners).
+    static void
+    applyInParallel(soci::connection_pool& pool,
+                    std::vector<std::shared_ptr<const Bucket>> const& buckets,
+                    bool inlineSigners);
 };
 }
@@ -0,0 +1,248 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "bucket/BucketIndex.h"
+#include "bucket/Bucket.h"
+#include "bucket/LedgerCmp.h"
+#include "util/Fs.h"
+#include "util/Logging.h"
+#include "util/XDRStream.h"
+#include "util/make_unique.h"
+#include "xdrpp/marshal.h"
+
+#include <algorithm>
+#include <cereal/archives/portable_binary.hpp>
+#include <cereal/cereal.hpp>
+#include <cereal/types/array.hpp>
+#include <cereal/types/vector.hpp>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace stellar
+{
+
+size_t const BucketIndex::kPageBytes = 16384;
+size_t const BucketIndex::kBloomBitsPerKey = 10;
+size_t const BucketIndex::kBloomProbes = 7;
+
+// Bump this whenever the on-disk layout written by `save` changes; indexes
+// with any other version are discarded and rebuilt.
+static uint32_t const kIndexFileVersion = 1;
+
+uint64_t
+BucketIndex::hashKey(ShortHashKey const& hashKey, LedgerKey const& key)
+{
+    return shortHash::computeHash(hashKey, xdr::xdr_to_opaque(key));
+}
+
+// Bloom probes use double hashing over the two 32-bit halves of the key's
+// short hash (Kirsch & Mitzenmacher), so each key is hashed only once.
+
+void
+BucketIndex::setBloomBits(uint64_t h)
+{
+    uint64_t nbits = mBloom.size() * 64;
+    uint64_t h1 = h & 0xffffffff;
+    uint64_t h2 = (h >> 32) | 1;
+    for (size_t i = 0; i < kBloomProbes; ++i)
+    {
+        uint64_t bit = (h1 + i * h2) % nbits;
+        mBloom[bit >> 6] |= (uint64_t(1) << (bit & 63));
+    }
+}
+
+bool
+BucketIndex::testBloomBits(uint64_t h) const
+{
+    uint64_t nbits = mBloom.size() * 64;
+    uint64_t h1 = h & 0xffffffff;
+    uint64_t h2 = (h >> 32) | 1;
+    for (size_t i = 0; i < kBloomProbes; ++i)
+    {
+        uint64_t bit = (h1 + i * h2) % nbits;
+        if ((mBloom[bit >> 6] & (uint64_t(1) << (bit & 63))) == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+BucketIndex::Builder::Builder() : mHashKey(shortHash::randomKey())
+{
+}
+
+void
+BucketIndex::Builder::add(LedgerKey const& key, size_t offset)
+{
+    if (mPageOffsets.empty() || offset - mPageOffsets.back() >= kPageBytes)
+    {
+        mPageKeys.push_back(key);
+        mPageOffsets.push_back(offset);
+    }
+    mHashes.push_back(BucketIndex::hashKey(mHashKey, key));
+}
+
+std::unique_ptr<BucketIndex const>
+BucketIndex::Builder::finish(size_t fileSize)
+{
+    std::unique_ptr<BucketIndex> idx(new BucketIndex());
+    idx->mHashKey = mHashKey;
+    idx->mEntryCount = mHashes.size();
+    idx->mFileSize = fileSize;
+    size_t nwords = (mHashes.size() * kBloomBitsPerKey + 63) / 64;
+    idx->mBloom.resize(std::max<size_t>(nwords, 1), 0);
+    for (auto h : mHashes)
+    {
+        idx->setBloomBits(h);
+    }
+    idx->mPageKeys = std::move(mPageKeys);
+    idx->mPageOffsets = std::move(mPageOffsets);
+    mHashes.clear();
+    mPageKeys.clear();
+    mPageOffsets.clear();
+    return std::move(idx);
+}
+
+std::unique_ptr<BucketIndex const>
+BucketIndex::build(std::string const& bucketFilename)
+{
+    CLOG(DEBUG, "Bucket") << "Building index for bucket file "
+                          << bucketFilename;
+    Builder builder;
+    XDRInputFileStream in;
+    in.open(bucketFilename);
+    char const* rec;
+    size_t len;
+    BucketEntryType type;
+    LedgerKey key;
+    size_t offset = in.pos();
+    while (in.readRecord(rec, len))
+    {
+        Bucket::decodeEntryKey(rec + 4, len - 4, type, key);
+        builder.add(key, offset);
+        offset = in.pos();
+    }
+    return builder.finish(offset);
+}
+
+std::unique_ptr<BucketIndex const>
+BucketIndex::load(std::string const& indexFilename)
+{
+    if (!fs::exists(indexFilename))
+    {
+        return nullptr;
+    }
+    std::unique_ptr<BucketIndex> idx(new BucketIndex());
+    try
+    {
+        std::ifstream in(indexFilename, std::ifstream::binary);
+        cereal::PortableBinaryInputArchive ar(in);
+        uint32_t version = 0;
+        ar(version);
+        if (version != kIndexFileVersion)
+        {
+            CLOG(WARNING, "Bucket") << "Ignoring bucket index " << indexFilename
+                                    << " with unknown version " << version;
+            return nullptr;
+        }
+        std::vector<std::vector<uint8_t>> pageKeys;
+        ar(idx->mHashKey, idx->mEntryCount, idx->mFileSize, idx->mBloom,
+           pageKeys, idx->mPageOffsets);
+        if (idx->mBloom.empty() || pageKeys.size() != idx->mPageOffsets.size())
+        {
+            throw std::runtime_error("inconsistent bucket index");
+        }
+        idx->mPageKeys.resize(pageKeys.size());
+        for (size_t i = 0; i < pageKeys.size(); ++i)
+        {
+            xdr::xdr_from_opaque(pageKeys[i], idx->mPageKeys[i]);
+        }
+    }
+    catch (std::exception& e)
+    {
+        CLOG(WARNING, "Bucket") << "Ignoring unreadable bucket index "
+                                << indexFilename << ": " << e.what();
+        return nullptr;
+    }
+    return std::move(idx);
+}
+
+void
+BucketIndex::save(std::string const& indexFilename) const
+{
+    std::string tmp = indexFilename + ".tmp";
+    {
+        std::ofstream out(tmp, std::ofstream::binary | std::ofstream::trunc);
+        if (!out)
+        {
+            throw std::runtime_error("failed to open bucket index file: " +
+                                     tmp);
+        }
+        cereal::PortableBinaryOutputArchive ar(out);
+        std::vector<std::vector<uint8_t>> pageKeys;
+        pageKeys.reserve(mPageKeys.size());
+        for (auto const& k : mPageKeys)
+        {
+            auto bytes = xdr::xdr_to_opaque(k);
+            pageKeys.emplace_back(bytes.begin(), bytes.end());
+        }
+        ar(kIndexFileVersion, mHashKey, mEntryCount, mFileSize, mBloom,
+           pageKeys, mPageOffsets);
+    }
+    if (rename(tmp.c_str(), indexFilename.c_str()) != 0)
+    {
+        std::string err("Failed to rename bucket index: ");
+        err += strerror(errno);
+        throw std::runtime_error(err);
+    }
+}
+
+std::string
+BucketIndex::indexFilename(std::string const& bucketFilename)
+{
+    return bucketFilename + ".index";
+}
+
+bool
+BucketIndex::mayContain(LedgerKey const& key) const
+{
+    return mEntryCount != 0 && testBloomBits(hashKey(mHashKey, key));
+}
+
+bool
+BucketIndex::lookup(LedgerKey const& key, size_t& begin, size_t& end) const
+{
+    if (!mayContain(key))
+    {
+        return false;
+    }
+    auto it = std::upper_bound(mPageKeys.begin(), mPageKeys.end(), key,
+                               LedgerEntryIdCmp());
+    if (it == mPageKeys.begin())
+    {
+        // Smaller than the first key in the bucket.
+        return false;
+    }
+    size_t page = (it - mPageKeys.begin()) - 1;
+    begin = mPageOffsets[page];
+    end = (page + 1 < mPageOffsets.size()) ? mPageOffsets[page + 1]
+                                           : mFileSize;
+    return true;
+}
+
+size_t
+BucketIndex::getEntryCount() const
+{
+    return mEntryCount;
+}
+
+size_t
+BucketIndex::getPageCount() const
+{
+    return mPageKeys.size();
+}
+}
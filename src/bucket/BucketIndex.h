@@ -0,0 +1,113 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/ShortHash.h"
+#include "overlay/StellarXDR.h"
+#include "util/NonCopyable.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace stellar
+{
+
+/**
+ * BucketIndex is a small, immutable sidecar to a bucket file that allows a
+ * single LedgerKey to be resolved against the bucket without scanning it.
+ *
+ * It has two parts:
+ *
+ *   - A bloom filter over the keys of every entry in the bucket (live or
+ *     dead), so that most lookups of keys the bucket does not contain return
+ *     without touching the bucket file at all.
+ *
+ *   - A sparse "page" index, recording the first key and the file offset of
+ *     each run of roughly kPageBytes bytes of the bucket. Since bucket entries
+ *     are sorted by LedgerEntryIdCmp, a key present in the bucket must be in
+ *     the last page whose first key is not greater than it; so a lookup costs
+ *     one seek and a scan of at most one page.
+ *
+ * An index is built either incrementally while a bucket file is written (see
+ * Bucket::OutputIterator) or by a single scan of an existing bucket file, and
+ * is persisted by the BucketManager alongside the bucket file it describes.
+ */
+class BucketIndex : public NonMovableOrCopyable
+{
+    ShortHashKey mHashKey;
+    uint64_t mEntryCount{0};
+    uint64_t mFileSize{0};
+
+    // Bloom filter bits, packed 64 to a word.
+    std::vector<uint64_t> mBloom;
+
+    // First key and byte offset of each page, in bucket order.
+    std::vector<LedgerKey> mPageKeys;
+    std::vector<uint64_t> mPageOffsets;
+
+    BucketIndex() = default;
+
+    static uint64_t hashKey(ShortHashKey const& hashKey, LedgerKey const& key);
+    void setBloomBits(uint64_t h);
+    bool testBloomBits(uint64_t h) const;
+
+  public:
+    // Target number of bucket-file bytes covered by each page.
+    static size_t const kPageBytes;
+
+    // Bloom filter sizing: bits per key and probes per key. The defaults give
+    // a false-positive rate of roughly 1%.
+    static size_t const kBloomBitsPerKey;
+    static size_t const kBloomProbes;
+
+    // Accumulates the keys and offsets of a bucket file being written, in
+    // order, and produces its index when the file is complete.
+    class Builder
+    {
+        ShortHashKey mHashKey;
+        std::vector<uint64_t> mHashes;
+        std::vector<LedgerKey> mPageKeys;
+        std::vector<uint64_t> mPageOffsets;
+
+      public:
+        Builder();
+
+        // Record that the entry with `key` starts at byte `offset` of the
+        // bucket file. Must be called in file order.
+        void add(LedgerKey const& key, size_t offset);
+
+        // Produce the index for a bucket file of `fileSize` bytes.
+        std::unique_ptr<BucketIndex const> finish(size_t fileSize);
+    };
+
+    // Build the index of an existing bucket file by scanning it once.
+    static std::unique_ptr<BucketIndex const>
+    build(std::string const& bucketFilename);
+
+    // Load an index previously written by `save`. Returns nullptr if the
+    // file is missing, unreadable or of an unknown version, in which case the
+    // caller should rebuild it.
+    static std::unique_ptr<BucketIndex const>
+    load(std::string const& indexFilename);
+
+    // Write the index to `indexFilename`, atomically replacing any existing
+    // file of that name.
+    void save(std::string const& indexFilename) const;
+
+    // Return the name of the sidecar index file for a given bucket file.
+    static std::string indexFilename(std::string const& bucketFilename);
+
+    // Return false if `key` is definitely not in the bucket.
+    bool mayContain(LedgerKey const& key) const;
+
+    // If `key` may be in the bucket, return true and set [begin, end) to the
+    // only byte range of the bucket file that could hold it. Otherwise return
+    // false.
+    bool lookup(LedgerKey const& key, size_t& begin, size_t& end) const;
+
+    size_t getEntryCount() const;
+    size_t getPageCount() const;
+};
+}
@@ -0,0 +1,110 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "bucket/BucketKeySet.h"
+#include "bucket/Bucket.h"
+#include "crypto/ShortHash.h"
+#include "util/Logging.h"
+#include "util/XDRStream.h"
+#include "xdrpp/marshal.h"
+
+#include <cstring>
+
+namespace stellar
+{
+
+static ShortHashKey const&
+keySetHashKey()
+{
+    static ShortHashKey const key = shortHash::randomKey();
+    return key;
+}
+
+uint64_t
+BucketKeySet::hashKey(uint8_t const* key, size_t len)
+{
+    return shortHash::computeHash(keySetHashKey(), ByteSlice(key, len));
+}
+
+void
+BucketKeySet::insert(uint64_t hash, uint32_t keyIndex)
+{
+    size_t mask = mSlotHashes.size() - 1;
+    size_t i = hash & mask;
+    while (mSlotKeys[i] != 0)
+    {
+        i = (i + 1) & mask;
+    }
+    mSlotHashes[i] = hash;
+    mSlotKeys[i] = keyIndex + 1;
+}
+
+std::unique_ptr<BucketKeySet const>
+BucketKeySet::build(std::string const& bucketFilename)
+{
+    CLOG(DEBUG, "Bucket") << "Building key set for bucket file "
+                          << bucketFilename;
+    std::unique_ptr<BucketKeySet> ks(new BucketKeySet());
+    std::vector<uint64_t> hashes;
+
+    XDRInputFileStream in;
+    in.open(bucketFilename);
+    char const* rec;
+    size_t len;
+    BucketEntryType type;
+    LedgerKey key;
+    ks->mKeyOffsets.push_back(0);
+    while (in.readRecord(rec, len))
+    {
+        size_t off = Bucket::decodeEntryKey(rec + 4, len - 4, type, key);
+        auto k = reinterpret_cast<uint8_t const*>(rec + 4 + off);
+        size_t klen = xdr::xdr_size(key);
+        ks->mKeys.insert(ks->mKeys.end(), k, k + klen);
+        ks->mKeyOffsets.push_back(ks->mKeys.size());
+        hashes.push_back(hashKey(k, klen));
+    }
+    ks->mKeys.shrink_to_fit();
+
+    // Keep the table at most half full.
+    size_t nslots = 16;
+    while (nslots < 2 * hashes.size())
+    {
+        nslots *= 2;
+    }
+    ks->mSlotHashes.resize(nslots, 0);
+    ks->mSlotKeys.resize(nslots, 0);
+    for (size_t i = 0; i < hashes.size(); ++i)
+    {
+        ks->insert(hashes[i], static_cast<uint32_t>(i));
+    }
+    return std::move(ks);
+}
+
+bool
+BucketKeySet::contains(uint64_t hash, uint8_t const* key, size_t len) const
+{
+    size_t mask = mSlotHashes.size() - 1;
+    for (size_t i = hash & mask; mSlotKeys[i] != 0; i = (i + 1) & mask)
+    {
+        if (mSlotHashes[i] != hash)
+        {
+            continue;
+        }
+        size_t k = mSlotKeys[i] - 1;
+        size_t begin = mKeyOffsets[k];
+        size_t end = mKeyOffsets[k + 1];
+        if (end - begin == len && std::memcmp(&mKeys[begin], key, len) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t
+BucketKeySet::size() const
+{
+    return mKeyOffsets.size() - 1;
+}
+}
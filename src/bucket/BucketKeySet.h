@@ -0,0 +1,60 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace stellar
+{
+
+/**
+ * BucketKeySet is an in-memory projection of a bucket onto just the keys of
+ * its entries (live or dead), used to check merge candidates against the
+ * buckets that shadow them without reading or decoding those buckets.
+ *
+ * Keys are held in their canonical XDR form, packed end to end in a single
+ * buffer, with an open-addressed table of their short hashes on top. A
+ * membership test costs one hash of the candidate key (shared across every
+ * set probed, see `hashKey`), typically one probe, and a memcmp to confirm.
+ * Since keys are compared exactly, hash collisions cost time but never
+ * correctness.
+ */
+class BucketKeySet : public NonMovableOrCopyable
+{
+    // Serialized keys, end to end; key i is the bytes
+    // [mKeyOffsets[i], mKeyOffsets[i+1]) of mKeys.
+    std::vector<uint8_t> mKeys;
+    std::vector<uint64_t> mKeyOffsets;
+
+    // Open-addressed hash table over the keys: for each occupied slot, the
+    // key's hash and its index + 1 (0 marks an empty slot).
+    std::vector<uint64_t> mSlotHashes;
+    std::vector<uint32_t> mSlotKeys;
+
+    BucketKeySet() = default;
+    void insert(uint64_t hash, uint32_t keyIndex);
+
+  public:
+    // Build the key set of the bucket file `bucketFilename` by scanning it
+    // once, decoding only the key of each entry.
+    static std::unique_ptr<BucketKeySet const>
+    build(std::string const& bucketFilename);
+
+    // Hash a serialized key for use with `contains`. All key sets in the
+    // process share a hash key, so a candidate is hashed once no matter how
+    // many sets it is checked against.
+    static uint64_t hashKey(uint8_t const* key, size_t len);
+
+    // Return true if the serialized key `key` of `len` bytes, whose hashKey
+    // is `hash`, is in the set.
+    bool contains(uint64_t hash, uint8_t const* key, size_t len) const;
+
+    size_t size() const;
+};
+}
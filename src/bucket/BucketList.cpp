@@ -135,8 +135,8 @@ BucketLevel::prepare(Application& app, uint32_t currLedger,
         }
     }
 
-    bool keepDeadEntries = mLevel < BucketList::kNumLevels - 1;
-    mNextCurr = FutureBucket(app, curr, snap, shadows, keepDeadEntries);
+    mNextCurr = FutureBucket(app, curr, snap, shadows,
+                             static_cast<uint32_t>(mLevel));
     assert(mNextCurr.isMerging());
 }
 
@@ -182,6 +182,39 @@ BucketList::getHash() const
     return hsh->finish();
 }
 
+std::vector<std::shared_ptr<Bucket>>
+BucketList::getBuckets() const
+{
+    std::vector<std::shared_ptr<Bucket>> buckets;
+    for (auto const& lev : mLevels)
+    {
+        buckets.push_back(lev.getCurr());
+        buckets.push_back(lev.getSnap());
+    }
+    return buckets;
+}
+
+std::shared_ptr<LedgerEntry>
+BucketList::getLedgerEntry(LedgerKey const& key) const
+{
+    BucketEntry be;
+    for (auto const& lev : mLevels)
+    {
+        for (auto const& b : {lev.getCurr(), lev.getSnap()})
+        {
+            if (b->getBucketEntry(key, be))
+            {
+                if (be.type() == LIVEENTRY)
+                {
+                    return std::make_shared<LedgerEntry>(be.liveEntry());
+                }
+                return nullptr;
+            }
+        }
+    }
+    return nullptr;
+}
+
 bool
 BucketList::levelShouldSpill(uint32_t ledger, size_t level)
 {
@@ -195,6 +228,12 @@ BucketList::levelShouldSpill(uint32_t ledger, size_t level)
             ledger == mask(ledger, levelSize(level)));
 }
 
+bool
+BucketList::keepDeadEntries(size_t level)
+{
+    return level < kNumLevels - 1;
+}
+
 BucketLevel&
 BucketList::getLevel(size_t i)
 {
@@ -205,8 +244,17 @@ void
 BucketList::addBatch(Application& app, uint32_t currLedger,
                      std::vector<LedgerEntry> const& liveEntries,
                      std::vector<LedgerKey> const& deadEntries)
+{
+    addBatch(app, currLedger,
+             Bucket::fresh(app.getBucketManager(), liveEntries, deadEntries));
+}
+
+void
+BucketList::addBatch(Application& app, uint32_t currLedger,
+                     std::shared_ptr<Bucket> batch)
 {
     assert(currLedger > 0);
+    assert(batch);
 
     std::vector<std::shared_ptr<Bucket>> shadows;
     for (auto& level : mLevels)
@@ -291,9 +339,7 @@ BucketList::addBatch(Application& app, uint32_t currLedger,
     }
 
     assert(shadows.size() == 0);
-    mLevels[0].prepare(app, currLedger, Bucket::fresh(app.getBucketManager(),
-                                                      liveEntries, deadEntries),
-                       shadows);
+    mLevels[0].prepare(app, currLedger, batch, shadows);
     mLevels[0].commit();
 }
 
@@ -306,7 +352,7 @@ BucketList::restartMerges(Application& app, uint32_t currLedger)
         auto& next = level.getNext();
         if (next.hasHashes() && !next.isLive())
         {
-            next.makeLive(app);
+            next.makeLive(app, static_cast<uint32_t>(i));
             if (next.isMerging())
             {
                 CLOG(INFO, "Bucket") << "Restarted merge on BucketList level "
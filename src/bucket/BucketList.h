@@ -282,6 +282,10 @@ class BucketList
     // should spill curr->snap and start merging snap into its next level.
     static bool levelShouldSpill(uint32_t ledger, size_t level);
 
+    // Returns true if merges into a given `level` should keep dead entries;
+    // only the last level can drop them, having nothing below to shadow.
+    static bool keepDeadEntries(size_t level);
+
     // Create a new BucketList with every `kNumLevels` levels, each with
     // an empty bucket in `curr` and `snap`.
     BucketList();
@@ -294,7 +298,19 @@ class BucketList
     // of the concatenation of the hashes of the `curr` and `snap` buckets.
     Hash getHash() const;
 
-    // Restart any merges that might be running on background worker threads,
+    // Return the `curr` and `snap` buckets of every level, newest first.
+    // Merges in progress are not waited for: their outputs only ever hold
+    // entries of buckets that are still in the list until they complete.
+    std::vector<std::shared_ptr<Bucket>> getBuckets() const;
+
+    // Look up the current state of `key` in the bucketlist, searching buckets
+    // from newest (level 0 curr) to oldest and stopping at the first one that
+    // mentions it. Returns the entry if that mention is a live entry, or
+    // nullptr if it is a tombstone or no bucket mentions `key`. Each bucket
+    // consults its index, so most buckets are ruled out without any I/O.
+    std::shared_ptr<LedgerEntry> getLedgerEntry(LedgerKey const& key) const;
+
+    // Restart any merges that might be running on background merge threads,
     // merging buckets between levels. This needs to be called after forcing a
     // BucketList to adopt a new state, either at application restart or when
     // catching up from buckets loaded over the network.
@@ -308,5 +324,9 @@ class BucketList
     void addBatch(Application& app, uint32_t currLedger,
                   std::vector<LedgerEntry> const& liveEntries,
                   std::vector<LedgerKey> const& deadEntries);
+
+    // As above, with the entries already made into a bucket by Bucket::fresh.
+    void addBatch(Application& app, uint32_t currLedger,
+                  std::shared_ptr<Bucket> batch);
 };
 }
@@ -7,6 +7,7 @@
 #include "bucket/Bucket.h"
 #include "overlay/StellarXDR.h"
 #include "util/NonCopyable.h"
+#include <future>
 #include <memory>
 
 #include "medida/timer_context.h"
@@ -15,7 +16,9 @@ namespace stellar
 {
 
 class Application;
+class BucketIndex;
 class BucketList;
+class BucketMergeScheduler;
 struct LedgerHeader;
 struct HistoryArchiveState;
 
@@ -56,6 +59,14 @@ class BucketManager : NonMovableOrCopyable
 
     virtual medida::Timer& getMergeTimer() = 0;
 
+    // Whether the buckets this BucketManager writes are stored
+    // block-compressed (see XDRBlockFormat), as set by COMPRESS_BUCKETS.
+    virtual bool getCompressBuckets() const = 0;
+
+    // Return the scheduler that runs the BucketList's background merges on
+    // the BucketManager's own thread pool.
+    virtual BucketMergeScheduler& getMergeScheduler() = 0;
+
     // Get a reference to a persistent bucket (in the BucketManager's bucket
     // directory), from the BucketManager's shared bucket-set.
     //
@@ -64,14 +75,21 @@ class BucketManager : NonMovableOrCopyable
     // otherwise move `filename` to the bucket directory, stored under `hash`,
     // and return a new bucket pointing to that.
     //
+    // The new bucket is given `index` as its key index, or an index built by
+    // scanning `filename` if none is provided; either way the index is saved
+    // alongside the bucket file.
+    //
     // This method is mostly-threadsafe -- assuming you don't destruct the
     // BucketManager mid-call -- and is intended to be called from both main and
     // worker threads. Very carefully.
     virtual std::shared_ptr<Bucket>
     adoptFileAsBucket(std::string const& filename, uint256 const& hash,
-                      size_t nObjects = 0, size_t nBytes = 0) = 0;
+                      size_t nObjects = 0, size_t nBytes = 0,
+                      std::shared_ptr<BucketIndex const> index = nullptr) = 0;
 
-    // Return a bucket by hash if we have it, else return nullptr.
+    // Return a bucket by hash if we have it, else return nullptr. Buckets
+    // found on disk but not yet in memory have their saved index loaded, or
+    // rebuilt if it is missing.
     virtual std::shared_ptr<Bucket> getBucketByHash(uint256 const& hash) = 0;
 
     // Forget any buckets not referenced by the current BucketList. This will
@@ -85,6 +103,17 @@ class BucketManager : NonMovableOrCopyable
                           std::vector<LedgerEntry> const& liveEntries,
                           std::vector<LedgerKey> const& deadEntries) = 0;
 
+    // Start making a batch of entries into a bucket (see Bucket::fresh) on
+    // a thread of its own, ahead of feeding it to the bucket list with the
+    // addBatch below, which waits for it. This lets the caller get on with
+    // other work meanwhile; errors are rethrown by addBatch.
+    virtual std::shared_future<std::shared_ptr<Bucket>>
+    prepareBatch(std::vector<LedgerEntry> liveEntries,
+                 std::vector<LedgerKey> deadEntries) = 0;
+    virtual void
+    addBatch(Application& app, uint32_t currLedger,
+             std::shared_future<std::shared_ptr<Bucket>> const& batch) = 0;
+
     // Update the given LedgerHeader's bucketListHash to reflect the current
     // state of the bucket list.
     virtual void snapshotLedger(LedgerHeader& currentHeader) = 0;
@@ -3,7 +3,9 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "bucket/BucketManagerImpl.h"
+#include "bucket/BucketIndex.h"
 #include "bucket/BucketList.h"
+#include "bucket/BucketMergeScheduler.h"
 #include "crypto/Hex.h"
 #include "history/HistoryManager.h"
 #include "main/Application.h"
@@ -14,9 +16,12 @@
 #include "util/TmpDir.h"
 #include "util/make_unique.h"
 #include "util/types.h"
+#include <algorithm>
 #include <fstream>
+#include <future>
 #include <map>
 #include <set>
+#include <thread>
 
 #include "medida/counter.h"
 #include "medida/meter.h"
@@ -61,11 +66,23 @@ BucketManagerImpl::BucketManagerImpl(Application& app)
     , mBucketByteInsert(
           app.getMetrics().NewMeter({"bucket", "byte", "insert"}, "byte"))
     , mBucketAddBatch(app.getMetrics().NewTimer({"bucket", "batch", "add"}))
+    , mBucketPrepareBatch(
+          app.getMetrics().NewTimer({"bucket", "batch", "prepare"}))
     , mBucketSnapMerge(app.getMetrics().NewTimer({"bucket", "snap", "merge"}))
     , mSharedBucketsSize(
           app.getMetrics().NewCounter({"bucket", "memory", "shared"}))
 
 {
+    size_t nThreads = app.getConfig().BUCKET_MERGE_THREADS;
+    if (nThreads == 0)
+    {
+        nThreads = std::thread::hardware_concurrency();
+    }
+    // the scheduler only keeps a thread free for the shallow levels if it
+    // has more than one
+    nThreads = std::max<size_t>(nThreads, 2);
+    mMergeScheduler = make_unique<BucketMergeScheduler>(
+        app.getMetrics(), nThreads, BucketList::kNumLevels);
 }
 
 const std::string BucketManagerImpl::kLockFilename = "stellar-core.lock";
@@ -123,6 +140,10 @@ BucketManagerImpl::getBucketDir()
 
 BucketManagerImpl::~BucketManagerImpl()
 {
+    // Merges in flight use the bucket and tmp directories, so stop them before
+    // anything else is torn down.
+    mMergeScheduler->shutdown();
+
     if (mLockedBucketDir)
     {
         std::string d = mApp.getConfig().BUCKET_DIR_PATH;
@@ -132,6 +153,12 @@ BucketManagerImpl::~BucketManagerImpl()
     }
 }
 
+BucketMergeScheduler&
+BucketManagerImpl::getMergeScheduler()
+{
+    return *mMergeScheduler;
+}
+
 BucketList&
 BucketManagerImpl::getBucketList()
 {
@@ -144,10 +171,17 @@ BucketManagerImpl::getMergeTimer()
     return mBucketSnapMerge;
 }
 
+bool
+BucketManagerImpl::getCompressBuckets() const
+{
+    return mApp.getConfig().COMPRESS_BUCKETS;
+}
+
 std::shared_ptr<Bucket>
 BucketManagerImpl::adoptFileAsBucket(std::string const& filename,
                                      uint256 const& hash, size_t nObjects,
-                                     size_t nBytes)
+                                     size_t nBytes,
+                                     std::shared_ptr<BucketIndex const> index)
 {
     std::lock_guard<std::recursive_mutex> lock(mBucketMutex);
     // Check to see if we have an existing bucket (either in-memory or on-disk)
@@ -172,7 +206,12 @@ BucketManagerImpl::adoptFileAsBucket(std::string const& filename,
             throw std::runtime_error(err);
         }
 
-        b = std::make_shared<Bucket>(canonicalName, hash);
+        if (!index)
+        {
+            index = BucketIndex::build(canonicalName);
+        }
+        index->save(BucketIndex::indexFilename(canonicalName));
+        b = std::make_shared<Bucket>(canonicalName, hash, index);
         {
             mSharedBuckets.insert(std::make_pair(hash, b));
             mSharedBucketsSize.set_count(mSharedBuckets.size());
@@ -204,7 +243,14 @@ BucketManagerImpl::getBucketByHash(uint256 const& hash)
         CLOG(TRACE, "Bucket") << "BucketManager::getBucketByHash("
                               << binToHex(hash)
                               << ") found no bucket, making new one";
-        auto p = std::make_shared<Bucket>(canonicalName, hash);
+        std::string indexName = BucketIndex::indexFilename(canonicalName);
+        std::shared_ptr<BucketIndex const> index = BucketIndex::load(indexName);
+        if (!index)
+        {
+            index = BucketIndex::build(canonicalName);
+            index->save(indexName);
+        }
+        auto p = std::make_shared<Bucket>(canonicalName, hash, index);
         mSharedBuckets.insert(std::make_pair(hash, p));
         mSharedBucketsSize.set_count(mSharedBuckets.size());
         return p;
@@ -285,6 +331,33 @@ BucketManagerImpl::addBatch(Application& app, uint32_t currLedger,
     mBucketList.addBatch(app, currLedger, liveEntries, deadEntries);
 }
 
+std::shared_future<std::shared_ptr<Bucket>>
+BucketManagerImpl::prepareBatch(std::vector<LedgerEntry> liveEntries,
+                                std::vector<LedgerKey> deadEntries)
+{
+    auto live = std::make_shared<std::vector<LedgerEntry>>(
+        std::move(liveEntries));
+    auto dead =
+        std::make_shared<std::vector<LedgerKey>>(std::move(deadEntries));
+    // On a thread of its own rather than the merge threads: those may all be
+    // busy with merges, which the ledger close must not wait for.
+    return std::async(std::launch::async,
+                      [this, live, dead]() {
+                          auto timer = mBucketPrepareBatch.TimeScope();
+                          return Bucket::fresh(*this, *live, *dead);
+                      })
+        .share();
+}
+
+void
+BucketManagerImpl::addBatch(
+    Application& app, uint32_t currLedger,
+    std::shared_future<std::shared_ptr<Bucket>> const& batch)
+{
+    auto timer = mBucketAddBatch.TimeScope();
+    mBucketList.addBatch(app, currLedger, batch.get());
+}
+
 // updates the given LedgerHeader to reflect the current state of the bucket
 // list
 void
@@ -26,7 +26,9 @@ namespace stellar
 class TmpDir;
 class Application;
 class Bucket;
+class BucketIndex;
 class BucketList;
+class BucketMergeScheduler;
 struct HistoryArchiveState;
 
 class BucketManagerImpl : public BucketManager
@@ -42,8 +44,10 @@ class BucketManagerImpl : public BucketManager
     medida::Meter& mBucketObjectInsert;
     medida::Meter& mBucketByteInsert;
     medida::Timer& mBucketAddBatch;
+    medida::Timer& mBucketPrepareBatch;
     medida::Timer& mBucketSnapMerge;
     medida::Counter& mSharedBucketsSize;
+    std::unique_ptr<BucketMergeScheduler> mMergeScheduler;
 
   protected:
     void calculateSkipValues(LedgerHeader& currentHeader);
@@ -57,16 +61,24 @@ class BucketManagerImpl : public BucketManager
     std::string const& getBucketDir() override;
     BucketList& getBucketList() override;
     medida::Timer& getMergeTimer() override;
-    std::shared_ptr<Bucket> adoptFileAsBucket(std::string const& filename,
-                                              uint256 const& hash,
-                                              size_t nObjects,
-                                              size_t nBytes) override;
+    bool getCompressBuckets() const override;
+    BucketMergeScheduler& getMergeScheduler() override;
+    std::shared_ptr<Bucket>
+    adoptFileAsBucket(std::string const& filename, uint256 const& hash,
+                      size_t nObjects, size_t nBytes,
+                      std::shared_ptr<BucketIndex const> index) override;
     std::shared_ptr<Bucket> getBucketByHash(uint256 const& hash) override;
 
     void forgetUnreferencedBuckets() override;
     void addBatch(Application& app, uint32_t currLedger,
                   std::vector<LedgerEntry> const& liveEntries,
                   std::vector<LedgerKey> const& deadEntries) override;
+    std::shared_future<std::shared_ptr<Bucket>>
+    prepareBatch(std::vector<LedgerEntry> liveEntries,
+                 std::vector<LedgerKey> deadEntries) override;
+    void
+    addBatch(Application& app, uint32_t currLedger,
+             std::shared_future<std::shared_ptr<Bucket>> const& batch) override;
     void snapshotLedger(LedgerHeader& currentHeader) override;
 
     std::vector<std::string>
@@ -0,0 +1,188 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "bucket/BucketMergeScheduler.h"
+#include "util/Logging.h"
+
+#include "medida/counter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <string>
+
+namespace stellar
+{
+
+uint32_t const BucketMergeScheduler::kFirstDeepLevel = 4;
+
+BucketMergeScheduler::BucketMergeScheduler(medida::MetricsRegistry& metrics,
+                                           size_t nThreads, size_t nLevels)
+    : mThreadCount(nThreads)
+    , mQueueDepth(metrics.NewCounter({"bucket", "merge", "queue-depth"}))
+    , mRunningCount(metrics.NewCounter({"bucket", "merge", "running"}))
+{
+    assert(nThreads > 0);
+    for (size_t i = 0; i < nLevels; ++i)
+    {
+        mLevelTimers.push_back(&metrics.NewTimer(
+            {"bucket", "merge-time", "level-" + std::to_string(i)}));
+    }
+    CLOG(DEBUG, "Bucket") << "Starting " << nThreads << " bucket merge threads";
+    for (size_t i = 0; i < nThreads; ++i)
+    {
+        mThreads.emplace_back([this]() { runWorker(); });
+    }
+}
+
+BucketMergeScheduler::~BucketMergeScheduler()
+{
+    shutdown();
+}
+
+bool
+BucketMergeScheduler::isDeep(uint32_t level) const
+{
+    return level >= kFirstDeepLevel;
+}
+
+// Call with mMutex held.
+bool
+BucketMergeScheduler::canStartNext() const
+{
+    if (mQueue.empty())
+    {
+        return false;
+    }
+    // The front of the heap is the shallowest queued merge; if even that one
+    // is deep, only start it if that still leaves a thread for shallow levels
+    // (a lone thread can't be held back; BucketManager never has just one).
+    return !isDeep(mQueue.front().mLevel) || mThreadCount == 1 ||
+           mRunningDeep + 1 < mThreadCount;
+}
+
+void
+BucketMergeScheduler::runWorker()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true)
+    {
+        mWorkAvailable.wait(lock,
+                            [this]() { return mShutdown || canStartNext(); });
+        if (mShutdown)
+        {
+            return;
+        }
+
+        std::pop_heap(mQueue.begin(), mQueue.end(), QueuedMergeCmp());
+        QueuedMerge m = std::move(mQueue.back());
+        mQueue.pop_back();
+        mQueueDepth.dec();
+        bool deep = isDeep(m.mLevel);
+        ++mRunning;
+        mRunningDeep += deep ? 1 : 0;
+        mRunningCount.inc();
+
+        lock.unlock();
+        {
+            medida::Timer* timer =
+                m.mLevel < mLevelTimers.size() ? mLevelTimers[m.mLevel]
+                                               : nullptr;
+            auto start = std::chrono::steady_clock::now();
+            m.mTask();
+            if (timer)
+            {
+                timer->Update(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start));
+            }
+            // Release the task (and whatever buckets it captured) before
+            // reporting it as finished.
+            m.mTask = nullptr;
+        }
+        lock.lock();
+
+        --mRunning;
+        mRunningDeep -= deep ? 1 : 0;
+        mRunningCount.dec();
+        if (deep)
+        {
+            // A deep slot freed up; another worker may now be allowed to take
+            // a queued deep merge.
+            mWorkAvailable.notify_all();
+        }
+        if (mRunning == 0 && mQueue.empty())
+        {
+            mIdle.notify_all();
+        }
+    }
+}
+
+void
+BucketMergeScheduler::enqueue(uint32_t level, std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mShutdown)
+        {
+            CLOG(WARNING, "Bucket") << "Dropping merge on level " << level
+                                    << " enqueued after shutdown";
+            return;
+        }
+        mQueue.push_back(QueuedMerge{level, mNextSeq++, std::move(task)});
+        std::push_heap(mQueue.begin(), mQueue.end(), QueuedMergeCmp());
+        mQueueDepth.inc();
+    }
+    mWorkAvailable.notify_all();
+}
+
+void
+BucketMergeScheduler::waitForIdle()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdle.wait(lock, [this]() {
+        return mShutdown || (mRunning == 0 && mQueue.empty());
+    });
+}
+
+void
+BucketMergeScheduler::shutdown()
+{
+    std::vector<QueuedMerge> dropped;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mShutdown)
+        {
+            return;
+        }
+        mShutdown = true;
+        dropped.swap(mQueue);
+        mQueueDepth.clear();
+    }
+    mWorkAvailable.notify_all();
+    mIdle.notify_all();
+    if (!dropped.empty())
+    {
+        CLOG(DEBUG, "Bucket") << "Dropping " << dropped.size()
+                              << " queued bucket merges at shutdown";
+    }
+    // Destroying the dropped tasks outside the lock breaks their promises,
+    // so anyone still waiting on them sees an error rather than hanging.
+    dropped.clear();
+    for (auto& t : mThreads)
+    {
+        t.join();
+    }
+    CLOG(DEBUG, "Bucket") << "Joined " << mThreadCount
+                          << " bucket merge threads";
+}
+
+size_t
+BucketMergeScheduler::getThreadCount() const
+{
+    return mThreadCount;
+}
+}
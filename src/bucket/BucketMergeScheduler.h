@@ -0,0 +1,104 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace medida
+{
+class Counter;
+class MetricsRegistry;
+class Timer;
+}
+
+namespace stellar
+{
+
+/**
+ * BucketMergeScheduler runs the background merges of the BucketList on a
+ * bounded pool of threads of its own, rather than on the application's
+ * general-purpose worker threads.
+ *
+ * Merges are queued with the BucketList level they belong to and are started
+ * shallowest-level first (FIFO within a level). Shallow levels merge often and
+ * must finish within a few ledgers, while deep levels merge rarely but can take
+ * a long time; so at most `nThreads - 1` threads are ever given to deep levels
+ * (those at or below kFirstDeepLevel), leaving one free to pick up shallow
+ * merges as soon as they are queued. With a single thread nothing can be held
+ * back and merges simply run in priority order; BucketManager always uses at
+ * least two.
+ *
+ * Tasks are arbitrary callables; FutureBucket enqueues a packaged_task whose
+ * shared_future it holds, so errors are propagated through the future as
+ * before.
+ */
+class BucketMergeScheduler : public NonMovableOrCopyable
+{
+    struct QueuedMerge
+    {
+        uint32_t mLevel;
+        uint64_t mSeq;
+        std::function<void()> mTask;
+    };
+
+    // Heap ordering: the top of the heap is the lowest level, then the
+    // earliest queued.
+    struct QueuedMergeCmp
+    {
+        bool
+        operator()(QueuedMerge const& a, QueuedMerge const& b) const
+        {
+            return a.mLevel != b.mLevel ? a.mLevel > b.mLevel
+                                        : a.mSeq > b.mSeq;
+        }
+    };
+
+    size_t const mThreadCount;
+    std::mutex mMutex;
+    std::condition_variable mWorkAvailable;
+    std::condition_variable mIdle;
+    std::vector<QueuedMerge> mQueue;
+    uint64_t mNextSeq{0};
+    size_t mRunning{0};
+    size_t mRunningDeep{0};
+    bool mShutdown{false};
+    std::vector<std::thread> mThreads;
+
+    medida::Counter& mQueueDepth;
+    medida::Counter& mRunningCount;
+    std::vector<medida::Timer*> mLevelTimers;
+
+    bool isDeep(uint32_t level) const;
+    bool canStartNext() const;
+    void runWorker();
+
+  public:
+    // Levels at or below this one are considered "deep".
+    static uint32_t const kFirstDeepLevel;
+
+    BucketMergeScheduler(medida::MetricsRegistry& metrics, size_t nThreads,
+                         size_t nLevels);
+    ~BucketMergeScheduler();
+
+    // Queue `task` to run as a merge on BucketList level `level`. Tasks
+    // enqueued after shutdown() are dropped.
+    void enqueue(uint32_t level, std::function<void()> task);
+
+    // Block until no merge is queued or running.
+    void waitForIdle();
+
+    // Stop accepting merges, drop any that have not started, and wait for
+    // running ones to finish. Idempotent.
+    void shutdown();
+
+    size_t getThreadCount() const;
+};
+}
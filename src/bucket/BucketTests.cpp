@@ -8,17 +8,23 @@
 #include "util/asio.h"
 
 #include "bucket/Bucket.h"
+#include "bucket/BucketApplicator.h"
+#include "bucket/BucketIndex.h"
+#include "bucket/BucketKeySet.h"
 #include "bucket/BucketList.h"
 #include "bucket/BucketManager.h"
 #include "bucket/BucketManagerImpl.h"
+#include "bucket/BucketMergeScheduler.h"
 #include "bucket/LedgerCmp.h"
 #include "crypto/Hex.h"
+#include "crypto/SHA.h"
 #include "database/Database.h"
 #include "herder/LedgerCloseData.h"
 #include "ledger/LedgerManager.h"
 #include "ledger/LedgerTestUtils.h"
 #include "lib/catch.hpp"
 #include "main/Application.h"
+#include "medida/counter.h"
 #include "medida/meter.h"
 #include "medida/metrics_registry.h"
 #include "medida/timer.h"
@@ -27,10 +33,18 @@
 #include "util/Logging.h"
 #include "util/Timer.h"
 #include "util/TmpDir.h"
+#include "util/XDRStream.h"
 #include "util/types.h"
 #include "xdrpp/autocheck.h"
+#include "xdrpp/marshal.h"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
 #include <future>
+#include <map>
+#include <set>
+#include <thread>
 
 using namespace stellar;
 
@@ -337,6 +351,36 @@ TEST_CASE("duplicate bucket entries", "[bucket]")
     }
 }
 
+TEST_CASE("fresh bucket matches merged live and dead buckets", "[bucket]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer app = Application::create(clock, cfg);
+    auto& bm = app->getBucketManager();
+
+    autocheck::generator<std::vector<LedgerKey>> deadGen;
+    auto live = LedgerTestUtils::generateValidLedgerEntries(100);
+    auto dead = deadGen(50);
+    // some keys are both live and dead in the same batch
+    for (size_t i = 0; i < 10; ++i)
+    {
+        dead.emplace_back(LedgerEntryKey(live[i]));
+    }
+
+    auto b = Bucket::fresh(bm, live, dead);
+    auto merged = Bucket::merge(bm, Bucket::fresh(bm, live, {}),
+                                Bucket::fresh(bm, {}, dead));
+    REQUIRE(b->getHash() == merged->getHash());
+
+    BucketEntry e;
+    for (size_t i = 0; i < 10; ++i)
+    {
+        REQUIRE(b->getBucketEntry(LedgerEntryKey(live[i]), e));
+        REQUIRE(e.type() == DEADENTRY);
+    }
+    REQUIRE(Bucket::fresh(bm, {}, {})->getHash() == Hash());
+}
+
 TEST_CASE("bucket tombstones expire at bottom level", "[bucket][tombstones]")
 {
     VirtualClock clock;
@@ -432,6 +476,134 @@ TEST_CASE("file-backed buckets", "[bucket][bucketbench]")
     CLOG(DEBUG, "Bucket") << "Spill file size: " << fileSize(b1->getFilename());
 }
 
+TEST_CASE("bucket file stream bench", "[bucketbench][hide]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer app = Application::create(clock, cfg);
+
+    size_t const n = 200000;
+    std::vector<BucketEntry> entries(n);
+    for (auto& e : entries)
+    {
+        e.type(LIVEENTRY);
+        e.liveEntry() = LedgerTestUtils::generateValidLedgerEntry(3);
+    }
+    std::string tmp = app->getBucketManager().getTmpDir();
+    std::string oldName = tmp + "/stream-bench-old.xdr";
+    std::string newName = tmp + "/stream-bench-new.xdr";
+
+    auto report = [&](std::string const& what,
+                      std::chrono::steady_clock::duration d) {
+        double secs = std::chrono::duration<double>(d).count();
+        CLOG(INFO, "Bucket") << what << ": " << n << " records in " << secs
+                             << "s, " << static_cast<uint64_t>(n / secs)
+                             << " records/sec";
+    };
+
+    // The per-record iostream path the XDR streams used to take: one
+    // write() per record, and two read()s per record.
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::ofstream out(oldName, std::ofstream::binary);
+        std::vector<char> buf;
+        for (auto const& e : entries)
+        {
+            uint32_t sz = static_cast<uint32_t>(xdr::xdr_size(e));
+            buf.resize(sz + 4);
+            buf[0] = static_cast<char>((sz >> 24) & 0xFF) | '\x80';
+            buf[1] = static_cast<char>((sz >> 16) & 0xFF);
+            buf[2] = static_cast<char>((sz >> 8) & 0xFF);
+            buf[3] = static_cast<char>(sz & 0xFF);
+            xdr::xdr_put p(buf.data() + 4, buf.data() + 4 + sz);
+            xdr::xdr_argpack_archive(p, e);
+            out.write(buf.data(), sz + 4);
+        }
+        out.close();
+        report("iostream write", std::chrono::steady_clock::now() - start);
+    }
+    {
+        auto start = std::chrono::steady_clock::now();
+        XDROutputFileStream out;
+        out.open(newName);
+        for (auto const& e : entries)
+        {
+            out.writeOne(e);
+        }
+        out.close();
+        report("buffered write", std::chrono::steady_clock::now() - start);
+    }
+    REQUIRE(fileSize(oldName) == fileSize(newName));
+
+    size_t nread = 0;
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::ifstream in(oldName, std::ifstream::binary);
+        std::vector<char> buf;
+        BucketEntry e;
+        char szBuf[4];
+        while (in.read(szBuf, 4))
+        {
+            uint32_t sz = ((static_cast<uint8_t>(szBuf[0]) & 0x7f) << 24) |
+                          (static_cast<uint8_t>(szBuf[1]) << 16) |
+                          (static_cast<uint8_t>(szBuf[2]) << 8) |
+                          static_cast<uint8_t>(szBuf[3]);
+            buf.resize(sz);
+            REQUIRE(in.read(buf.data(), sz));
+            xdr::xdr_get g(buf.data(), buf.data() + sz);
+            xdr::xdr_argpack_archive(g, e);
+            ++nread;
+        }
+        report("iostream read", std::chrono::steady_clock::now() - start);
+    }
+    REQUIRE(nread == n);
+
+    nread = 0;
+    {
+        auto start = std::chrono::steady_clock::now();
+        XDRInputFileStream in;
+        in.open(newName);
+        BucketEntry e;
+        while (in.readOne(e))
+        {
+            ++nread;
+        }
+        report("buffered read", std::chrono::steady_clock::now() - start);
+    }
+    REQUIRE(nread == n);
+}
+
+#ifdef USE_ZLIB
+TEST_CASE("bucket compression bench", "[bucketbench][hide]")
+{
+    size_t const n = 200000;
+    auto older = LedgerTestUtils::generateValidLedgerEntries(n);
+    auto newer = LedgerTestUtils::generateValidLedgerEntries(n);
+
+    for (bool compress : {false, true})
+    {
+        VirtualClock clock;
+        Config cfg(getTestConfig());
+        cfg.COMPRESS_BUCKETS = compress;
+        Application::pointer app = Application::create(clock, cfg);
+        auto& bm = app->getBucketManager();
+
+        auto b1 = Bucket::fresh(bm, older, {});
+        auto b2 = Bucket::fresh(bm, newer, {});
+        auto start = std::chrono::steady_clock::now();
+        auto merged = Bucket::merge(bm, b1, b2);
+        double secs = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+        CLOG(INFO, "Bucket")
+            << (compress ? "compressed" : "plain") << " merge: " << 2 * n
+            << " entries in " << secs << "s, "
+            << static_cast<uint64_t>(2 * n / secs) << " entries/sec, "
+            << fileSize(merged->getFilename()) << " bytes on disk";
+    }
+}
+#endif
+
 TEST_CASE("merging bucket entries", "[bucket]")
 {
     VirtualClock clock;
@@ -533,6 +705,392 @@ TEST_CASE("merging bucket entries", "[bucket]")
             Bucket::merge(app->getBucketManager(), b1, b2);
         CHECK(countEntries(b3) == liveCount);
     }
+    SECTION("merging copies records through byte-for-byte")
+    {
+        std::vector<LedgerEntry> oldLive(100), newLive;
+        std::vector<LedgerKey> dead;
+        std::map<LedgerKey, LedgerEntry, LedgerEntryIdCmp> expected;
+        for (auto& e : oldLive)
+        {
+            e = LedgerTestUtils::generateValidLedgerEntry(10);
+            if (flip())
+            {
+                // Same key, new contents.
+                LedgerEntry n = e;
+                n.lastModifiedLedgerSeq = e.lastModifiedLedgerSeq + 1;
+                newLive.push_back(n);
+            }
+            if (flip())
+            {
+                dead.push_back(LedgerEntryKey(e));
+            }
+        }
+        for (auto const& e : oldLive)
+        {
+            expected[LedgerEntryKey(e)] = e;
+        }
+        for (auto const& e : newLive)
+        {
+            expected[LedgerEntryKey(e)] = e;
+        }
+        std::vector<LedgerEntry> combined;
+        for (auto const& kv : expected)
+        {
+            combined.push_back(kv.second);
+        }
+
+        std::shared_ptr<Bucket> b1 =
+            Bucket::fresh(app->getBucketManager(), oldLive, {});
+        std::shared_ptr<Bucket> b2 =
+            Bucket::fresh(app->getBucketManager(), newLive, {});
+        std::shared_ptr<Bucket> b3 =
+            Bucket::merge(app->getBucketManager(), b1, b2);
+        CHECK(b3->getHash() ==
+              Bucket::fresh(app->getBucketManager(), combined, {})->getHash());
+
+        // Tombstones are copied through as well, and dropped at the bottom
+        // level.
+        std::shared_ptr<Bucket> b4 =
+            Bucket::fresh(app->getBucketManager(), {}, dead);
+        std::shared_ptr<Bucket> b5 =
+            Bucket::merge(app->getBucketManager(), b3, b4);
+        CHECK(b5->getHash() ==
+              Bucket::fresh(app->getBucketManager(), combined, dead)
+                  ->getHash());
+        std::shared_ptr<Bucket> b6 = Bucket::merge(
+            app->getBucketManager(), b3, b4, {}, /* keepDeadEntries */ false);
+        CHECK(countEntries(b6) == combined.size() - dead.size());
+        CHECK(b6->countLiveAndDeadEntries().second == 0);
+    }
+}
+
+TEST_CASE("bucket index lookups", "[bucket][bucketindex]")
+{
+    using xdr::operator==;
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer app = Application::create(clock, cfg);
+    auto& bm = app->getBucketManager();
+
+    autocheck::generator<LedgerKey> deadGen;
+    std::vector<LedgerEntry> live(
+        LedgerTestUtils::generateValidLedgerEntries(1000));
+    std::vector<LedgerKey> dead;
+    std::set<LedgerKey, LedgerEntryIdCmp> deadKeys, allKeys;
+    for (size_t i = 0; i < 100; ++i)
+    {
+        dead.push_back(deadGen(5));
+        deadKeys.insert(dead.back());
+        allKeys.insert(dead.back());
+    }
+    for (auto const& le : live)
+    {
+        allKeys.insert(LedgerEntryKey(le));
+    }
+    std::shared_ptr<Bucket> b = Bucket::fresh(bm, live, dead);
+    REQUIRE(b->getIndex());
+    REQUIRE(b->getIndex()->getPageCount() > 1);
+    CHECK(b->getIndex()->getEntryCount() == allKeys.size());
+    CHECK(fs::exists(BucketIndex::indexFilename(b->getFilename())));
+
+    auto checkLookups = [&](Bucket const& bucket) {
+        BucketEntry e;
+        for (auto const& le : live)
+        {
+            auto key = LedgerEntryKey(le);
+            REQUIRE(bucket.getBucketEntry(key, e));
+            if (deadKeys.find(key) == deadKeys.end())
+            {
+                REQUIRE(e.type() == LIVEENTRY);
+                REQUIRE(e.liveEntry() == le);
+            }
+        }
+        for (auto const& k : dead)
+        {
+            REQUIRE(bucket.getBucketEntry(k, e));
+            REQUIRE(e.type() == DEADENTRY);
+            REQUIRE(e.deadEntry() == k);
+        }
+        for (size_t i = 0; i < 100; ++i)
+        {
+            auto k = deadGen(5);
+            bool expected = allKeys.find(k) != allKeys.end();
+            REQUIRE(bucket.getBucketEntry(k, e) == expected);
+        }
+    };
+
+    SECTION("lookups through freshly built index")
+    {
+        checkLookups(*b);
+    }
+
+    SECTION("lookups through reloaded index")
+    {
+        auto idx =
+            BucketIndex::load(BucketIndex::indexFilename(b->getFilename()));
+        REQUIRE(idx);
+        CHECK(idx->getEntryCount() == b->getIndex()->getEntryCount());
+        CHECK(idx->getPageCount() == b->getIndex()->getPageCount());
+        auto b2 = std::make_shared<Bucket>(b->getFilename(), b->getHash(),
+                                           std::move(idx));
+        b2->setRetain(true);
+        checkLookups(*b2);
+    }
+
+    SECTION("lookups through rebuilt index")
+    {
+        auto idx = BucketIndex::build(b->getFilename());
+        CHECK(idx->getEntryCount() == b->getIndex()->getEntryCount());
+        CHECK(idx->getPageCount() == b->getIndex()->getPageCount());
+        auto b2 = std::make_shared<Bucket>(b->getFilename(), b->getHash(),
+                                           std::move(idx));
+        b2->setRetain(true);
+        checkLookups(*b2);
+    }
+
+    SECTION("lookups through the bucketlist")
+    {
+        auto& bl = bm.getBucketList();
+        bl.addBatch(*app, 1, live, {});
+        std::vector<LedgerEntry> newer(live.begin(), live.begin() + 10);
+        for (auto& le : newer)
+        {
+            le.lastModifiedLedgerSeq += 1;
+        }
+        std::vector<LedgerKey> killed{LedgerEntryKey(live[10])};
+        bl.addBatch(*app, 2, newer, killed);
+        for (auto const& le : newer)
+        {
+            auto found = bl.getLedgerEntry(LedgerEntryKey(le));
+            REQUIRE(found);
+            REQUIRE(*found == le);
+        }
+        CHECK(!bl.getLedgerEntry(killed[0]));
+        auto found = bl.getLedgerEntry(LedgerEntryKey(live[11]));
+        REQUIRE(found);
+        REQUIRE(*found == live[11]);
+    }
+}
+
+#ifdef USE_ZLIB
+TEST_CASE("block-compressed bucket files", "[bucket][bucketcompress]")
+{
+    using xdr::operator==;
+    VirtualClock clock;
+    Config cfgPlain(getTestConfig(0));
+    Config cfgCompressed(getTestConfig(1));
+    cfgCompressed.COMPRESS_BUCKETS = true;
+    Application::pointer appPlain = Application::create(clock, cfgPlain);
+    Application::pointer appCompressed =
+        Application::create(clock, cfgCompressed);
+
+    auto older = LedgerTestUtils::generateValidLedgerEntries(2000);
+    auto newer = LedgerTestUtils::generateValidLedgerEntries(2000);
+    std::vector<LedgerKey> dead{LedgerEntryKey(older[0])};
+
+    auto mergeOn = [&](Application& app) {
+        auto& bm = app.getBucketManager();
+        return Bucket::merge(bm, Bucket::fresh(bm, older, {}),
+                             Bucket::fresh(bm, newer, dead));
+    };
+    auto plain = mergeOn(*appPlain);
+    auto compressed = mergeOn(*appCompressed);
+
+    // Same bucket, in less space.
+    CHECK(!XDRBlockFormat::isBlockCompressed(plain->getFilename()));
+    REQUIRE(XDRBlockFormat::isBlockCompressed(compressed->getFilename()));
+    CHECK(compressed->getHash() == plain->getHash());
+    CHECK(fileSize(compressed->getFilename()) <
+          fileSize(plain->getFilename()));
+    CHECK(compressed->countLiveAndDeadEntries() ==
+          plain->countLiveAndDeadEntries());
+
+    // The hash is that of the plain records the stream reads back.
+    {
+        XDRInputFileStream in;
+        in.open(compressed->getFilename());
+        auto hasher = SHA256::create();
+        char const* rec;
+        size_t len;
+        while (in.readRecord(rec, len))
+        {
+            hasher->add(ByteSlice(rec, len));
+        }
+        CHECK(hasher->finish() == compressed->getHash());
+    }
+
+    // Index offsets are the same in both formats, and lookups seek through
+    // the compressed blocks.
+    auto idx = BucketIndex::build(compressed->getFilename());
+    CHECK(idx->getPageCount() == plain->getIndex()->getPageCount());
+    BucketEntry fromPlain, fromCompressed;
+    for (auto const& le : older)
+    {
+        auto key = LedgerEntryKey(le);
+        REQUIRE(plain->getBucketEntry(key, fromPlain));
+        REQUIRE(compressed->getBucketEntry(key, fromCompressed));
+        REQUIRE(fromCompressed == fromPlain);
+    }
+    for (auto const& le : newer)
+    {
+        REQUIRE(compressed->getBucketEntry(LedgerEntryKey(le), fromCompressed));
+        REQUIRE(fromCompressed.liveEntry() == le);
+    }
+
+    // Merging compressed into plain buckets, and back, changes nothing.
+    auto& bm = appPlain->getBucketManager();
+    auto mixed = Bucket::merge(bm, plain, Bucket::fresh(bm, {}, dead));
+    CHECK(mixed->getHash() ==
+          Bucket::merge(bm, compressed, Bucket::fresh(bm, {}, dead))
+              ->getHash());
+}
+#endif
+
+TEST_CASE("bucket merge scheduler", "[bucket][bucketmerge]")
+{
+    medida::MetricsRegistry metrics;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool blockerStarted = false;
+    bool release = false;
+    auto blocker = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        blockerStarted = true;
+        cv.notify_all();
+        cv.wait(lock, [&] { return release; });
+    };
+    auto waitForBlocker = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return blockerStarted; });
+    };
+    auto releaseBlocker = [&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        release = true;
+        cv.notify_all();
+    };
+
+    SECTION("shallow levels first, FIFO within a level")
+    {
+        BucketMergeScheduler sched(metrics, 1, BucketList::kNumLevels);
+        std::vector<std::pair<uint32_t, int>> order;
+        auto record = [&](uint32_t level, int tag) {
+            return [&order, level, tag]() {
+                order.push_back(std::make_pair(level, tag));
+            };
+        };
+        sched.enqueue(0, blocker);
+        waitForBlocker();
+        sched.enqueue(7, record(7, 0));
+        sched.enqueue(2, record(2, 1));
+        sched.enqueue(5, record(5, 2));
+        sched.enqueue(2, record(2, 3));
+        CHECK(metrics.NewCounter({"bucket", "merge", "queue-depth"}).count() ==
+              4);
+        releaseBlocker();
+        sched.waitForIdle();
+
+        std::vector<std::pair<uint32_t, int>> expected{
+            {2, 1}, {2, 3}, {5, 2}, {7, 0}};
+        CHECK(order == expected);
+        CHECK(metrics.NewCounter({"bucket", "merge", "queue-depth"}).count() ==
+              0);
+        CHECK(metrics.NewTimer({"bucket", "merge-time", "level-2"}).count() ==
+              2);
+    }
+
+    SECTION("deep levels never take the last thread")
+    {
+        BucketMergeScheduler sched(metrics, 2, BucketList::kNumLevels);
+        uint32_t deep = BucketMergeScheduler::kFirstDeepLevel;
+        std::atomic<bool> deepRan{false};
+        std::promise<void> shallowRan;
+        sched.enqueue(deep, blocker);
+        waitForBlocker();
+        sched.enqueue(deep + 1, [&]() { deepRan = true; });
+        sched.enqueue(1, [&]() { shallowRan.set_value(); });
+        shallowRan.get_future().wait();
+
+        // The second deep merge is held back while the first one runs, even
+        // though a thread is free.
+        CHECK(!deepRan);
+        releaseBlocker();
+        sched.waitForIdle();
+        CHECK(deepRan);
+    }
+
+    SECTION("shutdown drops queued merges")
+    {
+        BucketMergeScheduler sched(metrics, 1, BucketList::kNumLevels);
+        using task_t = std::packaged_task<int()>;
+        auto task = std::make_shared<task_t>([]() { return 1; });
+        auto fut = task->get_future();
+        sched.enqueue(0, blocker);
+        waitForBlocker();
+        sched.enqueue(3, std::bind(&task_t::operator(), task));
+        task.reset();
+        std::thread releaser([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            releaseBlocker();
+        });
+        sched.shutdown();
+        releaser.join();
+        REQUIRE_THROWS_AS(fut.get(), std::future_error);
+    }
+}
+
+TEST_CASE("bucket manager never merges on a single thread",
+          "[bucket][bucketmerge]")
+{
+    VirtualClock clock;
+    Config cfg(getTestConfig());
+    cfg.BUCKET_MERGE_THREADS = 1;
+    Application::pointer app = Application::create(clock, cfg);
+    CHECK(app->getBucketManager().getMergeScheduler().getThreadCount() == 2);
+}
+
+TEST_CASE("bucket key sets", "[bucket][bucketkeyset]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer app = Application::create(clock, cfg);
+    autocheck::generator<LedgerKey> keyGen;
+
+    std::vector<LedgerEntry> live(
+        LedgerTestUtils::generateValidLedgerEntries(500));
+    std::vector<LedgerKey> dead;
+    for (size_t i = 0; i < 50; ++i)
+    {
+        dead.push_back(keyGen(5));
+    }
+    std::set<LedgerKey, LedgerEntryIdCmp> present;
+    for (auto const& e : live)
+    {
+        present.insert(LedgerEntryKey(e));
+    }
+    present.insert(dead.begin(), dead.end());
+
+    auto b = Bucket::fresh(app->getBucketManager(), live, dead);
+    auto keys = b->getKeySet();
+    REQUIRE(keys);
+    CHECK(keys == b->getKeySet());
+    CHECK(keys->size() == present.size());
+
+    auto contains = [&](LedgerKey const& k) {
+        auto bytes = xdr::xdr_to_opaque(k);
+        return keys->contains(BucketKeySet::hashKey(bytes.data(), bytes.size()),
+                              bytes.data(), bytes.size());
+    };
+    for (auto const& k : present)
+    {
+        CHECK(contains(k));
+    }
+    for (size_t i = 0; i < 500; ++i)
+    {
+        auto k = keyGen(5);
+        CHECK(contains(k) == (present.find(k) != present.end()));
+    }
+
+    CHECK(!std::make_shared<Bucket>()->getKeySet());
 }
 
 static void
@@ -545,6 +1103,10 @@ clearFutures(Application::pointer app, BucketList& bl)
         bl.getLevel(i).getNext().clear();
     }
 
+    // Then wait for the merge threads to finish any merge they are running,
+    // and drop the buckets it holds.
+    app->getBucketManager().getMergeScheduler().waitForIdle();
+
     // Then go through all the _worker threads_ and mop up any work they
     // might still be doing (that might be "dropping a shared_ptr<Bucket>").
 
@@ -574,6 +1136,70 @@ clearFutures(Application::pointer app, BucketList& bl)
     }
 }
 
+TEST_CASE("bucket manager prepares batches in the background", "[bucket]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer app = Application::create(clock, cfg);
+    auto& bm = app->getBucketManager();
+
+    BucketList bl;
+    autocheck::generator<std::vector<LedgerKey>> deadGen;
+    for (uint32_t i = 1; i < 40; ++i)
+    {
+        auto live = LedgerTestUtils::generateValidLedgerEntries(8);
+        auto dead = deadGen(5);
+        auto batch = bm.prepareBatch(live, dead);
+        bl.addBatch(*app, i, live, dead);
+        bm.addBatch(*app, i, batch);
+        REQUIRE(bm.getBucketList().getHash() == bl.getHash());
+    }
+    clearFutures(app, bl);
+    clearFutures(app, bm.getBucketList());
+}
+
+TEST_CASE("bucket manager prepares batches while all merge threads are busy",
+          "[bucket]")
+{
+    VirtualClock clock;
+    Config const& cfg = getTestConfig();
+    Application::pointer app = Application::create(clock, cfg);
+    auto& bm = app->getBucketManager();
+    auto& sched = bm.getMergeScheduler();
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t started = 0;
+    bool release = false;
+    for (size_t i = 0; i < sched.getThreadCount(); ++i)
+    {
+        sched.enqueue(1, [&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            ++started;
+            cv.notify_all();
+            cv.wait(lock, [&] { return release; });
+        });
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return started == sched.getThreadCount(); });
+    }
+
+    auto live = LedgerTestUtils::generateValidLedgerEntries(8);
+    auto batch = bm.prepareBatch(live, {});
+    CHECK(batch.wait_for(std::chrono::seconds(10)) ==
+          std::future_status::ready);
+    CHECK(batch.get()->getHash() ==
+          Bucket::fresh(bm, live, {})->getHash());
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        release = true;
+        cv.notify_all();
+    }
+    sched.waitForIdle();
+}
+
 TEST_CASE("bucketmanager ownership", "[bucket]")
 {
     VirtualClock clock;
@@ -874,6 +1500,75 @@ TEST_CASE("checkdb succeeding", "[bucket][checkdb]")
     }
 }
 
+TEST_CASE("checkdb on a pooled connection", "[bucket][checkdb]")
+{
+    VirtualClock clock;
+    Config cfg(getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE));
+    cfg.ARTIFICIALLY_GENERATE_LOAD_FOR_TESTING = true;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    auto& db = app->getDatabase();
+    REQUIRE(db.canUsePool());
+
+    app->generateLoad(100, 100, 100, false);
+    auto& m = app->getMetrics();
+    while (m.NewMeter({"loadgen", "run", "complete"}, "run").count() == 0)
+    {
+        clock.crank(false);
+    }
+
+    auto& finished = m.NewMeter({"bucket", "checkdb", "finished"}, "check");
+    auto crankUntilFinished = [&]() {
+        while (finished.count() == 0)
+        {
+            clock.crank(false);
+        }
+    };
+
+    SECTION("clean check")
+    {
+        app->checkDB();
+        crankUntilFinished();
+        REQUIRE(m.NewTimer({"bucket", "checkdb", "execute"}).count() == 1);
+        REQUIRE(
+            m.NewMeter({"bucket", "checkdb", "object-compare"}, "comparison")
+                .count() >= 10);
+    }
+
+    SECTION("mismatch is rethrown on the main thread")
+    {
+        // Corrupted before the check is started from the main thread, so
+        // that the read transaction it pins sees it.
+        db.getSession()
+            << ("UPDATE accounts SET balance = balance * 2"
+                " WHERE accountid = (SELECT accountid FROM accounts LIMIT 1);");
+        app->checkDB();
+        REQUIRE_THROWS_AS(crankUntilFinished(), std::runtime_error);
+        REQUIRE(finished.count() == 1);
+    }
+
+    // Either way the read transaction is over: every pooled connection can
+    // start a transaction of its own, and sees writes made since.
+    auto& pool = db.getPool();
+    for (size_t i = 0; i < std::thread::hardware_concurrency(); ++i)
+    {
+        soci::session& sess = pool.at(i);
+        soci::transaction tx(sess);
+        tx.rollback();
+    }
+    db.getSession() << "UPDATE accounts SET balance = 42"
+                       " WHERE accountid = (SELECT accountid FROM accounts"
+                       " LIMIT 1)";
+    int n = 0;
+    {
+        soci::session sess(pool);
+        sess << "SELECT COUNT(*) FROM accounts WHERE balance = 42",
+            soci::into(n);
+    }
+    REQUIRE(n == 1);
+}
+
 TEST_CASE("bucket apply", "[bucket]")
 {
     VirtualClock clock;
@@ -915,37 +1610,133 @@ TEST_CASE("bucket apply", "[bucket]")
     REQUIRE(count == 1);
 }
 
+TEST_CASE("bucket apply of every entry type", "[bucket]")
+{
+    VirtualClock clock;
+    Config cfg(getTestConfig());
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    auto& db = app->getDatabase();
+    auto live = LedgerTestUtils::generateValidLedgerEntries(500);
+    std::vector<LedgerKey> dead, noDead;
+    for (auto const& e : live)
+    {
+        dead.emplace_back(LedgerEntryKey(e));
+    }
+
+    auto checkLoaded = [&]() {
+        for (auto const& e : live)
+        {
+            auto fromDb = EntryFrame::storeLoad(LedgerEntryKey(e), db);
+            REQUIRE(fromDb);
+            REQUIRE(fromDb->mEntry == e);
+        }
+    };
+
+    // The trustline, offer and data tables start out empty, so their entries
+    // are inserted without deleting first; the accounts table holds the root
+    // account, so accounts are deleted and reinserted.
+    Bucket::fresh(app->getBucketManager(), live, noDead)->apply(db);
+    checkLoaded();
+
+    // Applying new states of the same entries replaces them.
+    for (auto& e : live)
+    {
+        ++e.lastModifiedLedgerSeq;
+    }
+    Bucket::fresh(app->getBucketManager(), live, noDead)->apply(db);
+    checkLoaded();
+
+    Bucket::fresh(app->getBucketManager(), {}, dead)->apply(db);
+    for (auto const& k : dead)
+    {
+        REQUIRE(!EntryFrame::exists(db, k));
+    }
+}
+
 #ifdef USE_POSTGRES
-TEST_CASE("bucket apply bench", "[bucketbench][hide]")
+TEST_CASE("bucket apply in parallel", "[bucket]")
 {
     VirtualClock clock;
     Config cfg(getTestConfig(0, Config::TESTDB_POSTGRESQL));
     Application::pointer app = Application::create(clock, cfg);
     app->start();
 
-    std::vector<LedgerEntry> live(100000);
+    auto& db = app->getDatabase();
+    auto older = LedgerTestUtils::generateValidLedgerEntries(500);
+    auto newer = older;
     std::vector<LedgerKey> noDead;
+    for (auto& e : newer)
+    {
+        ++e.lastModifiedLedgerSeq;
+    }
 
-    for (auto& l : live)
+    // Both buckets hold every entry, so the newer one has to be applied
+    // after the older one within each entry type.
+    BucketApplicator::applyInParallel(
+        db.getPool(),
+        {Bucket::fresh(app->getBucketManager(), older, noDead),
+         Bucket::fresh(app->getBucketManager(), newer, noDead)},
+        db.hasInlineAccountSigners());
+    db.getEntryCache().clear();
+    for (auto const& e : newer)
     {
-        l.data.type(ACCOUNT);
-        auto& a = l.data.account();
-        a = LedgerTestUtils::generateValidAccountEntry(5);
+        auto fromDb = EntryFrame::storeLoad(LedgerEntryKey(e), db);
+        REQUIRE(fromDb);
+        REQUIRE(fromDb->mEntry == e);
     }
+}
+#endif
+
+static void
+benchBucketApply(Config const& cfg)
+{
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    size_t const n = 100000;
+    auto live = LedgerTestUtils::generateValidLedgerEntries(n);
+    std::vector<LedgerKey> noDead;
 
     std::shared_ptr<Bucket> birth =
         Bucket::fresh(app->getBucketManager(), live, noDead);
 
     auto& db = app->getDatabase();
-    auto& sess = db.getSession();
+    auto report = [&](std::string const& what,
+                      std::chrono::steady_clock::duration d) {
+        double secs = std::chrono::duration<double>(d).count();
+        CLOG(INFO, "Bucket") << what << ": " << n << " entries in " << secs
+                             << "s, " << static_cast<uint64_t>(n / secs)
+                             << " entries/sec";
+    };
 
-    CLOG(INFO, "Bucket") << "Applying bucket with " << live.size()
-                         << " live entries";
+    // Into empty tables (apart from the root account), then over the same
+    // entries again.
+    {
+        auto start = std::chrono::steady_clock::now();
+        birth->apply(db);
+        report("apply into empty db", std::chrono::steady_clock::now() - start);
+    }
     {
-        TIMED_SCOPE(timerObj, "apply");
-        soci::transaction sqltx(sess);
+        auto start = std::chrono::steady_clock::now();
         birth->apply(db);
-        sqltx.commit();
+        report("apply over existing entries",
+               std::chrono::steady_clock::now() - start);
     }
 }
+
+TEST_CASE("bucket apply bench", "[bucketbench][hide]")
+{
+    SECTION("sqlite")
+    {
+        benchBucketApply(getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE));
+    }
+#ifdef USE_POSTGRES
+    SECTION("postgres")
+    {
+        benchBucketApply(getTestConfig(0, Config::TESTDB_POSTGRESQL));
+    }
 #endif
+}
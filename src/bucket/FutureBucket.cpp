@@ -8,7 +8,9 @@
 #include "util/asio.h"
 
 #include "bucket/Bucket.h"
+#include "bucket/BucketList.h"
 #include "bucket/BucketManager.h"
+#include "bucket/BucketMergeScheduler.h"
 #include "bucket/FutureBucket.h"
 #include "crypto/Hex.h"
 #include "main/Application.h"
@@ -23,12 +25,13 @@ FutureBucket::FutureBucket(Application& app,
                            std::shared_ptr<Bucket> const& curr,
                            std::shared_ptr<Bucket> const& snap,
                            std::vector<std::shared_ptr<Bucket>> const& shadows,
-                           bool keepDeadEntries)
+                           uint32_t level)
     : mState(FB_LIVE_INPUTS)
     , mInputCurrBucket(curr)
     , mInputSnapBucket(snap)
     , mInputShadowBuckets(shadows)
-    , mKeepDeadEntries(keepDeadEntries)
+    , mLevel(level)
+    , mKeepDeadEntries(BucketList::keepDeadEntries(level))
 {
     // Constructed with a bunch of inputs, _immediately_ commence merging
     // them; there's no valid state for have-inputs-but-not-merging, the
@@ -299,16 +302,18 @@ FutureBucket::startMerge(Application& app)
         });
 
     mOutputBucket = task->get_future().share();
-    app.getWorkerIOService().post(bind(&task_t::operator(), task));
+    bm.getMergeScheduler().enqueue(mLevel, bind(&task_t::operator(), task));
     checkState();
 }
 
 void
-FutureBucket::makeLive(Application& app)
+FutureBucket::makeLive(Application& app, uint32_t level)
 {
     checkState();
     assert(!isLive());
     assert(hasHashes());
+    mLevel = level;
+    mKeepDeadEntries = BucketList::keepDeadEntries(level);
     auto& bm = app.getBucketManager();
     if (hasOutputHash())
     {
@@ -70,7 +70,12 @@ class FutureBucket
     std::string mInputSnapBucketHash;
     std::vector<std::string> mInputShadowBucketHashes;
     std::string mOutputBucketHash;
-    bool mKeepDeadEntries;
+
+    // The BucketList level this merge belongs to, which determines whether
+    // dead entries are kept and how urgently the merge is scheduled. Not
+    // serialized; supplied again by makeLive.
+    uint32_t mLevel{0};
+    bool mKeepDeadEntries{true};
 
     void checkHashesMatch() const;
     void checkState() const;
@@ -84,7 +89,7 @@ class FutureBucket
     FutureBucket(Application& app, std::shared_ptr<Bucket> const& curr,
                  std::shared_ptr<Bucket> const& snap,
                  std::vector<std::shared_ptr<Bucket>> const& shadows,
-                 bool keepDeadEntries);
+                 uint32_t level);
 
     FutureBucket(std::shared_ptr<Bucket> output);
 
@@ -117,8 +122,9 @@ class FutureBucket
     // Precondition: isLive(); waits-for and resolves to merged bucket.
     std::shared_ptr<Bucket> resolve();
 
-    // Precondition: !isLive(); transitions from FB_HASH_FOO to FB_LIVE_FOO
-    void makeLive(Application& app);
+    // Precondition: !isLive(); transitions from FB_HASH_FOO to FB_LIVE_FOO,
+    // restarting the merge (if any) as one on BucketList level `level`.
+    void makeLive(Application& app, uint32_t level);
 
     // Return all hashes referenced by this future.
     std::vector<std::string> getHashes() const;
@@ -8,11 +8,14 @@
 #include "crypto/SHA.h"
 #include "crypto/SecretKey.h"
 #include "crypto/StrKey.h"
+#include "crypto/VerifySigCache.h"
 #include "lib/catch.hpp"
 #include "test/test.h"
 #include "util/Logging.h"
 #include "util/basen.h"
+#include <algorithm>
 #include <autocheck/autocheck.hpp>
+#include <chrono>
 #include <map>
 #include <regex>
 #include <sodium.h>
@@ -152,6 +155,68 @@ TEST_CASE("sign tests", "[crypto]")
     CHECK(!PubKeyUtils::verifySig(pk, sig, msg));
 }
 
+TEST_CASE("verify-sig cache", "[crypto][verifysigcache]")
+{
+    auto sk = SecretKey::random();
+    auto pk = sk.getPublicKey();
+    std::string msg = "hello";
+    auto sig = sk.sign(msg);
+
+    VerifySigCache cache(64);
+    auto key = cache.computeKey(pk, sig, msg);
+    REQUIRE(key == cache.computeKey(pk, sig, msg));
+    REQUIRE(!(key == cache.computeKey(pk, sig, std::string("helloo"))));
+
+    bool valid = false;
+    REQUIRE(!cache.get(key, valid));
+    cache.put(key, true);
+    REQUIRE(cache.get(key, valid));
+    REQUIRE(valid);
+    REQUIRE(cache.getHits() == 1);
+    REQUIRE(cache.getMisses() == 1);
+
+    SECTION("capacity is bounded and read entries survive")
+    {
+        for (int i = 0; i < 1000; ++i)
+        {
+            cache.put(cache.computeKey(pk, sig, std::to_string(i)), false);
+            REQUIRE(cache.get(key, valid));
+        }
+        REQUIRE(cache.size() <= cache.getMaxEntries());
+    }
+
+    SECTION("resizing empties the cache")
+    {
+        cache.resize(128);
+        REQUIRE(!cache.get(key, valid));
+        REQUIRE(cache.size() == 0);
+    }
+
+    SECTION("a cache of size 0 holds nothing")
+    {
+        cache.resize(0);
+        cache.put(key, true);
+        REQUIRE(!cache.get(key, valid));
+    }
+
+    SECTION("verifySig caches outcomes")
+    {
+        uint64_t hits0, misses0, hits1, misses1;
+        PubKeyUtils::clearVerifySigCache();
+        PubKeyUtils::getVerifySigCacheCounts(hits0, misses0);
+        auto bad = sig;
+        bad[4] ^= 1;
+        for (int i = 0; i < 3; ++i)
+        {
+            REQUIRE(PubKeyUtils::verifySig(pk, sig, msg));
+            REQUIRE(!PubKeyUtils::verifySig(pk, bad, msg));
+        }
+        PubKeyUtils::getVerifySigCacheCounts(hits1, misses1);
+        REQUIRE(hits1 - hits0 == 4);
+        REQUIRE(misses1 - misses0 == 2);
+    }
+}
+
 struct SignVerifyTestcase
 {
     SecretKey key;
@@ -206,6 +271,95 @@ TEST_CASE("sign and verify benchmarking", "[crypto-bench][bench][hide]")
     }
 }
 
+TEST_CASE("batch signature verification", "[crypto]")
+{
+    PubKeyUtils::clearVerifySigCache();
+    std::vector<SignVerifyTestcase> cases;
+    for (size_t i = 0; i < 10; ++i)
+    {
+        cases.push_back(SignVerifyTestcase::create());
+        cases.back().sign();
+    }
+    std::vector<PubKeyUtils::VerifySigRequest> requests;
+    std::vector<bool> expected;
+    for (size_t i = 0; i < cases.size(); ++i)
+    {
+        auto const& c = cases[i];
+        bool good = i % 3 != 0;
+        auto sig = c.sig;
+        if (!good)
+        {
+            sig[4] ^= 1;
+        }
+        requests.emplace_back(
+            PubKeyUtils::VerifySigRequest{c.pub, sig, c.msg});
+        expected.push_back(good);
+        // the wrong key never verifies
+        requests.emplace_back(PubKeyUtils::VerifySigRequest{
+            cases[(i + 1) % cases.size()].pub, c.sig, c.msg});
+        expected.push_back(false);
+    }
+    // repeats within the batch
+    for (size_t i = 0; i < 4; ++i)
+    {
+        requests.push_back(requests[i]);
+        expected.push_back(expected[i]);
+    }
+
+    REQUIRE(PubKeyUtils::verifySigs(requests) == expected);
+    // and again, from the cache
+    REQUIRE(PubKeyUtils::verifySigs(requests) == expected);
+    REQUIRE(PubKeyUtils::verifySigs({}).empty());
+}
+
+TEST_CASE("batch verify benchmarking", "[crypto-bench][bench][hide]")
+{
+    size_t n = 10000, batchSize = 1000;
+    std::vector<SignVerifyTestcase> cases;
+    for (size_t i = 0; i < n; ++i)
+    {
+        cases.push_back(SignVerifyTestcase::create());
+        cases.back().sign();
+    }
+
+    LOG(INFO) << "Benchmarking " << n << " verifications, single and in "
+              << "batches of " << batchSize;
+    PubKeyUtils::clearVerifySigCache();
+    auto start = std::chrono::steady_clock::now();
+    {
+        TIMED_SCOPE(timerBlkObj, "single");
+        for (auto& c : cases)
+        {
+            c.verify();
+        }
+    }
+    std::chrono::duration<double> single =
+        std::chrono::steady_clock::now() - start;
+
+    PubKeyUtils::clearVerifySigCache();
+    start = std::chrono::steady_clock::now();
+    {
+        TIMED_SCOPE(timerBlkObj, "batch");
+        for (size_t i = 0; i < n; i += batchSize)
+        {
+            std::vector<PubKeyUtils::VerifySigRequest> requests;
+            for (size_t j = i; j < std::min(n, i + batchSize); ++j)
+            {
+                requests.emplace_back(PubKeyUtils::VerifySigRequest{
+                    cases[j].pub, cases[j].sig, cases[j].msg});
+            }
+            auto results = PubKeyUtils::verifySigs(requests);
+            CHECK(std::find(results.begin(), results.end(), false) ==
+                  results.end());
+        }
+    }
+    std::chrono::duration<double> batch =
+        std::chrono::steady_clock::now() - start;
+
+    LOG(INFO) << "single: " << n / single.count() << " verifications/s";
+    LOG(INFO) << "batch: " << n / batch.count() << " verifications/s";
+}
+
 TEST_CASE("StrKey tests", "[crypto]")
 {
     std::regex b32("^([A-Z2-7])+$");
@@ -5,17 +5,16 @@
 #include "crypto/SecretKey.h"
 #include "crypto/Hex.h"
 #include "crypto/KeyUtils.h"
-#include "crypto/SHA.h"
 #include "crypto/StrKey.h"
+#include "crypto/VerifySigCache.h"
 #include "main/Config.h"
 #include "transactions/SignatureUtils.h"
 #include "util/HashOfHash.h"
-#include "util/lrucache.hpp"
 #include "util/make_unique.h"
 #include <memory>
-#include <mutex>
 #include <sodium.h>
 #include <type_traits>
+#include <unordered_map>
 
 namespace stellar
 {
@@ -27,31 +26,11 @@ namespace stellar
 // makes all signature-verification in the program faster and
 // has no effect on correctness.
 
-static std::mutex gVerifySigCacheMutex;
-static cache::lru_cache<Hash, bool> gVerifySigCache(0xffff);
-static std::unique_ptr<SHA256> gHasher = SHA256::create();
-static uint64_t gVerifyCacheHit = 0;
-static uint64_t gVerifyCacheMiss = 0;
-static uint64_t gVerifyCacheIgnore = 0;
-
-static bool
-shouldCacheVerifySig(PublicKey const& key, Signature const& signature,
-                     ByteSlice const& bin)
+static VerifySigCache&
+getVerifySigCache()
 {
-    return true;
-}
-
-static Hash
-verifySigCacheKey(PublicKey const& key, Signature const& signature,
-                  ByteSlice const& bin)
-{
-    assert(key.type() == PUBLIC_KEY_TYPE_ED25519);
-
-    gHasher->reset();
-    gHasher->add(key.ed25519());
-    gHasher->add(signature);
-    gHasher->add(bin);
-    return gHasher->finish();
+    static VerifySigCache cache(65536);
+    return cache;
 }
 
 SecretKey::SecretKey() : mKeyType(PUBLIC_KEY_TYPE_ED25519)
@@ -206,21 +185,21 @@ SecretKey::fromStrKeySeed(std::string const& strKeySeed)
 void
 PubKeyUtils::clearVerifySigCache()
 {
-    std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
-    gVerifySigCache.clear();
+    getVerifySigCache().clear();
+}
+
+void
+PubKeyUtils::resizeVerifySigCache(size_t maxEntries)
+{
+    getVerifySigCache().resize(maxEntries);
 }
 
 void
-PubKeyUtils::flushVerifySigCacheCounts(uint64_t& hits, uint64_t& misses,
-                                       uint64_t& ignores)
+PubKeyUtils::getVerifySigCacheCounts(uint64_t& hits, uint64_t& misses)
 {
-    std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
-    hits = gVerifyCacheHit;
-    misses = gVerifyCacheMiss;
-    ignores = gVerifyCacheIgnore;
-    gVerifyCacheHit = 0;
-    gVerifyCacheMiss = 0;
-    gVerifyCacheIgnore = 0;
+    auto& cache = getVerifySigCache();
+    hits = cache.getHits();
+    misses = cache.getMisses();
 }
 
 std::string
@@ -296,34 +275,62 @@ PubKeyUtils::verifySig(PublicKey const& key, Signature const& signature,
 {
     assert(key.type() == PUBLIC_KEY_TYPE_ED25519);
 
-    bool shouldCache = shouldCacheVerifySig(key, signature, bin);
-    Hash cacheKey;
+    auto& cache = getVerifySigCache();
+    Hash cacheKey = cache.computeKey(key, signature, bin);
+    bool ok;
+    if (cache.get(cacheKey, ok))
+    {
+        return ok;
+    }
+
+    ok = (crypto_sign_verify_detached(signature.data(), bin.data(), bin.size(),
+                                      key.ed25519().data()) == 0);
+    cache.put(cacheKey, ok);
+    return ok;
+}
 
-    if (shouldCache)
+std::vector<bool>
+PubKeyUtils::verifySigs(std::vector<VerifySigRequest> const& requests)
+{
+    // libsodium has no batch verification, so the batch is checked one
+    // signature at a time; each result is exact, and there is no combined
+    // check that could fail without saying which signature is bad.
+    auto& cache = getVerifySigCache();
+    std::vector<bool> results(requests.size());
+    std::unordered_map<Hash, size_t> pending;
+    std::vector<std::pair<size_t, size_t>> repeats;
+    for (size_t i = 0; i < requests.size(); ++i)
     {
-        cacheKey = verifySigCacheKey(key, signature, bin);
-        std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
-        if (gVerifySigCache.exists(cacheKey))
+        auto const& r = requests[i];
+        assert(r.mKey.type() == PUBLIC_KEY_TYPE_ED25519);
+        Hash cacheKey = cache.computeKey(r.mKey, r.mSignature, r.mBin);
+        bool ok;
+        if (cache.get(cacheKey, ok))
         {
-            ++gVerifyCacheHit;
-            return gVerifySigCache.get(cacheKey);
+            results[i] = ok;
+            continue;
+        }
+        auto res = pending.emplace(cacheKey, i);
+        if (!res.second)
+        {
+            repeats.emplace_back(i, res.first->second);
         }
-        ++gVerifyCacheMiss;
     }
-    else
+
+    for (auto const& p : pending)
     {
-        ++gVerifyCacheIgnore;
+        auto const& r = requests[p.second];
+        bool ok = (crypto_sign_verify_detached(
+                       r.mSignature.data(), r.mBin.data(), r.mBin.size(),
+                       r.mKey.ed25519().data()) == 0);
+        cache.put(p.first, ok);
+        results[p.second] = ok;
     }
-
-    bool ok =
-        (crypto_sign_verify_detached(signature.data(), bin.data(), bin.size(),
-                                     key.ed25519().data()) == 0);
-    if (shouldCache)
+    for (auto const& r : repeats)
     {
-        std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
-        gVerifySigCache.put(cacheKey, ok);
+        results[r.first] = results[r.second];
     }
-    return ok;
+    return results;
 }
 
 PublicKey
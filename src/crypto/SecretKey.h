@@ -4,19 +4,20 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "crypto/ByteSlice.h"
 #include "crypto/KeyUtils.h"
 #include "xdr/Stellar-types.h"
 
 #include <array>
 #include <functional>
 #include <ostream>
+#include <vector>
 
 namespace stellar
 {
 
 using xdr::operator==;
 
-class ByteSlice;
 struct SignerKey;
 
 class SecretKey
@@ -100,9 +101,24 @@ namespace PubKeyUtils
 bool verifySig(PublicKey const& key, Signature const& signature,
                ByteSlice const& bin);
 
+// A signature to check with verifySigs; `mBin` must outlive the call.
+struct VerifySigRequest
+{
+    PublicKey mKey;
+    Signature mSignature;
+    ByteSlice mBin;
+};
+
+// Return, in order, whether each of `requests` is valid, as verifySig
+// would. The cache is consulted for the whole batch first, and requests
+// repeated within it are only verified once.
+std::vector<bool> verifySigs(std::vector<VerifySigRequest> const& requests);
+
 void clearVerifySigCache();
-void flushVerifySigCacheCounts(uint64_t& hits, uint64_t& misses,
-                               uint64_t& ignores);
+// The cache is shared by the whole process: the last call wins.
+void resizeVerifySigCache(size_t maxEntries);
+// Hits and misses since the process started.
+void getVerifySigCacheCounts(uint64_t& hits, uint64_t& misses);
 
 PublicKey random();
 }
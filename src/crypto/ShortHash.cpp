@@ -0,0 +1,44 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/ShortHash.h"
+#include <sodium.h>
+#include <stdexcept>
+
+namespace stellar
+{
+namespace shortHash
+{
+
+ShortHashKey
+randomKey()
+{
+    static_assert(sizeof(ShortHashKey) == crypto_shorthash_KEYBYTES,
+                  "unexpected crypto_shorthash_KEYBYTES");
+    ShortHashKey key;
+    randombytes_buf(key.data(), key.size());
+    return key;
+}
+
+uint64_t
+computeHash(ShortHashKey const& key, ByteSlice const& bin)
+{
+    static_assert(sizeof(uint64_t) == crypto_shorthash_BYTES,
+                  "unexpected crypto_shorthash_BYTES");
+    unsigned char out[crypto_shorthash_BYTES];
+    if (crypto_shorthash(out, bin.data(), bin.size(), key.data()) != 0)
+    {
+        throw std::runtime_error("error from crypto_shorthash");
+    }
+    // SipHash output is little-endian by definition; decode it explicitly so
+    // that persisted values agree across hosts.
+    uint64_t res = 0;
+    for (size_t i = crypto_shorthash_BYTES; i > 0; --i)
+    {
+        res = (res << 8) | out[i - 1];
+    }
+    return res;
+}
+}
+}
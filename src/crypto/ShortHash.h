@@ -0,0 +1,28 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/ByteSlice.h"
+#include <array>
+#include <cstdint>
+
+namespace stellar
+{
+
+// Key for the keyed short hash below.
+typedef std::array<uint8_t, 16> ShortHashKey;
+
+namespace shortHash
+{
+// Return a fresh key drawn from the system CSPRNG.
+ShortHashKey randomKey();
+
+// Keyed 64-bit SipHash-2-4 of `bin`. This is cheap and resists deliberate
+// collisions by anyone who does not know `key`, which makes it suitable for
+// hash tables and filters over attacker-influenced data. It is _not_ a
+// substitute for sha256 anywhere a digest is committed to.
+uint64_t computeHash(ShortHashKey const& key, ByteSlice const& bin);
+}
+}
@@ -0,0 +1,162 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/VerifySigCache.h"
+#include "crypto/ByteSlice.h"
+#include "util/make_unique.h"
+#include <algorithm>
+#include <sodium.h>
+#include <stdexcept>
+
+namespace stellar
+{
+
+size_t const VerifySigCache::NUM_SHARDS;
+
+VerifySigCache::VerifySigCache(size_t maxEntries)
+    : mMaxEntries(0), mMaxShardEntries(0), mHits(0), mMisses(0)
+{
+    static_assert(sizeof(mHashKey) == crypto_generichash_KEYBYTES,
+                  "unexpected crypto_generichash_KEYBYTES");
+    randombytes_buf(mHashKey.data(), mHashKey.size());
+    for (size_t i = 0; i < NUM_SHARDS; ++i)
+    {
+        mShards.emplace_back(make_unique<Shard>());
+    }
+    resize(maxEntries);
+}
+
+Hash
+VerifySigCache::computeKey(PublicKey const& key, Signature const& signature,
+                           ByteSlice const& bin) const
+{
+    static_assert(sizeof(Hash) <= crypto_generichash_BYTES_MAX,
+                  "unexpected crypto_generichash_BYTES_MAX");
+    crypto_generichash_state state;
+    ByteSlice k(key.ed25519());
+    ByteSlice s(signature);
+    Hash out;
+    if (crypto_generichash_init(&state, mHashKey.data(), mHashKey.size(),
+                                out.size()) != 0 ||
+        crypto_generichash_update(&state, k.data(), k.size()) != 0 ||
+        crypto_generichash_update(&state, s.data(), s.size()) != 0 ||
+        crypto_generichash_update(&state, bin.data(), bin.size()) != 0 ||
+        crypto_generichash_final(&state, out.data(), out.size()) != 0)
+    {
+        throw std::runtime_error("error from crypto_generichash");
+    }
+    return out;
+}
+
+VerifySigCache::Shard&
+VerifySigCache::getShard(Hash const& key)
+{
+    // The index buckets on the leading bytes of the key, so use the last one
+    // to pick the shard.
+    return *mShards[key[key.size() - 1] % NUM_SHARDS];
+}
+
+bool
+VerifySigCache::get(Hash const& key, bool& valid)
+{
+    auto& shard = getShard(key);
+    {
+        std::lock_guard<std::mutex> guard(shard.mMutex);
+        auto it = shard.mIndex.find(key);
+        if (it != shard.mIndex.end())
+        {
+            auto& slot = shard.mSlots[it->second];
+            slot.mReferenced = true;
+            valid = slot.mValid;
+            ++mHits;
+            return true;
+        }
+    }
+    ++mMisses;
+    return false;
+}
+
+void
+VerifySigCache::put(Hash const& key, bool valid)
+{
+    size_t maxShardEntries = mMaxShardEntries;
+    if (maxShardEntries == 0)
+    {
+        return;
+    }
+
+    auto& shard = getShard(key);
+    std::lock_guard<std::mutex> guard(shard.mMutex);
+    auto res = shard.mIndex.emplace(key, 0);
+    if (!res.second)
+    {
+        shard.mSlots[res.first->second].mValid = valid;
+        return;
+    }
+
+    if (shard.mSlots.size() < maxShardEntries)
+    {
+        res.first->second = shard.mSlots.size();
+        shard.mSlots.emplace_back(Slot{key, valid, false});
+        return;
+    }
+
+    // Every slot is either taken on the first lap or has its bit cleared,
+    // so this terminates within two laps.
+    for (;;)
+    {
+        if (shard.mHand >= shard.mSlots.size())
+        {
+            shard.mHand = 0;
+        }
+        auto& slot = shard.mSlots[shard.mHand++];
+        if (slot.mReferenced)
+        {
+            slot.mReferenced = false;
+            continue;
+        }
+        shard.mIndex.erase(slot.mKey);
+        res.first->second = shard.mHand - 1;
+        slot = Slot{key, valid, false};
+        return;
+    }
+}
+
+void
+VerifySigCache::clear()
+{
+    for (auto& s : mShards)
+    {
+        std::lock_guard<std::mutex> guard(s->mMutex);
+        s->mIndex.clear();
+        s->mSlots.clear();
+        s->mHand = 0;
+    }
+}
+
+void
+VerifySigCache::resize(size_t maxEntries)
+{
+    if (maxEntries == mMaxEntries)
+    {
+        return;
+    }
+    mMaxEntries = maxEntries;
+    mMaxShardEntries =
+        maxEntries == 0 ? 0 : std::max<size_t>(1, maxEntries / NUM_SHARDS);
+    clear();
+}
+
+size_t
+VerifySigCache::size() const
+{
+    size_t n = 0;
+    for (auto const& s : mShards)
+    {
+        std::lock_guard<std::mutex> guard(s->mMutex);
+        n += s->mIndex.size();
+    }
+    return n;
+}
+}
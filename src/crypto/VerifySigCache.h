@@ -0,0 +1,96 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/HashOfHash.h"
+#include "util/NonCopyable.h"
+#include "xdr/Stellar-types.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace stellar
+{
+
+class ByteSlice;
+
+/**
+ * Cache of the outcomes of Ed25519 signature verifications.
+ *
+ * Entries are keyed on a BLAKE2b digest of the public key, signature and
+ * message, keyed with a random per-process key so that nobody can aim for
+ * collisions. Computing the key takes no shared state, so any number of
+ * threads can do it at once.
+ *
+ * The cache is split into shards, each with its own lock and its own share
+ * of the capacity, evicting with the CLOCK algorithm like EntryCache.
+ * A capacity of 0 disables it.
+ */
+class VerifySigCache : NonMovableOrCopyable
+{
+  public:
+    explicit VerifySigCache(size_t maxEntries);
+
+    Hash computeKey(PublicKey const& key, Signature const& signature,
+                    ByteSlice const& bin) const;
+
+    // Sets `valid` and returns true if `key` is in the cache.
+    bool get(Hash const& key, bool& valid);
+    void put(Hash const& key, bool valid);
+    void clear();
+
+    // Changes the capacity, emptying the cache if it is not the same.
+    void resize(size_t maxEntries);
+
+    size_t size() const;
+    size_t
+    getMaxEntries() const
+    {
+        return mMaxEntries;
+    }
+
+    // Totals since the cache was created.
+    uint64_t
+    getHits() const
+    {
+        return mHits;
+    }
+    uint64_t
+    getMisses() const
+    {
+        return mMisses;
+    }
+
+  private:
+    static size_t const NUM_SHARDS = 16;
+
+    struct Slot
+    {
+        Hash mKey;
+        bool mValid;
+        bool mReferenced;
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mMutex;
+        std::unordered_map<Hash, size_t> mIndex;
+        std::vector<Slot> mSlots;
+        size_t mHand{0};
+    };
+
+    std::array<unsigned char, 32> mHashKey;
+    std::atomic<size_t> mMaxEntries;
+    std::atomic<size_t> mMaxShardEntries;
+    std::vector<std::unique_ptr<Shard>> mShards;
+    std::atomic<uint64_t> mHits;
+    std::atomic<uint64_t> mMisses;
+
+    Shard& getShard(Hash const& key);
+};
+}
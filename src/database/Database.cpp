@@ -19,7 +19,9 @@
 #include "ledger/AccountFrame.h"
 #include "ledger/DataFrame.h"
 #include "ledger/LedgerHeaderFrame.h"
+#include "ledger/LedgerStateBuffer.h"
 #include "ledger/OfferFrame.h"
+#include "ledger/OrderBook.h"
 #include "ledger/TrustFrame.h"
 #include "main/ExternalQueue.h"
 #include "main/PersistentState.h"
@@ -31,6 +33,7 @@
 #include "medida/metrics_registry.h"
 #include "medida/timer.h"
 
+#include <algorithm>
 #include <sstream>
 #include <stdexcept>
 #include <thread>
@@ -53,7 +56,7 @@ using namespace std;
 
 bool Database::gDriversRegistered = false;
 
-static unsigned long const SCHEMA_VERSION = 5;
+static unsigned long const SCHEMA_VERSION = 7;
 
 static void
 setSerializable(soci::session& sess)
@@ -81,7 +84,11 @@ Database::Database(Application& app)
           app.getMetrics().NewMeter({"database", "query", "exec"}, "query"))
     , mStatementsSize(
           app.getMetrics().NewCounter({"database", "memory", "statements"}))
-    , mEntryCache(4096)
+    , mEntryCache(app.getMetrics(), app.getConfig().ENTRY_CACHE_BYTES)
+    , mLedgerStateBuffer(make_unique<LedgerStateBuffer>())
+    , mOrderBook(make_unique<OrderBook>(app.getMetrics(),
+                                        app.getConfig().IN_MEMORY_ORDER_BOOK))
+    , mInlineAccountSigners(app.getConfig().INLINE_ACCOUNT_SIGNERS)
     , mExcludedQueryTime(0)
     , mExcludedTotalTime(0)
     , mLastIdleQueryTime(0)
@@ -106,6 +113,10 @@ Database::Database(Application& app)
     }
 }
 
+Database::~Database()
+{
+}
+
 void
 Database::applySchemaUpgrade(unsigned long vers)
 {
@@ -141,6 +152,21 @@ Database::applySchemaUpgrade(unsigned long vers)
         }
         break;
 
+    case 6:
+        // Serves OfferFrame::loadBestOffers: the offers of an asset pair in
+        // the order they are crossed in, which the price index alone did not.
+        mSession << "DROP INDEX IF EXISTS priceindex";
+        mSession << "CREATE INDEX bestofferindex ON offers "
+                    "(sellingassetcode, sellingissuer, buyingassetcode, "
+                    "buyingissuer, price, offerid)";
+        break;
+
+    case 7:
+        // Serialized signers of the account, see AccountFrame; NULL while
+        // they are kept in the signers table.
+        mSession << "ALTER TABLE accounts ADD signers TEXT";
+        break;
+
     default:
         throw std::runtime_error("Unknown DB schema version");
         break;
@@ -167,6 +193,22 @@ Database::upgradeToCurrentSchema()
         putSchemaVersion(vers);
     }
     assert(vers == SCHEMA_VERSION);
+
+    auto& ps = mApp.getPersistentState();
+    bool inlineSigners =
+        ps.getState(PersistentState::kInlineAccountSigners) == "true";
+    if (inlineSigners != mInlineAccountSigners)
+    {
+        CLOG(INFO, "Database") << "Moving account signers "
+                               << (mInlineAccountSigners
+                                       ? "into the accounts table"
+                                       : "into the signers table");
+        soci::transaction tx(mSession);
+        AccountFrame::migrateSigners(*this, mInlineAccountSigners);
+        ps.setState(PersistentState::kInlineAccountSigners,
+                    mInlineAccountSigners ? "true" : "false");
+        tx.commit();
+    }
 }
 
 void
@@ -341,12 +383,30 @@ Database::getPool()
     return *mPool;
 }
 
-cache::lru_cache<std::string, std::shared_ptr<LedgerEntry const>>&
+EntryCache&
 Database::getEntryCache()
 {
     return mEntryCache;
 }
 
+LedgerStateBuffer&
+Database::getLedgerStateBuffer()
+{
+    return *mLedgerStateBuffer;
+}
+
+OrderBook&
+Database::getOrderBook()
+{
+    return *mOrderBook;
+}
+
+bool
+Database::hasInlineAccountSigners() const
+{
+    return mInlineAccountSigners;
+}
+
 class SQLLogContext : NonCopyable
 {
     std::string mName;
@@ -404,6 +464,106 @@ Database::getPreparedStatement(std::string const& query)
     return sc;
 }
 
+StatementContext
+Database::prepareStatement(soci::session& sess, std::string const& query)
+{
+    auto p = std::make_shared<soci::statement>(sess);
+    p->alloc();
+    p->prepare(query);
+    StatementContext sc(p);
+    return sc;
+}
+
+std::string
+Database::inListPlaceholders(size_t n)
+{
+    assert(n != 0);
+    std::string res("(");
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (i != 0)
+        {
+            res += ",";
+        }
+        res += ":v" + std::to_string(i);
+    }
+    res += ")";
+    return res;
+}
+
+std::string
+Database::valuesPlaceholders(size_t nRows, size_t nCols)
+{
+    assert(nRows != 0 && nCols != 0);
+    std::string res;
+    size_t v = 0;
+    for (size_t i = 0; i < nRows; ++i)
+    {
+        res += (i == 0) ? "(" : ",(";
+        for (size_t j = 0; j < nCols; ++j)
+        {
+            if (j != 0)
+            {
+                res += ",";
+            }
+            res += ":v" + std::to_string(v++);
+        }
+        res += ")";
+    }
+    return res;
+}
+
+std::string
+Database::anyRowCondition(std::vector<std::string> const& columns,
+                          size_t nRows)
+{
+    assert(nRows != 0 && !columns.empty());
+    std::string res;
+    size_t v = 0;
+    for (size_t i = 0; i < nRows; ++i)
+    {
+        res += (i == 0) ? "(" : " OR (";
+        for (size_t j = 0; j < columns.size(); ++j)
+        {
+            if (j != 0)
+            {
+                res += " AND ";
+            }
+            res += columns[j] + "=:v" + std::to_string(v++);
+        }
+        res += ")";
+    }
+    return res;
+}
+
+void
+Database::executeBatched(
+    soci::session& sess, size_t nRows, size_t nCols,
+    std::function<std::string(size_t)> const& sqlForRows,
+    std::function<void(soci::statement&, size_t)> const& bindRow)
+{
+    // SQLite's default SQLITE_MAX_VARIABLE_NUMBER is 999; stay under it, on
+    // any database, so statements are the same everywhere.
+    size_t const maxParams = 999;
+    assert(nCols != 0 && nCols <= maxParams);
+    size_t const maxRows = maxParams / nCols;
+
+    size_t begin = 0;
+    while (begin < nRows)
+    {
+        size_t n = std::min(maxRows, nRows - begin);
+        auto prep = prepareStatement(sess, sqlForRows(n));
+        auto& st = prep.statement();
+        for (size_t i = begin; i < begin + n; ++i)
+        {
+            bindRow(st, i);
+        }
+        st.define_and_bind();
+        st.execute(true);
+        begin += n;
+    }
+}
+
 std::shared_ptr<SQLLogContext>
 Database::captureAndLogSQL(std::string contextName)
 {
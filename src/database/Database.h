@@ -4,14 +4,16 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "database/EntryCache.h"
 #include "medida/timer_context.h"
 #include "overlay/StellarXDR.h"
 #include "util/NonCopyable.h"
 #include "util/SociNoWarnings.h"
 #include "util/Timer.h"
-#include "util/lrucache.hpp"
+#include <functional>
 #include <set>
 #include <string>
+#include <vector>
 
 namespace medida
 {
@@ -23,6 +25,8 @@ class Counter;
 namespace stellar
 {
 class Application;
+class LedgerStateBuffer;
+class OrderBook;
 class SQLLogContext;
 
 /**
@@ -92,8 +96,10 @@ class Database : NonMovableOrCopyable
     std::map<std::string, std::shared_ptr<soci::statement>> mStatements;
     medida::Counter& mStatementsSize;
 
-    cache::lru_cache<std::string, std::shared_ptr<LedgerEntry const>>
-        mEntryCache;
+    EntryCache mEntryCache;
+    std::unique_ptr<LedgerStateBuffer> mLedgerStateBuffer;
+    std::unique_ptr<OrderBook> mOrderBook;
+    bool const mInlineAccountSigners;
 
     // Helpers for maintaining the total query time and calculating
     // idle percentage.
@@ -111,6 +117,7 @@ class Database : NonMovableOrCopyable
     // Instantiate object and connect to app.getConfig().DATABASE;
     // if there is a connection error, this will throw.
     Database(Application& app);
+    ~Database();
 
     // Return a crude meter of total queries to the db, for use in
     // overlay/LoadManager.
@@ -142,6 +149,34 @@ class Database : NonMovableOrCopyable
     // when the statement context is destroyed.
     StatementContext getPreparedStatement(std::string const& query);
 
+    // Return a helper object wrapping a one-off statement for the provided
+    // query, prepared on `sess` rather than on the main session. For use with
+    // pooled sessions, off the main thread.
+    static StatementContext prepareStatement(soci::session& sess,
+                                             std::string const& query);
+
+    // Return "(:v0,:v1,...)", a parenthesized list of `n` placeholders for an
+    // IN clause whose values are then bound one by one.
+    static std::string inListPlaceholders(size_t n);
+
+    // Return "(:v0,:v1),(:v2,:v3),...", `nRows` parenthesized tuples of
+    // `nCols` placeholders each, for a multi-row VALUES clause.
+    static std::string valuesPlaceholders(size_t nRows, size_t nCols);
+
+    // Return "(a=:v0 AND b=:v1) OR (a=:v2 AND b=:v3) OR ...", a condition
+    // matching any of `nRows` rows on the given key columns.
+    static std::string
+    anyRowCondition(std::vector<std::string> const& columns, size_t nRows);
+
+    // Run a statement over `nRows` rows of `nCols` bound values each, split
+    // into as few statements as the database's limit on parameters per
+    // statement allows. `sqlForRows(n)` returns the SQL of a statement over n
+    // rows, and `bindRow(st, i)` binds the values of row i, in order.
+    static void executeBatched(
+        soci::session& sess, size_t nRows, size_t nCols,
+        std::function<std::string(size_t)> const& sqlForRows,
+        std::function<void(soci::statement&, size_t)> const& bindRow);
+
     // Purge all cached prepared statements, closing their handles with the
     // database.
     void clearPreparedStatementCache();
@@ -192,9 +227,19 @@ class Database : NonMovableOrCopyable
     // Access the LedgerEntry cache. Note: clients are responsible for
     // invalidating entries in this cache as they perform statements
     // against the database. It's kept here only for ease of access.
-    typedef cache::lru_cache<std::string, std::shared_ptr<LedgerEntry const>>
-        EntryCache;
     EntryCache& getEntryCache();
+
+    // Access the buffer of ledger entry writes deferred while closing a
+    // ledger; see LedgerStateBuffer.
+    LedgerStateBuffer& getLedgerStateBuffer();
+
+    // Access the in-memory order book offers are crossed from; see
+    // OrderBook.
+    OrderBook& getOrderBook();
+
+    // Whether account signers are written inline in the accounts table
+    // rather than to the signers table; see AccountFrame.
+    bool hasInlineAccountSigners() const;
 };
 
 class DBTimeExcluder : NonCopyable
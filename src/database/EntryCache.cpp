@@ -0,0 +1,231 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "database/EntryCache.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "util/make_unique.h"
+#include "xdrpp/marshal.h"
+#include <cassert>
+#include <limits>
+
+namespace stellar
+{
+
+size_t const EntryCache::NUM_SHARDS;
+size_t const EntryCache::NUM_TYPES;
+
+namespace
+{
+// Rough bookkeeping cost of a cache entry on top of its XDR size: the slot,
+// the index node (which holds the key) and the LedgerEntry object itself.
+size_t const ENTRY_OVERHEAD =
+    sizeof(LedgerKey) + sizeof(LedgerEntry) + 8 * sizeof(void*);
+
+size_t
+entrySize(EntryCache::EntryPtr const& entry)
+{
+    return ENTRY_OVERHEAD + (entry ? xdr::xdr_size(*entry) : 0);
+}
+}
+
+EntryCache::EntryCache(medida::MetricsRegistry& metrics, size_t maxBytes)
+    : mMaxBytes(maxBytes)
+    , mMaxShardBytes(maxBytes / NUM_SHARDS)
+    , mHash{shortHash::randomKey()}
+{
+    // The key keeps hashes (and thus shard and bucket placement) unknown
+    // to whoever picks the account IDs that end up in the cache.
+    for (size_t i = 0; i < NUM_SHARDS; ++i)
+    {
+        mShards.emplace_back(make_unique<Shard>(mHash));
+    }
+    static char const* names[NUM_TYPES] = {"account", "trustline", "offer",
+                                           "data"};
+    for (size_t t = 0; t < NUM_TYPES; ++t)
+    {
+        auto& m = mMeters[t];
+        m.mHit = &metrics.NewMeter({"entry-cache", names[t], "hit"}, "entry");
+        m.mMiss =
+            &metrics.NewMeter({"entry-cache", names[t], "miss"}, "entry");
+        m.mEvict =
+            &metrics.NewMeter({"entry-cache", names[t], "evict"}, "entry");
+    }
+}
+
+EntryCache::Shard&
+EntryCache::getShard(size_t hash)
+{
+    // The index buckets on the low bits of the hash, so use the high ones
+    // to pick the shard.
+    return *mShards[(hash >> (std::numeric_limits<size_t>::digits - 8)) %
+                    NUM_SHARDS];
+}
+
+EntryCache::TypeMeters&
+EntryCache::getMeters(LedgerKey const& key)
+{
+    return mMeters[static_cast<size_t>(key.type()) % NUM_TYPES];
+}
+
+bool
+EntryCache::get(LedgerKey const& key, EntryPtr& entry)
+{
+    auto& shard = getShard(mHash(key));
+    {
+        std::lock_guard<std::mutex> guard(shard.mMutex);
+        auto it = shard.mIndex.find(key);
+        if (it != shard.mIndex.end())
+        {
+            auto& slot = shard.mSlots[it->second];
+            slot.mReferenced = true;
+            entry = slot.mEntry;
+            getMeters(key).mHit->Mark();
+            return true;
+        }
+    }
+    getMeters(key).mMiss->Mark();
+    return false;
+}
+
+void
+EntryCache::put(LedgerKey const& key, EntryPtr entry)
+{
+    size_t bytes = entrySize(entry);
+    if (bytes > mMaxShardBytes)
+    {
+        // Caching this would evict the whole shard (and the entry itself);
+        // just make sure no stale version stays around.
+        erase(key);
+        return;
+    }
+
+    auto& shard = getShard(mHash(key));
+    std::lock_guard<std::mutex> guard(shard.mMutex);
+    auto res = shard.mIndex.emplace(key, 0);
+    if (res.second)
+    {
+        size_t i;
+        if (shard.mFreeSlots.empty())
+        {
+            i = shard.mSlots.size();
+            shard.mSlots.emplace_back();
+        }
+        else
+        {
+            i = shard.mFreeSlots.back();
+            shard.mFreeSlots.pop_back();
+        }
+        res.first->second = i;
+        shard.mSlots[i].mKey = &res.first->first;
+    }
+    size_t i = res.first->second;
+    auto& slot = shard.mSlots[i];
+    shard.mBytes -= slot.mBytes;
+    slot.mEntry = std::move(entry);
+    slot.mBytes = bytes;
+    // Entries only get their bit set once read back, so that a run of
+    // entries loaded once (a large payment batch, say) is what gets evicted
+    // rather than the entries that keep being reused.
+    slot.mReferenced = !res.second;
+    shard.mBytes += bytes;
+
+    while (shard.mBytes > mMaxShardBytes)
+    {
+        evict(shard, i);
+    }
+}
+
+void
+EntryCache::erase(LedgerKey const& key)
+{
+    auto& shard = getShard(mHash(key));
+    std::lock_guard<std::mutex> guard(shard.mMutex);
+    auto it = shard.mIndex.find(key);
+    if (it != shard.mIndex.end())
+    {
+        eraseSlot(shard, it->second);
+    }
+}
+
+void
+EntryCache::eraseSlot(Shard& shard, size_t i)
+{
+    auto& slot = shard.mSlots[i];
+    // The slot points at the key held by the index node, so erase the node
+    // by position rather than by (its own) key.
+    auto it = shard.mIndex.find(*slot.mKey);
+    assert(it != shard.mIndex.end() && it->second == i);
+    shard.mBytes -= slot.mBytes;
+    slot = Slot{};
+    shard.mFreeSlots.push_back(i);
+    shard.mIndex.erase(it);
+}
+
+void
+EntryCache::evict(Shard& shard, size_t keep)
+{
+    // Every live slot is either evicted on the first lap or has its bit
+    // cleared, so this terminates within two laps.
+    assert(shard.mIndex.size() > 1);
+    for (;;)
+    {
+        if (shard.mHand >= shard.mSlots.size())
+        {
+            shard.mHand = 0;
+        }
+        auto& slot = shard.mSlots[shard.mHand++];
+        if (!slot.mKey || shard.mHand - 1 == keep)
+        {
+            continue;
+        }
+        if (slot.mReferenced)
+        {
+            slot.mReferenced = false;
+            continue;
+        }
+        getMeters(*slot.mKey).mEvict->Mark();
+        eraseSlot(shard, shard.mHand - 1);
+        return;
+    }
+}
+
+void
+EntryCache::clear()
+{
+    for (auto& s : mShards)
+    {
+        std::lock_guard<std::mutex> guard(s->mMutex);
+        s->mIndex.clear();
+        s->mSlots.clear();
+        s->mFreeSlots.clear();
+        s->mHand = 0;
+        s->mBytes = 0;
+    }
+}
+
+size_t
+EntryCache::size() const
+{
+    size_t n = 0;
+    for (auto const& s : mShards)
+    {
+        std::lock_guard<std::mutex> guard(s->mMutex);
+        n += s->mIndex.size();
+    }
+    return n;
+}
+
+size_t
+EntryCache::getBytes() const
+{
+    size_t n = 0;
+    for (auto const& s : mShards)
+    {
+        std::lock_guard<std::mutex> guard(s->mMutex);
+        n += s->mBytes;
+    }
+    return n;
+}
+}
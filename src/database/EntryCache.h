@@ -0,0 +1,105 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerHashUtils.h"
+#include "overlay/StellarXDR.h"
+#include "util/NonCopyable.h"
+#include <array>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace medida
+{
+class MetricsRegistry;
+class Meter;
+}
+
+namespace stellar
+{
+
+/**
+ * Cache of LedgerEntries loaded from the database, keyed directly on their
+ * LedgerKey. A cached nullptr records that the entry is known not to exist.
+ *
+ * The cache is bounded by an (approximate) number of bytes rather than a
+ * number of entries, and is split into shards, each with its own lock, so
+ * that it can be read from worker threads while the main thread uses it.
+ * Each shard evicts with the CLOCK algorithm: a read only sets a bit on the
+ * entry, and the eviction hand gives every entry with its bit set a second
+ * chance before dropping it.
+ *
+ * Clients are responsible for invalidating entries as they write to the
+ * database.
+ */
+class EntryCache : NonMovableOrCopyable
+{
+  public:
+    typedef std::shared_ptr<LedgerEntry const> EntryPtr;
+
+    EntryCache(medida::MetricsRegistry& metrics, size_t maxBytes);
+
+    // Sets `entry` and returns true if `key` is in the cache; `entry` may
+    // then be nullptr if the key is cached as non-existent.
+    bool get(LedgerKey const& key, EntryPtr& entry);
+    void put(LedgerKey const& key, EntryPtr entry);
+    void erase(LedgerKey const& key);
+    void clear();
+
+    size_t size() const;
+    size_t getBytes() const;
+    size_t
+    getMaxBytes() const
+    {
+        return mMaxBytes;
+    }
+
+  private:
+    static size_t const NUM_SHARDS = 16;
+    static size_t const NUM_TYPES = DATA + 1;
+
+    struct Slot
+    {
+        LedgerKey const* mKey{nullptr};
+        EntryPtr mEntry;
+        size_t mBytes{0};
+        bool mReferenced{false};
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mMutex;
+        std::unordered_map<LedgerKey, size_t, LedgerKeyHash> mIndex;
+        std::vector<Slot> mSlots;
+        std::vector<size_t> mFreeSlots;
+        size_t mHand{0};
+        size_t mBytes{0};
+
+        explicit Shard(LedgerKeyHash const& hash) : mIndex(0, hash)
+        {
+        }
+    };
+
+    struct TypeMeters
+    {
+        medida::Meter* mHit;
+        medida::Meter* mMiss;
+        medida::Meter* mEvict;
+    };
+
+    size_t const mMaxBytes;
+    size_t const mMaxShardBytes;
+    LedgerKeyHash const mHash;
+    std::vector<std::unique_ptr<Shard>> mShards;
+    std::array<TypeMeters, NUM_TYPES> mMeters;
+
+    Shard& getShard(size_t hash);
+    TypeMeters& getMeters(LedgerKey const& key);
+    void eraseSlot(Shard& shard, size_t slot);
+    void evict(Shard& shard, size_t keep);
+};
+}
@@ -0,0 +1,159 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "database/EntryCache.h"
+#include "ledger/LedgerTestUtils.h"
+#include "lib/catch.hpp"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include <atomic>
+#include <thread>
+
+using namespace stellar;
+
+namespace
+{
+LedgerKey
+accountKey(uint8_t i)
+{
+    LedgerKey k;
+    k.type(ACCOUNT);
+    k.account().accountID.ed25519()[0] = i;
+    return k;
+}
+
+EntryCache::EntryPtr
+accountEntry(LedgerKey const& key)
+{
+    auto e = std::make_shared<LedgerEntry>();
+    e->data.type(ACCOUNT);
+    e->data.account().accountID = key.account().accountID;
+    return e;
+}
+}
+
+TEST_CASE("entry cache get/put/erase", "[entrycache]")
+{
+    medida::MetricsRegistry metrics;
+    EntryCache cache(metrics, 1024 * 1024);
+    auto k0 = accountKey(0);
+    auto k1 = accountKey(1);
+    EntryCache::EntryPtr p;
+
+    REQUIRE(!cache.get(k0, p));
+    cache.put(k0, accountEntry(k0));
+    cache.put(k1, nullptr);
+    REQUIRE(cache.size() == 2);
+
+    REQUIRE(cache.get(k0, p));
+    REQUIRE(p);
+    REQUIRE(p->data.account().accountID == k0.account().accountID);
+    // A cached absence is a hit with a null entry.
+    REQUIRE(cache.get(k1, p));
+    REQUIRE(!p);
+
+    cache.erase(k0);
+    REQUIRE(!cache.get(k0, p));
+    REQUIRE(cache.size() == 1);
+    cache.clear();
+    REQUIRE(cache.size() == 0);
+    REQUIRE(cache.getBytes() == 0);
+
+    auto& hits = metrics.NewMeter({"entry-cache", "account", "hit"}, "entry");
+    auto& misses =
+        metrics.NewMeter({"entry-cache", "account", "miss"}, "entry");
+    REQUIRE(hits.count() == 2);
+    REQUIRE(misses.count() == 2);
+}
+
+TEST_CASE("entry cache distinguishes keys of all types", "[entrycache]")
+{
+    medida::MetricsRegistry metrics;
+    EntryCache cache(metrics, 16 * 1024 * 1024);
+    std::vector<LedgerKey> keys;
+    for (auto const& e : LedgerTestUtils::generateValidLedgerEntries(200))
+    {
+        keys.emplace_back(LedgerEntryKey(e));
+        cache.put(keys.back(), std::make_shared<LedgerEntry const>(e));
+    }
+    for (auto const& k : keys)
+    {
+        EntryCache::EntryPtr p;
+        REQUIRE(cache.get(k, p));
+        REQUIRE(p);
+        REQUIRE(LedgerEntryKey(*p) == k);
+    }
+}
+
+TEST_CASE("entry cache stays within its byte budget", "[entrycache]")
+{
+    medida::MetricsRegistry metrics;
+    size_t const budget = 64 * 1024;
+    EntryCache cache(metrics, budget);
+    auto hot = accountKey(0);
+    cache.put(hot, accountEntry(hot));
+
+    for (uint32_t i = 1; i < 5000; ++i)
+    {
+        LedgerKey k;
+        k.type(OFFER);
+        k.offer().offerID = i;
+        cache.put(k, nullptr);
+        REQUIRE(cache.getBytes() <= budget);
+
+        // Keep touching one entry: CLOCK should never pick it.
+        EntryCache::EntryPtr p;
+        REQUIRE(cache.get(hot, p));
+    }
+    REQUIRE(cache.size() < 5000);
+    auto& evictions =
+        metrics.NewMeter({"entry-cache", "offer", "evict"}, "entry");
+    REQUIRE(evictions.count() == 5000 - cache.size());
+}
+
+TEST_CASE("entry cache with no budget caches nothing", "[entrycache]")
+{
+    medida::MetricsRegistry metrics;
+    EntryCache cache(metrics, 0);
+    auto k = accountKey(0);
+    cache.put(k, accountEntry(k));
+    EntryCache::EntryPtr p;
+    REQUIRE(!cache.get(k, p));
+    REQUIRE(cache.size() == 0);
+}
+
+TEST_CASE("entry cache concurrent access", "[entrycache]")
+{
+    medida::MetricsRegistry metrics;
+    EntryCache cache(metrics, 256 * 1024);
+    std::atomic<bool> mismatch{false};
+    std::vector<std::thread> threads;
+    for (uint8_t t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&cache, &mismatch, t]() {
+            for (uint8_t i = 0; i < 200; ++i)
+            {
+                auto k = accountKey(i);
+                k.account().accountID.ed25519()[1] = t;
+                cache.put(k, accountEntry(k));
+                EntryCache::EntryPtr p;
+                if (cache.get(k, p) &&
+                    !(p->data.account().accountID == k.account().accountID))
+                {
+                    mismatch = true;
+                }
+                if (i % 3 == 0)
+                {
+                    cache.erase(k);
+                }
+            }
+        });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    REQUIRE(!mismatch);
+    REQUIRE(cache.getBytes() <= cache.getMaxBytes());
+}
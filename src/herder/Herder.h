@@ -103,6 +103,12 @@ class Herder
     virtual bool recvTxSet(Hash const& hash, TxSetFrame const& txset) = 0;
     // We are learning about a new transaction.
     virtual TransactionSubmitStatus recvTransaction(TransactionFramePtr tx) = 0;
+    // We are learning about a new transaction from the network: its
+    // signatures are checked in the background first, then `handler` gets
+    // what recvTransaction returned for it.
+    virtual void
+    recvTransaction(TransactionFramePtr tx,
+                    std::function<void(TransactionSubmitStatus)> handler) = 0;
     virtual void peerDoesntHave(stellar::MessageType type,
                                 uint256 const& itemID, PeerPtr peer) = 0;
     virtual TxSetFramePtr getTxSet(Hash const& hash) = 0;
@@ -105,6 +105,7 @@ HerderImpl::HerderImpl(Application& app)
            app.getConfig().QUORUM_SET)
     , mPendingTransactions(4)
     , mPendingEnvelopes(app, *this)
+    , mSignaturePrechecker(app)
     , mLastSlotSaved(0)
     , mLastStateChange(app.getClock().now())
     , mTrackingTimer(app)
@@ -946,6 +947,17 @@ HerderImpl::recvTransaction(TransactionFramePtr tx)
     return TX_STATUS_PENDING;
 }
 
+void
+HerderImpl::recvTransaction(
+    TransactionFramePtr tx,
+    std::function<void(TransactionSubmitStatus)> handler)
+{
+    mSignaturePrechecker.precheck(
+        tx, [this, handler](TransactionFramePtr checked) {
+            handler(recvTransaction(checked));
+        });
+}
+
 Herder::EnvelopeStatus
 HerderImpl::recvSCPEnvelope(SCPEnvelope const& envelope)
 {
@@ -6,6 +6,7 @@
 
 #include "PendingEnvelopes.h"
 #include "herder/Herder.h"
+#include "herder/TxSignaturePrechecker.h"
 #include "scp/SCP.h"
 #include "util/Timer.h"
 #include <deque>
@@ -95,6 +96,9 @@ class HerderImpl : public Herder, public SCPDriver
     void acceptedCommit(uint64 slotIndex, SCPBallot const& ballot) override;
 
     TransactionSubmitStatus recvTransaction(TransactionFramePtr tx) override;
+    void recvTransaction(
+        TransactionFramePtr tx,
+        std::function<void(TransactionSubmitStatus)> handler) override;
 
     EnvelopeStatus recvSCPEnvelope(SCPEnvelope const& envelope) override;
 
@@ -168,6 +172,8 @@ class HerderImpl : public Herder, public SCPDriver
 
     PendingEnvelopes mPendingEnvelopes;
 
+    TxSignaturePrechecker mSignaturePrechecker;
+
     void herderOutOfSync();
 
     struct ConsensusData
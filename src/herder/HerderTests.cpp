@@ -19,7 +19,12 @@
 #include "overlay/OverlayManager.h"
 #include "simulation/Simulation.h"
 #include "test/TxTests.h"
+#include "transactions/TxValidationMemo.h"
 
+#include "medida/counter.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
 #include "xdrpp/marshal.h"
 
 using namespace stellar;
@@ -152,6 +157,64 @@ TEST_CASE("standalone", "[herder]")
 //  tx from account not in the DB
 TEST_CASE("recvTx", "[herder]")
 {
+    Config cfg(getTestConfig());
+
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+
+    Hash const& networkID = app->getNetworkID();
+    app->start();
+
+    auto root = TestAccount::createRoot(*app);
+    auto a1 = getAccount("A");
+    const int64_t paymentAmount = app->getLedgerManager().getMinBalance(0);
+
+    SECTION("signatures are checked in the background, in order")
+    {
+        auto& verify = app->getMetrics().NewTimer(
+            {"herder", "sig-precheck", "verify"});
+        auto& queue =
+            app->getMetrics().NewCounter({"herder", "sig-precheck", "queue"});
+
+        std::vector<TransactionFramePtr> txs;
+        txs.emplace_back(createCreateAccountTx(networkID, root, a1,
+                                               root.nextSequenceNumber(),
+                                               paymentAmount));
+        for (int i = 0; i < 20; ++i)
+        {
+            txs.emplace_back(createPaymentTx(networkID, root, a1,
+                                             root.nextSequenceNumber(),
+                                             paymentAmount));
+        }
+        auto bad = createPaymentTx(networkID, root, a1,
+                                   root.nextSequenceNumber(), paymentAmount);
+        bad->getEnvelope().signatures[0].signature[0] ^= 1;
+        txs.emplace_back(bad);
+
+        std::vector<Herder::TransactionSubmitStatus> statuses;
+        for (auto const& tx : txs)
+        {
+            app->getHerder().recvTransaction(
+                tx, [&statuses](Herder::TransactionSubmitStatus status) {
+                    statuses.emplace_back(status);
+                });
+        }
+        REQUIRE(statuses.empty());
+
+        while (statuses.size() < txs.size())
+        {
+            clock.crank(true);
+        }
+        // each transaction only passes if its predecessor got there first
+        for (size_t i = 0; i + 1 < txs.size(); ++i)
+        {
+            REQUIRE(statuses[i] == Herder::TX_STATUS_PENDING);
+        }
+        REQUIRE(statuses.back() == Herder::TX_STATUS_ERROR);
+        REQUIRE(bad->getResultCode() == txBAD_AUTH);
+        REQUIRE(verify.count() == txs.size());
+        REQUIRE(queue.count() == 0);
+    }
 }
 
 TEST_CASE("txset", "[herder]")
@@ -301,6 +364,164 @@ TEST_CASE("txset", "[herder]")
     }
 }
 
+TEST_CASE("txset checked in parallel", "[herder]")
+{
+    // in-memory databases can't be read from the worker threads
+    Config cfg(getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE));
+
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+
+    Hash const& networkID = app->getNetworkID();
+    app->start();
+    REQUIRE(app->getDatabase().canUsePool());
+
+    auto root = TestAccount::createRoot(*app);
+
+    const int nbAccounts = 8;
+    const int nbTransactions = 3;
+    // only the fees count when checking a set
+    const int64_t paymentAmount = 100;
+    const int64_t startingBalance =
+        app->getLedgerManager().getMinBalance(0) +
+        nbTransactions * app->getLedgerManager().getTxFee();
+
+    std::vector<TestAccount> accounts;
+    for (int i = 0; i < nbAccounts; i++)
+    {
+        std::string accountName = "A";
+        accountName += '0' + (char)i;
+        accounts.emplace_back(root.create(accountName, startingBalance));
+    }
+
+    TxSetFramePtr txSet = std::make_shared<TxSetFrame>(
+        app->getLedgerManager().getLastClosedLedgerHeader().hash);
+    for (auto& a : accounts)
+    {
+        for (int j = 0; j < nbTransactions; j++)
+        {
+            txSet->add(createPaymentTx(networkID, a, root,
+                                       a.nextSequenceNumber(), paymentAmount));
+        }
+    }
+
+    // make the chains load their accounts from the database
+    app->getDatabase().getEntryCache().clear();
+
+    SECTION("success")
+    {
+        txSet->sortForHash();
+        REQUIRE(txSet->checkValid(*app));
+        REQUIRE(txSet->checkValid(*app));
+    }
+    SECTION("no user")
+    {
+        auto unknown = getAccount("unknown");
+        txSet->add(createPaymentTx(networkID, unknown, root, 1, paymentAmount));
+        txSet->sortForHash();
+        REQUIRE(!txSet->checkValid(*app));
+
+        std::vector<TransactionFramePtr> removed;
+        txSet->trimInvalid(*app, removed);
+        REQUIRE(removed.size() == 1);
+        REQUIRE(txSet->checkValid(*app));
+    }
+    SECTION("sequence gap")
+    {
+        auto& a = accounts.back();
+        txSet->add(createPaymentTx(networkID, a, root,
+                                   a.getLastSequenceNumber() + 5,
+                                   paymentAmount));
+        txSet->sortForHash();
+        REQUIRE(!txSet->checkValid(*app));
+    }
+    SECTION("insufficient balance")
+    {
+        auto& a = accounts.front();
+        txSet->add(createPaymentTx(networkID, a, root, a.nextSequenceNumber(),
+                                   paymentAmount));
+        txSet->sortForHash();
+        REQUIRE(!txSet->checkValid(*app));
+    }
+}
+
+TEST_CASE("txset validation memo", "[herder]")
+{
+    Config cfg(getTestConfig());
+
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+
+    Hash const& networkID = app->getNetworkID();
+    app->start();
+
+    auto root = TestAccount::createRoot(*app);
+    auto a1 = root.create("A1", app->getLedgerManager().getMinBalance(0) +
+                                    10 * app->getLedgerManager().getTxFee());
+
+    auto& memo = app->getLedgerManager().getTxValidationMemo();
+    auto& hits = app->getMetrics().NewMeter(
+        {"transaction", "validation-memo", "hit"}, "transaction");
+    auto& misses = app->getMetrics().NewMeter(
+        {"transaction", "validation-memo", "miss"}, "transaction");
+
+    auto good =
+        createPaymentTx(networkID, a1, root, a1.nextSequenceNumber(), 100);
+    auto extraSig =
+        createPaymentTx(networkID, a1, root, a1.nextSequenceNumber(), 100);
+    extraSig->addSignature(root);
+
+    auto makeTxSet =
+        [&](std::vector<TransactionFramePtr> const& txs) -> TxSetFramePtr {
+        auto txSet = std::make_shared<TxSetFrame>(
+            app->getLedgerManager().getLastClosedLedgerHeader().hash);
+        for (auto const& tx : txs)
+        {
+            txSet->add(tx);
+        }
+        txSet->sortForHash();
+        return txSet;
+    };
+
+    REQUIRE(!makeTxSet({good, extraSig})->checkValid(*app));
+    REQUIRE(memo.size() == 2);
+    auto hitsBefore = hits.count();
+    auto missesBefore = misses.count();
+
+    SECTION("same outcome from the memo")
+    {
+        REQUIRE(!makeTxSet({good, extraSig})->checkValid(*app));
+        REQUIRE(extraSig->getResultCode() == txBAD_AUTH_EXTRA);
+        REQUIRE(makeTxSet({good})->checkValid(*app));
+        REQUIRE(hits.count() == hitsBefore + 3);
+        REQUIRE(misses.count() == missesBefore);
+    }
+    SECTION("sequence number still checked")
+    {
+        auto const& lcl = app->getLedgerManager().getLastClosedLedgerHeader();
+        TransactionResultCode code;
+        REQUIRE(memo.get(good->getFullHash(), lcl.hash, code));
+        REQUIRE(code == txSUCCESS);
+
+        REQUIRE(!good->checkValid(*app, good->getSeqNum(), &memo));
+        REQUIRE(good->getResultCode() == txBAD_SEQ);
+        REQUIRE(good->checkValid(*app, 0, &memo));
+        REQUIRE(!extraSig->checkValid(*app, 0, &memo));
+        REQUIRE(extraSig->getResultCode() == txBAD_SEQ);
+        REQUIRE(memo.size() == 2);
+    }
+    SECTION("dropped when the ledger closes")
+    {
+        closeLedgerOn(*app, 2, 1, 1, 2016);
+        REQUIRE(memo.size() == 0);
+
+        // the payments have not been applied, so are still valid
+        REQUIRE(makeTxSet({good})->checkValid(*app));
+        REQUIRE(hits.count() == hitsBefore);
+        REQUIRE(misses.count() == missesBefore + 1);
+    }
+}
+
 // under surge
 // over surge
 // make sure it drops the correct txs
@@ -5,13 +5,26 @@
 #include "util/asio.h"
 #include "TxSetFrame.h"
 #include "crypto/Hex.h"
+#include "crypto/KeyUtils.h"
 #include "crypto/SHA.h"
+#include "crypto/SecretKey.h"
+#include "crypto/SignerKey.h"
 #include "database/Database.h"
+#include "ledger/AccountFrame.h"
+#include "ledger/EntryFrame.h"
 #include "main/Application.h"
 #include "main/Config.h"
+#include "transactions/TxValidationMemo.h"
 #include "util/Logging.h"
+#include "util/make_unique.h"
 #include "xdrpp/marshal.h"
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 #include "xdrpp/printer.h"
 
@@ -186,6 +199,275 @@ TxSetFrame::surgePricingFilter(LedgerManager const& lm)
     }
 }
 
+namespace
+{
+// Calls fn(i, onCaller) for every i below n, on the worker threads and the
+// calling one (for which onCaller is set). Each takes the next index nobody
+// has started yet, so workers busy with something else can only hold the
+// caller up by the ones they did take. Once all are done, rethrows the first
+// exception fn threw, if any.
+void
+forEachInParallel(Application& app, size_t n,
+                  std::function<void(size_t, bool)> fn)
+{
+    if (n == 0)
+    {
+        return;
+    }
+
+    struct Batch
+    {
+        std::function<void(size_t, bool)> mFn;
+        size_t mCount;
+        std::atomic<size_t> mNext{0};
+        std::atomic<size_t> mDone{0};
+        std::mutex mMutex;
+        std::condition_variable mAllDone;
+        std::exception_ptr mError;
+    };
+    auto batch = std::make_shared<Batch>();
+    batch->mFn = std::move(fn);
+    batch->mCount = n;
+
+    auto work = [batch](bool onCaller) {
+        size_t i;
+        while ((i = batch->mNext++) < batch->mCount)
+        {
+            try
+            {
+                batch->mFn(i, onCaller);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> guard(batch->mMutex);
+                if (!batch->mError)
+                {
+                    batch->mError = std::current_exception();
+                }
+            }
+            if (++batch->mDone == batch->mCount)
+            {
+                std::lock_guard<std::mutex> guard(batch->mMutex);
+                batch->mAllDone.notify_all();
+            }
+        }
+    };
+
+    size_t helpers =
+        std::min<size_t>(n - 1, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < helpers; ++i)
+    {
+        app.getWorkerIOService().post([work]() { work(false); });
+    }
+    work(true);
+
+    std::unique_lock<std::mutex> lock(batch->mMutex);
+    batch->mAllDone.wait(
+        lock, [&batch]() { return batch->mDone == batch->mCount; });
+    if (batch->mError)
+    {
+        std::rethrow_exception(batch->mError);
+    }
+}
+
+// Verifies `checks` in chunks spread over the worker threads.
+void
+verifyInParallel(Application& app,
+                 std::vector<PubKeyUtils::VerifySigRequest> const& checks)
+{
+    static size_t const CHUNK_SIZE = 64;
+
+    size_t chunks = (checks.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    forEachInParallel(app, chunks, [&checks](size_t i, bool) {
+        auto begin = checks.begin() + i * CHUNK_SIZE;
+        auto end =
+            checks.begin() + std::min(checks.size(), (i + 1) * CHUNK_SIZE);
+        try
+        {
+            PubKeyUtils::verifySigs(
+                std::vector<PubKeyUtils::VerifySigRequest>(begin, end));
+        }
+        catch (std::exception& e)
+        {
+            // the signatures get checked again where it counts
+            CLOG(WARNING, "Herder")
+                << "Failed to verify signatures: " << e.what();
+        }
+    });
+}
+
+// Loads the accounts `txs` need signatures from, from the entry cache or else
+// the database, in a single query. The calling thread uses the main session,
+// workers lease one from the pool.
+TransactionFrame::AccountSnapshot
+loadSigningAccounts(Database& db, std::vector<TransactionFramePtr> const& txs,
+                    bool onCaller)
+{
+    std::vector<AccountID> ids;
+    for (auto const& tx : txs)
+    {
+        tx->insertSigningAccounts(ids);
+    }
+
+    TransactionFrame::AccountSnapshot accounts;
+    std::vector<AccountID> missing;
+    auto& cache = db.getEntryCache();
+    for (auto const& id : ids)
+    {
+        if (accounts.find(id) != accounts.end())
+        {
+            continue;
+        }
+        LedgerKey key;
+        key.type(ACCOUNT);
+        key.account().accountID = id;
+        EntryCache::EntryPtr entry;
+        if (cache.get(key, entry))
+        {
+            accounts.emplace(id, entry ? std::make_shared<AccountFrame>(*entry)
+                                       : nullptr);
+        }
+        else
+        {
+            accounts.emplace(id, nullptr);
+            missing.emplace_back(id);
+        }
+    }
+    if (missing.empty())
+    {
+        return accounts;
+    }
+
+    std::unique_ptr<soci::session> lease;
+    if (!onCaller)
+    {
+        lease = make_unique<soci::session>(db.getPool());
+    }
+    auto& sess = lease ? *lease : db.getSession();
+    {
+        auto timer = db.getSelectTimer("account");
+        AccountFrame::loadAccounts(sess, missing, [&](LedgerEntry const& le) {
+            auto entry = std::make_shared<LedgerEntry const>(le);
+            cache.put(LedgerEntryKey(le), entry);
+            accounts[le.data.account().accountID] =
+                std::make_shared<AccountFrame>(*entry);
+        });
+    }
+    // remember the accounts that do not exist, as loadAccount would
+    for (auto const& id : missing)
+    {
+        if (!accounts[id])
+        {
+            LedgerKey key;
+            key.type(ACCOUNT);
+            key.account().accountID = id;
+            cache.put(key, nullptr);
+        }
+    }
+    return accounts;
+}
+
+// Checks the transactions of `chain`, all from the same account and sorted by
+// sequence number, and that the account can pay for all of them. Loads the
+// accounts from `accounts` if set, or else the database.
+bool
+checkChainValid(Application& app, Hash const& previousLedgerHash,
+                std::vector<TransactionFramePtr> const& chain,
+                TransactionFrame::AccountSnapshot const* accounts)
+{
+    auto& memo = app.getLedgerManager().getTxValidationMemo();
+    TransactionFramePtr lastTx;
+    SequenceNumber lastSeq = 0;
+    int64_t totFee = 0;
+    for (auto& tx : chain)
+    {
+        bool valid = accounts ? tx->checkValid(app, lastSeq, *accounts, &memo)
+                              : tx->checkValid(app, lastSeq, &memo);
+        if (!valid)
+        {
+            CLOG(DEBUG, "Herder")
+                << "bad txSet: " << hexAbbrev(previousLedgerHash)
+                << " tx invalid"
+                << " lastSeq:" << lastSeq
+                << " tx: " << xdr::xdr_to_string(tx->getEnvelope())
+                << " result: " << tx->getResultCode();
+
+            return false;
+        }
+        totFee += tx->getFee();
+
+        lastTx = tx;
+        lastSeq = tx->getSeqNum();
+    }
+    if (lastTx)
+    {
+        // make sure account can pay the fee for all these tx
+        int64_t newBalance = lastTx->getSourceAccount().getBalance() - totFee;
+        if (newBalance < lastTx->getSourceAccount().getMinimumBalance(
+                             app.getLedgerManager()))
+        {
+            CLOG(DEBUG, "Herder")
+                << "bad txSet: " << hexAbbrev(previousLedgerHash)
+                << " account can't pay fee"
+                << " tx:" << xdr::xdr_to_string(lastTx->getEnvelope());
+
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+void
+TxSetFrame::verifySignatures(Application& app) const
+{
+    auto const& memo = app.getLedgerManager().getTxValidationMemo();
+    auto const& lclHash =
+        app.getLedgerManager().getLastClosedLedgerHeader().hash;
+
+    // checkValid won't look at the signatures of memoized transactions again
+    std::vector<TransactionFramePtr> txs;
+    for (auto const& tx : mTransactions)
+    {
+        if (!memo.has(tx->getFullHash(), lclHash))
+        {
+            txs.emplace_back(tx);
+        }
+    }
+    auto snapshot = loadSigningAccounts(app.getDatabase(), txs, true);
+
+    std::vector<PubKeyUtils::VerifySigRequest> checks;
+    std::map<AccountID, std::vector<SignerKey>> keys;
+    std::vector<AccountID> accounts;
+    std::vector<SignerKey> txKeys;
+    for (auto const& tx : txs)
+    {
+        accounts.clear();
+        txKeys.clear();
+        tx->insertSigningAccounts(accounts);
+        for (auto const& id : accounts)
+        {
+            auto it = keys.find(id);
+            if (it == keys.end())
+            {
+                it = keys.emplace(id, std::vector<SignerKey>()).first;
+                it->second.emplace_back(KeyUtils::convertKey<SignerKey>(id));
+                auto const& account = snapshot[id];
+                if (account)
+                {
+                    for (auto const& s : account->getAccount().signers)
+                    {
+                        it->second.emplace_back(s.key);
+                    }
+                }
+            }
+            txKeys.insert(txKeys.end(), it->second.begin(), it->second.end());
+        }
+        tx->insertSignatureChecks(txKeys, checks);
+    }
+    verifyInParallel(app, checks);
+}
+
 // TODO.3 this and checkValid share a lot of code
 void
 TxSetFrame::trimInvalid(Application& app,
@@ -195,8 +477,10 @@ TxSetFrame::trimInvalid(Application& app,
     app.getDatabase().setCurrentTransactionReadOnly();
 
     sortForHash();
+    verifySignatures(app);
 
     map<AccountID, vector<TransactionFramePtr>> accountTxMap;
+    auto& memo = app.getLedgerManager().getTxValidationMemo();
 
     for (auto tx : mTransactions)
     {
@@ -213,7 +497,7 @@ TxSetFrame::trimInvalid(Application& app,
         int64_t totFee = 0;
         for (auto& tx : item.second)
         {
-            if (!tx->checkValid(app, lastSeq))
+            if (!tx->checkValid(app, lastSeq, &memo))
             {
                 trimmed.push_back(tx);
                 removeTx(tx);
@@ -289,50 +573,78 @@ TxSetFrame::checkValid(Application& app) const
         lastHash = tx->getFullHash();
     }
 
+    vector<vector<TransactionFramePtr>*> chains;
     for (auto& item : accountTxMap)
     {
         // order by sequence number
         std::sort(item.second.begin(), item.second.end(), SeqSorter);
+        chains.emplace_back(&item.second);
+    }
 
-        TransactionFramePtr lastTx;
-        SequenceNumber lastSeq = 0;
-        int64_t totFee = 0;
-        for (auto& tx : item.second)
+    auto& db = app.getDatabase();
+    if (chains.size() < 2 || !db.canUsePool())
+    {
+        verifySignatures(app);
+        for (auto chain : chains)
         {
-            if (!tx->checkValid(app, lastSeq))
+            if (!checkChainValid(app, mPreviousLedgerHash, *chain, nullptr))
             {
-                CLOG(DEBUG, "Herder")
-                    << "bad txSet: " << hexAbbrev(mPreviousLedgerHash)
-                    << " tx invalid"
-                    << " lastSeq:" << lastSeq
-                    << " tx: " << xdr::xdr_to_string(tx->getEnvelope())
-                    << " result: " << tx->getResultCode();
-
                 return false;
             }
-            totFee += tx->getFee();
+        }
+        return true;
+    }
 
-            lastTx = tx;
-            lastSeq = tx->getSeqNum();
+    // Chains are independent of one another, so check them on the worker
+    // threads too, each against the accounts it needs loaded up front (the
+    // database does not change while we wait). Chains not started once one
+    // fails are skipped.
+    std::atomic<bool> failed{false};
+    Hash const& previousLedgerHash = mPreviousLedgerHash;
+    auto const& memo = app.getLedgerManager().getTxValidationMemo();
+    auto const& lclHash = lcl.hash;
+    forEachInParallel(app, chains.size(), [&](size_t i, bool onCaller) {
+        if (failed)
+        {
+            return;
         }
-        if (lastTx)
+        auto const& chain = *chains[i];
+        auto accounts = loadSigningAccounts(db, chain, onCaller);
+
+        std::vector<PubKeyUtils::VerifySigRequest> checks;
+        std::vector<AccountID> ids;
+        std::vector<SignerKey> keys;
+        for (auto const& tx : chain)
         {
-            // make sure account can pay the fee for all these tx
-            int64_t newBalance =
-                lastTx->getSourceAccount().getBalance() - totFee;
-            if (newBalance < lastTx->getSourceAccount().getMinimumBalance(
-                                 app.getLedgerManager()))
+            if (memo.has(tx->getFullHash(), lclHash))
             {
-                CLOG(DEBUG, "Herder")
-                    << "bad txSet: " << hexAbbrev(mPreviousLedgerHash)
-                    << " account can't pay fee"
-                    << " tx:" << xdr::xdr_to_string(lastTx->getEnvelope());
-
-                return false;
+                continue;
+            }
+            ids.clear();
+            keys.clear();
+            tx->insertSigningAccounts(ids);
+            for (auto const& id : ids)
+            {
+                keys.emplace_back(KeyUtils::convertKey<SignerKey>(id));
+                auto const& account = accounts[id];
+                if (account)
+                {
+                    for (auto const& s : account->getAccount().signers)
+                    {
+                        keys.emplace_back(s.key);
+                    }
+                }
             }
+            tx->insertSignatureChecks(keys, checks);
         }
-    }
-    return true;
+        PubKeyUtils::verifySigs(checks);
+
+        if (!checkChainValid(app, previousLedgerHash, chain, &accounts))
+        {
+            failed = true;
+        }
+    });
+    return !failed;
 }
 
 void
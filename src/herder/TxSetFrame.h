@@ -41,6 +41,14 @@ class TxSetFrame
 
     std::vector<TransactionFramePtr> sortForApply();
 
+    // Verifies the signatures of the transactions against the master keys
+    // and signers of the accounts they need signatures from, as of the
+    // database, spread over the worker threads; the results land in the
+    // verify-sig cache, for checkValid or apply to find there.
+    void verifySignatures(Application& app) const;
+
+    // Checks the transactions of each account, as a chain, on the worker
+    // threads as well when the database has a connection pool.
     bool checkValid(Application& app) const;
     void trimInvalid(Application& app,
                      std::vector<TransactionFramePtr>& trimmed);
@@ -0,0 +1,124 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "herder/TxSignaturePrechecker.h"
+#include "crypto/KeyUtils.h"
+#include "crypto/SecretKey.h"
+#include "crypto/SignerKey.h"
+#include "database/Database.h"
+#include "main/Application.h"
+#include "medida/counter.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+#include "util/Logging.h"
+#include "util/Timer.h"
+
+namespace stellar
+{
+
+size_t const TxSignaturePrechecker::MAX_QUEUED = 10000;
+
+TxSignaturePrechecker::TxSignaturePrechecker(Application& app)
+    : mApp(app)
+    , mQueueDepth(
+          app.getMetrics().NewCounter({"herder", "sig-precheck", "queue"}))
+    , mVerifyTimer(
+          app.getMetrics().NewTimer({"herder", "sig-precheck", "verify"}))
+    , mLatencyTimer(
+          app.getMetrics().NewTimer({"herder", "sig-precheck", "latency"}))
+    , mSkipped(app.getMetrics().NewMeter({"herder", "sig-precheck", "skipped"},
+                                         "transaction"))
+{
+}
+
+void
+TxSignaturePrechecker::precheck(TransactionFramePtr tx, Handler handler)
+{
+    auto p = std::make_shared<Pending>(
+        Pending{tx, handler, std::chrono::steady_clock::now(),
+                std::chrono::nanoseconds::zero(), false});
+    mQueue.emplace_back(p);
+    mQueueDepth.inc();
+
+    if (mQueue.size() > MAX_QUEUED)
+    {
+        mSkipped.Mark();
+        p->mDone = true;
+        handOver();
+        return;
+    }
+
+    // The frame is only touched by the worker until mDone is set back on
+    // the main thread; that includes caching its contents hash.
+    Application& app = mApp;
+    app.getWorkerIOService().post([this, &app, p]() {
+        auto start = std::chrono::steady_clock::now();
+        try
+        {
+            verifySignatures(app, *p->mTx);
+        }
+        catch (std::exception& e)
+        {
+            // checkValid will find out whatever is wrong with it
+            CLOG(DEBUG, "Herder")
+                << "Signature precheck failed: " << e.what();
+        }
+        auto verifyTime = std::chrono::steady_clock::now() - start;
+        app.getClock().getIOService().post([this, p, verifyTime]() {
+            p->mVerifyTime = verifyTime;
+            p->mDone = true;
+            handOver();
+        });
+    });
+}
+
+void
+TxSignaturePrechecker::verifySignatures(Application& app,
+                                        TransactionFrame const& tx)
+{
+    std::vector<AccountID> accounts;
+    tx.insertSigningAccounts(accounts);
+
+    std::vector<SignerKey> keys;
+    auto& cache = app.getDatabase().getEntryCache();
+    for (auto const& id : accounts)
+    {
+        keys.emplace_back(KeyUtils::convertKey<SignerKey>(id));
+
+        LedgerKey key;
+        key.type(ACCOUNT);
+        key.account().accountID = id;
+        EntryCache::EntryPtr entry;
+        if (cache.get(key, entry) && entry)
+        {
+            for (auto const& s : entry->data.account().signers)
+            {
+                keys.emplace_back(s.key);
+            }
+        }
+    }
+
+    std::vector<PubKeyUtils::VerifySigRequest> checks;
+    tx.insertSignatureChecks(keys, checks);
+    PubKeyUtils::verifySigs(checks);
+}
+
+void
+TxSignaturePrechecker::handOver()
+{
+    while (!mQueue.empty() && mQueue.front()->mDone)
+    {
+        auto p = mQueue.front();
+        mQueue.pop_front();
+        mQueueDepth.dec();
+        if (p->mVerifyTime != std::chrono::nanoseconds::zero())
+        {
+            mVerifyTimer.Update(p->mVerifyTime);
+        }
+        mLatencyTimer.Update(std::chrono::steady_clock::now() - p->mQueued);
+        p->mHandler(p->mTx);
+    }
+}
+}
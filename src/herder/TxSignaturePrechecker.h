@@ -0,0 +1,83 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "transactions/TransactionFrame.h"
+#include "util/NonCopyable.h"
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+
+namespace medida
+{
+class Counter;
+class Meter;
+class Timer;
+}
+
+namespace stellar
+{
+class Application;
+
+/**
+ * Checks the Ed25519 signatures of transactions received from the network on
+ * the worker threads before they are handed to the herder.
+ *
+ * A signature is checked against the master key and the signers of every
+ * account the transaction needs signatures from, as far as those accounts are
+ * in the entry cache (workers can't read the database). The results land in
+ * the process-wide verify-sig cache, so that the herder's checkValid, run on
+ * the main thread once the checks are done, finds them there instead of doing
+ * the crypto itself; checkValid still decides what is valid.
+ *
+ * Transactions are handed over in the order they were received, as the
+ * herder rejects those that arrive ahead of a predecessor from the same
+ * account. When more than MAX_QUEUED transactions are waiting, new ones
+ * skip the checks (but still wait their turn).
+ *
+ * Only used from the main thread.
+ */
+class TxSignaturePrechecker : NonMovableOrCopyable
+{
+  public:
+    static size_t const MAX_QUEUED;
+
+    typedef std::function<void(TransactionFramePtr)> Handler;
+
+    explicit TxSignaturePrechecker(Application& app);
+
+    void precheck(TransactionFramePtr tx, Handler handler);
+
+    size_t
+    getQueueDepth() const
+    {
+        return mQueue.size();
+    }
+
+  private:
+    struct Pending
+    {
+        TransactionFramePtr mTx;
+        Handler mHandler;
+        std::chrono::steady_clock::time_point mQueued;
+        std::chrono::nanoseconds mVerifyTime;
+        bool mDone;
+    };
+
+    Application& mApp;
+    std::deque<std::shared_ptr<Pending>> mQueue;
+
+    medida::Counter& mQueueDepth;
+    medida::Timer& mVerifyTimer;
+    medida::Timer& mLatencyTimer;
+    medida::Meter& mSkipped;
+
+    // Runs on a worker thread.
+    static void verifySignatures(Application& app, TransactionFrame const& tx);
+
+    void handOver();
+};
+}
@@ -5,6 +5,7 @@
 #include "bucket/BucketList.h"
 #include "bucket/BucketManager.h"
 #include "crypto/Hex.h"
+#include "crypto/SHA.h"
 #include "herder/LedgerCloseData.h"
 #include "history/HistoryArchive.h"
 #include "history/HistoryManager.h"
@@ -19,6 +20,7 @@
 #include "test/TxTests.h"
 #include "test/test.h"
 #include "util/Fs.h"
+#include "util/Gzip.h"
 #include "util/Logging.h"
 #include "util/NonCopyable.h"
 #include "util/Timer.h"
@@ -226,6 +228,55 @@ TEST_CASE_METHOD(HistoryTests, "HistoryManager::compress", "[history]")
     REQUIRE(!fs::exists(compressed));
 }
 
+#ifdef USE_ZLIB
+TEST_CASE_METHOD(HistoryTests, "gunzipFile inflates and hashes in one pass",
+                 "[history]")
+{
+    std::string s;
+    for (int i = 0; i < 100000; ++i)
+    {
+        s += std::to_string(i);
+    }
+    HistoryManager& hm = app.getHistoryManager();
+    std::string fname = hm.localFilename("inflateme");
+    {
+        std::ofstream out(fname, std::ofstream::binary);
+        out.write(s.data(), s.size());
+    }
+    std::string compressed = fname + ".gz";
+    auto& wm = app.getWorkManager();
+    auto g = wm.addWork<GzipFileWork>(fname);
+    wm.advanceChildren();
+    crankTillDone();
+    REQUIRE(g->getState() == Work::WORK_SUCCESS);
+
+    auto hasher = SHA256::create();
+    gunzipFile(compressed, fname,
+               [&hasher](ByteSlice const& b) { hasher->add(b); });
+    REQUIRE(hasher->finish() == sha256(s));
+    {
+        std::ifstream in(fname, std::ifstream::binary);
+        std::string inflated((std::istreambuf_iterator<char>(in)),
+                             std::istreambuf_iterator<char>());
+        REQUIRE(inflated == s);
+    }
+
+    // A truncated stream is an error, and leaves no output behind.
+    std::string truncated = hm.localFilename("truncated.gz");
+    {
+        std::ifstream in(compressed, std::ifstream::binary);
+        std::string gz((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+        std::ofstream out(truncated, std::ofstream::binary);
+        out.write(gz.data(), gz.size() / 2);
+    }
+    std::string out = hm.localFilename("truncated");
+    REQUIRE_THROWS_AS(gunzipFile(truncated, out, [](ByteSlice const&) {}),
+                      std::runtime_error);
+    REQUIRE(!fs::exists(out));
+}
+#endif
+
 TEST_CASE_METHOD(HistoryTests, "HistoryArchiveState::get_put", "[history]")
 {
     HistoryArchiveState has;
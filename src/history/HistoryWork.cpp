@@ -14,9 +14,12 @@
 #include "history/StateSnapshot.h"
 #include "ledger/LedgerHeaderFrame.h"
 #include "ledger/LedgerManager.h"
+#include "ledger/OrderBook.h"
 #include "main/Config.h"
 #include "process/ProcessManager.h"
+#include "util/Gzip.h"
 #include "util/Logging.h"
+#include "util/XDRStream.h"
 #include "util/make_unique.h"
 #include "xdr/Stellar-ledger.h"
 #include "xdrpp/printer.h"
@@ -24,6 +27,7 @@
 #include "lib/util/format.h"
 
 #include <fstream>
+#include <thread>
 
 namespace stellar
 {
@@ -251,6 +255,35 @@ VerifyBucketWork::VerifyBucketWork(
     checkNoGzipSuffix(mBucketFile);
 }
 
+#ifdef USE_ZLIB
+// Downloaded buckets are left compressed, and inflated and hashed in one pass.
+static bool const kInflateBucketsInProcess = true;
+#else
+static bool const kInflateBucketsInProcess = false;
+#endif
+
+// Hashes the downloaded bucket `filename`, first inflating it from
+// `filename`.gz if kInflateBucketsInProcess. Throws std::runtime_error if the
+// file can't be inflated.
+static uint256
+hashDownloadedBucket(std::string const& filename)
+{
+    auto hasher = SHA256::create();
+#ifdef USE_ZLIB
+    gunzipFile(filename + ".gz", filename,
+               [&hasher](ByteSlice const& b) { hasher->add(b); });
+#else
+    char buf[4096];
+    std::ifstream in(filename, std::ifstream::binary);
+    while (in)
+    {
+        in.read(buf, sizeof(buf));
+        hasher->add(ByteSlice(buf, in.gcount()));
+    }
+#endif
+    return hasher->finish();
+}
+
 void
 VerifyBucketWork::onStart()
 {
@@ -259,23 +292,16 @@ VerifyBucketWork::onStart()
     Application& app = this->mApp;
     auto handler = callComplete();
     app.getWorkerIOService().post([&app, filename, handler, hash]() {
-        auto hasher = SHA256::create();
         asio::error_code ec;
-        char buf[4096];
+        std::string filenameGz = filename + ".gz";
+        try
         {
-            // ensure that the stream gets its own scope to avoid race with
-            // main thread
-            std::ifstream in(filename, std::ifstream::binary);
-            while (in)
-            {
-                in.read(buf, sizeof(buf));
-                hasher->add(ByteSlice(buf, in.gcount()));
-            }
-            uint256 vHash = hasher->finish();
+            uint256 vHash = hashDownloadedBucket(filename);
             if (vHash == hash)
             {
                 CLOG(DEBUG, "History") << "Verified hash (" << hexAbbrev(hash)
                                        << ") for " << filename;
+                std::remove(filenameGz.c_str());
             }
             else
             {
@@ -284,9 +310,16 @@ VerifyBucketWork::onStart()
                 CLOG(WARNING, "History") << "expected hash: " << binToHex(hash);
                 CLOG(WARNING, "History") << "computed hash: "
                                          << binToHex(vHash);
+                std::remove(filename.c_str());
                 ec = std::make_error_code(std::errc::io_error);
             }
         }
+        catch (std::runtime_error& e)
+        {
+            CLOG(WARNING, "History") << "FAILED inflating " << filenameGz
+                                     << ": " << e.what();
+            ec = std::make_error_code(std::errc::io_error);
+        }
         app.getClock().getIOService().post([ec, handler]() { handler(ec); });
     });
 }
@@ -305,6 +338,62 @@ VerifyBucketWork::onSuccess()
     return WORK_SUCCESS;
 }
 
+ExpandBucketWork::ExpandBucketWork(Application& app, WorkParent& parent,
+                                   std::shared_ptr<Bucket const> bucket,
+                                   std::string const& outFile)
+    : Work(app, parent, std::string("expand-bucket ") + outFile)
+    , mBucket(bucket)
+    , mOutFile(outFile)
+{
+    checkNoGzipSuffix(mOutFile);
+}
+
+void
+ExpandBucketWork::onReset()
+{
+    std::remove(mOutFile.c_str());
+}
+
+void
+ExpandBucketWork::onStart()
+{
+    auto bucket = mBucket;
+    std::string outFile = mOutFile;
+    Application& app = this->mApp;
+    auto handler = callComplete();
+    app.getWorkerIOService().post([&app, bucket, outFile, handler]() {
+        asio::error_code ec;
+        try
+        {
+            XDRInputFileStream in;
+            XDROutputFileStream out;
+            in.open(bucket->getFilename());
+            out.open(outFile);
+            char const* rec;
+            size_t len;
+            while (in.readRecord(rec, len))
+            {
+                out.writeRecord(rec, len);
+            }
+            out.close();
+        }
+        catch (std::runtime_error& e)
+        {
+            CLOG(WARNING, "History") << "FAILED expanding bucket "
+                                     << bucket->getFilename() << ": "
+                                     << e.what();
+            ec = std::make_error_code(std::errc::io_error);
+        }
+        app.getClock().getIOService().post([ec, handler]() { handler(ec); });
+    });
+}
+
+void
+ExpandBucketWork::onRun()
+{
+    // Do nothing: we spawned the expansion in onStart().
+}
+
 VerifyLedgerChainWork::VerifyLedgerChainWork(
     Application& app, WorkParent& parent, TmpDir const& downloadDir,
     uint32_t first, uint32_t last, bool manualCatchup,
@@ -749,6 +838,7 @@ ApplyBucketsWork::ApplyBucketsWork(
     , mApplyState(applyState)
     , mFirstVerified(firstVerified)
     , mApplying(false)
+    , mApplyingInParallel(false)
     , mLevel(BucketList::kNumLevels - 1)
 {
     // Consistency check: LCL should be in the _past_ from firstVerified,
@@ -798,11 +888,22 @@ ApplyBucketsWork::getBucket(std::string const& hash)
     return b;
 }
 
+bool
+ApplyBucketsWork::canApplyInParallel()
+{
+    // Each entry type is applied on its own pooled session; the pool has one
+    // session per hardware thread. SQLite would serialize the writers anyway.
+    auto& db = mApp.getDatabase();
+    return db.canUsePool() && !db.isSqlite() &&
+           std::thread::hardware_concurrency() >= 4;
+}
+
 void
 ApplyBucketsWork::onReset()
 {
     mLevel = BucketList::kNumLevels - 1;
     mApplying = false;
+    mApplyingInParallel = false;
     mSnapBucket.reset();
     mCurrBucket.reset();
     mSnapApplicator.reset();
@@ -814,11 +915,11 @@ ApplyBucketsWork::onStart()
 {
     auto& level = getBucketLevel(mLevel);
     HistoryStateBucket& i = mApplyState.currentBuckets.at(mLevel);
+    std::vector<std::shared_ptr<const Bucket>> toApply;
     if (mApplying || i.snap != binToHex(level.getSnap()->getHash()))
     {
         mSnapBucket = getBucket(i.snap);
-        mSnapApplicator =
-            make_unique<BucketApplicator>(mApp.getDatabase(), mSnapBucket);
+        toApply.emplace_back(mSnapBucket);
         CLOG(DEBUG, "History") << "ApplyBuckets : starting level[" << mLevel
                                << "].snap = " << i.snap;
         mApplying = true;
@@ -826,17 +927,57 @@ ApplyBucketsWork::onStart()
     if (mApplying || i.curr != binToHex(level.getCurr()->getHash()))
     {
         mCurrBucket = getBucket(i.curr);
-        mCurrApplicator =
-            make_unique<BucketApplicator>(mApp.getDatabase(), mCurrBucket);
+        toApply.emplace_back(mCurrBucket);
         CLOG(DEBUG, "History") << "ApplyBuckets : starting level[" << mLevel
                                << "].curr = " << i.curr;
         mApplying = true;
     }
+
+    mApplyingInParallel = !toApply.empty() && canApplyInParallel();
+    if (!mApplyingInParallel)
+    {
+        if (mSnapBucket)
+        {
+            mSnapApplicator =
+                make_unique<BucketApplicator>(mApp.getDatabase(), mSnapBucket);
+        }
+        if (mCurrBucket)
+        {
+            mCurrApplicator =
+                make_unique<BucketApplicator>(mApp.getDatabase(), mCurrBucket);
+        }
+        return;
+    }
+
+    // The pool must be created on the main thread.
+    auto& pool = mApp.getDatabase().getPool();
+    bool inlineSigners = mApp.getDatabase().hasInlineAccountSigners();
+    auto handler = callComplete();
+    auto& app = mApp;
+    mApp.getWorkerIOService().post([&app, &pool, toApply, inlineSigners,
+                                    handler]() {
+        asio::error_code ec;
+        try
+        {
+            BucketApplicator::applyInParallel(pool, toApply, inlineSigners);
+        }
+        catch (std::exception const& e)
+        {
+            CLOG(WARNING, "History") << "ApplyBuckets : failed: " << e.what();
+            ec = std::make_error_code(std::errc::io_error);
+        }
+        app.getClock().getIOService().post([ec, handler]() { handler(ec); });
+    });
 }
 
 void
 ApplyBucketsWork::onRun()
 {
+    if (mApplyingInParallel)
+    {
+        // Do nothing: we spawned the appliers in onStart().
+        return;
+    }
     if (mSnapApplicator && *mSnapApplicator)
     {
         mSnapApplicator->advance();
@@ -857,6 +998,14 @@ ApplyBucketsWork::onSuccess()
         return WORK_RUNNING;
     }
 
+    if (mApplyingInParallel)
+    {
+        // The parallel appliers bypass the entry cache and the order book.
+        mApp.getDatabase().getEntryCache().clear();
+        mApp.getDatabase().getOrderBook().clear();
+        mApplyingInParallel = false;
+    }
+
     auto& level = getBucketLevel(mLevel);
     if (mSnapBucket)
     {
@@ -1055,6 +1204,10 @@ ApplyLedgerChainWork::applyHistoryOfSingleLedger()
                                  "hash in replay ledger");
     }
 
+    // Verify the set's signatures in bulk, across the worker threads,
+    // rather than one by one as its transactions are applied.
+    txset->verifySignatures(mApp);
+
     LedgerCloseData closeData(header.ledgerSeq, txset, header.scpValue);
     lm.closeLedger(closeData);
 
@@ -1111,12 +1264,14 @@ ApplyLedgerChainWork::onSuccess()
 
 GetAndUnzipRemoteFileWork::GetAndUnzipRemoteFileWork(
     Application& app, WorkParent& parent, FileTransferInfo ft,
-    std::shared_ptr<HistoryArchive const> archive, size_t maxRetries)
+    std::shared_ptr<HistoryArchive const> archive, size_t maxRetries,
+    bool unzip)
     : Work(app, parent,
            std::string("get-and-unzip-remote-file ") + ft.remoteName(),
            maxRetries)
     , mFt(std::move(ft))
     , mArchive(archive)
+    , mUnzip(unzip)
 {
 }
 
@@ -1202,6 +1357,11 @@ GetAndUnzipRemoteFileWork::onSuccess()
         return WORK_FAILURE_RETRY;
     }
 
+    if (!mUnzip)
+    {
+        return WORK_SUCCESS;
+    }
+
     CLOG(DEBUG, "History") << "Downloading and unzipping " << mFt.remoteName()
                            << ": unzipping";
     mGunzipFileWork = addWork<GunzipFileWork>(mFt.localPath_gz(), false, 1);
@@ -1389,11 +1549,12 @@ CatchupMinimalWork::onSuccess()
         for (auto const& hash : buckets)
         {
             FileTransferInfo ft(*mDownloadDir, HISTORY_FILE_TYPE_BUCKET, hash);
-            // Each bucket gets its own work-chain of download->gunzip->verify
+            // Each bucket gets its own work-chain of download->inflate+verify
 
             auto verify = mDownloadBucketsWork->addWork<VerifyBucketWork>(
                 mBuckets, ft.localPath_nogz(), hexToBin256(hash));
-            verify->addWork<GetAndUnzipRemoteFileWork>(ft);
+            verify->addWork<GetAndUnzipRemoteFileWork>(
+                ft, nullptr, Work::RETRY_A_FEW, !kInflateBucketsInProcess);
         }
         return WORK_PENDING;
     }
@@ -1677,7 +1838,21 @@ PutSnapshotFilesWork::onSuccess()
         {
             auto b = mApp.getBucketManager().getBucketByHash(hexToBin256(hash));
             assert(b);
-            files.push_back(std::make_shared<FileTransferInfo>(*b));
+            if (!XDRBlockFormat::isBlockCompressed(b->getFilename()))
+            {
+                files.push_back(std::make_shared<FileTransferInfo>(*b));
+                continue;
+            }
+            // Archives hold plain XDR: expand the bucket into the snapshot
+            // directory, and publish that.
+            FileTransferInfo ft(mSnapshot->mSnapDir, HISTORY_FILE_TYPE_BUCKET,
+                                hash);
+            auto put = mPutFilesWork->addWork<PutRemoteFileWork>(
+                ft.localPath_gz(), ft.remoteName(), mArchive);
+            auto mkdir =
+                put->addWork<MakeRemoteDirWork>(ft.remoteDir(), mArchive);
+            auto gzip = mkdir->addWork<GzipFileWork>(ft.localPath_nogz());
+            gzip->addWork<ExpandBucketWork>(b, ft.localPath_nogz());
         }
         for (auto f : files)
         {
@@ -1816,10 +1991,11 @@ RepairMissingBucketsWork::onReset()
     for (auto const& hash : bucketsToFetch)
     {
         FileTransferInfo ft(*mDownloadDir, HISTORY_FILE_TYPE_BUCKET, hash);
-        // Each bucket gets its own work-chain of download->gunzip->verify
+        // Each bucket gets its own work-chain of download->inflate+verify
         auto verify = addWork<VerifyBucketWork>(mBuckets, ft.localPath_nogz(),
                                                 hexToBin256(hash));
-        verify->addWork<GetAndUnzipRemoteFileWork>(ft);
+        verify->addWork<GetAndUnzipRemoteFileWork>(
+            ft, nullptr, Work::RETRY_A_FEW, !kInflateBucketsInProcess);
     }
 }
 
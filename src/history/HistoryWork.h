@@ -110,6 +110,10 @@ class GunzipFileWork : public RunCommandWork
     void onReset() override;
 };
 
+// Hashes `bucketFile`, as left by a GetAndUnzipRemoteFileWork child, and
+// adopts it as a bucket if the hash matches. When built with zlib, the child
+// is created with unzip=false and `bucketFile`.gz is inflated and hashed here
+// in one pass.
 class VerifyBucketWork : public Work
 {
     std::map<std::string, std::shared_ptr<Bucket>>& mBuckets;
@@ -125,6 +129,22 @@ class VerifyBucketWork : public Work
     Work::State onSuccess() override;
 };
 
+// Writes the plain XDR of a block-compressed bucket to `outFile`, on a worker
+// thread, so that it can be gzipped and published like any other bucket.
+class ExpandBucketWork : public Work
+{
+    std::shared_ptr<Bucket const> mBucket;
+    std::string mOutFile;
+
+  public:
+    ExpandBucketWork(Application& app, WorkParent& parent,
+                     std::shared_ptr<Bucket const> bucket,
+                     std::string const& outFile);
+    void onReset() override;
+    void onStart() override;
+    void onRun() override;
+};
+
 class ApplyBucketsWork : public Work
 {
     std::map<std::string, std::shared_ptr<Bucket>>& mBuckets;
@@ -132,6 +152,7 @@ class ApplyBucketsWork : public Work
     LedgerHeaderHistoryEntry const& mFirstVerified;
 
     bool mApplying;
+    bool mApplyingInParallel;
     size_t mLevel;
     std::shared_ptr<Bucket> mSnapBucket;
     std::shared_ptr<Bucket> mCurrBucket;
@@ -141,6 +162,7 @@ class ApplyBucketsWork : public Work
     std::shared_ptr<Bucket> getBucket(std::string const& bucketHash);
     BucketLevel& getBucketLevel(size_t level);
     BucketList& getBucketList();
+    bool canApplyInParallel();
 
   public:
     ApplyBucketsWork(Application& app, WorkParent& parent,
@@ -198,15 +220,17 @@ class GetAndUnzipRemoteFileWork : public Work
 
     FileTransferInfo mFt;
     std::shared_ptr<HistoryArchive const> mArchive;
+    bool mUnzip;
 
   public:
     // Passing `nullptr` for the archive argument will cause the work to
     // select a new readable history archive at random each time it runs /
-    // retries.
+    // retries. Passing `false` for `unzip` leaves the downloaded file
+    // compressed, at ft.localPath_gz(), for a parent that inflates it itself.
     GetAndUnzipRemoteFileWork(
         Application& app, WorkParent& parent, FileTransferInfo ft,
         std::shared_ptr<HistoryArchive const> archive = nullptr,
-        size_t maxRetries = Work::RETRY_A_FEW);
+        size_t maxRetries = Work::RETRY_A_FEW, bool unzip = true);
     std::string getStatus() const override;
     void onReset() override;
     Work::State onSuccess() override;
@@ -10,9 +10,11 @@
 #include "crypto/SignerKey.h"
 #include "database/Database.h"
 #include "ledger/LedgerManager.h"
+#include "ledger/LedgerStateBuffer.h"
 #include "lib/util/format.h"
 #include "util/basen.h"
 #include "util/types.h"
+#include "xdrpp/marshal.h"
 #include <algorithm>
 
 using namespace soci;
@@ -52,6 +54,35 @@ const char* AccountFrame::kSQLCreateStatement4 = "CREATE INDEX accountbalances "
                                                  "ON accounts (balance) WHERE "
                                                  "balance >= 1000000000";
 
+namespace
+{
+// Signers are stored either inline, serialized in the signers column of the
+// accounts table, or in the signers table, as set by INLINE_ACCOUNT_SIGNERS
+// (see Database::upgradeToCurrentSchema). The column is NULL on rows whose
+// signers are in the signers table, and empty for inline accounts without
+// signers, so that readers can tell from the row alone.
+typedef decltype(AccountEntry::signers) Signers;
+
+std::string
+signersToStr(Signers const& signers)
+{
+    return signers.empty() ? std::string()
+                           : bn::encode_b64(xdr::xdr_to_opaque(signers));
+}
+
+void
+signersFromStr(std::string const& str, Signers& signers)
+{
+    signers.clear();
+    if (!str.empty())
+    {
+        std::vector<uint8_t> raw;
+        bn::decode_b64(str, raw);
+        xdr::xdr_from_opaque(raw, signers);
+    }
+}
+}
+
 AccountFrame::AccountFrame()
     : EntryFrame(ACCOUNT), mAccountEntry(mEntry.data.account())
 {
@@ -215,17 +246,17 @@ AccountFrame::loadAccount(AccountID const& accountID, Database& db)
     LedgerKey key;
     key.type(ACCOUNT);
     key.account().accountID = accountID;
-    if (cachedEntryExists(key, db))
+    std::shared_ptr<LedgerEntry const> p;
+    if (getPendingEntry(key, p, db) || getCachedEntry(key, p, db))
     {
-        auto p = getCachedEntry(key, db);
         return p ? std::make_shared<AccountFrame>(*p) : nullptr;
     }
 
     std::string actIDStrKey = KeyUtils::toStrKey(accountID);
 
     std::string publicKey, inflationDest, creditAuthKey;
-    std::string homeDomain, thresholds;
-    soci::indicator inflationDestInd;
+    std::string homeDomain, thresholds, signers;
+    soci::indicator inflationDestInd, signersInd;
 
     AccountFrame::pointer res = make_shared<AccountFrame>(accountID);
     AccountEntry& account = res->getAccount();
@@ -233,7 +264,7 @@ AccountFrame::loadAccount(AccountID const& accountID, Database& db)
     auto prep =
         db.getPreparedStatement("SELECT balance, seqnum, numsubentries, "
                                 "inflationdest, homedomain, thresholds, "
-                                "flags, lastmodified "
+                                "flags, lastmodified, signers "
                                 "FROM accounts WHERE accountid=:v1");
     auto& st = prep.statement();
     st.exchange(into(account.balance));
@@ -244,6 +275,7 @@ AccountFrame::loadAccount(AccountID const& accountID, Database& db)
     st.exchange(into(thresholds));
     st.exchange(into(account.flags));
     st.exchange(into(res->getLastModified()));
+    st.exchange(into(signers, signersInd));
     st.exchange(use(actIDStrKey));
     st.define_and_bind();
     {
@@ -270,11 +302,15 @@ AccountFrame::loadAccount(AccountID const& accountID, Database& db)
 
     account.signers.clear();
 
-    if (account.numSubEntries != 0)
+    if (signersInd == soci::i_ok)
+    {
+        signersFromStr(signers, account.signers);
+    }
+    else if (account.numSubEntries != 0)
     {
-        auto signers = loadSigners(db, actIDStrKey);
-        account.signers.insert(account.signers.begin(), signers.begin(),
-                               signers.end());
+        auto tableSigners = loadSigners(db, actIDStrKey);
+        account.signers.insert(account.signers.begin(), tableSigners.begin(),
+                               tableSigners.end());
     }
 
     res->normalize();
@@ -315,10 +351,150 @@ AccountFrame::loadSigners(Database& db, std::string const& actIDStrKey)
     return res;
 }
 
+void
+AccountFrame::loadAccounts(
+    soci::session& sess, std::vector<AccountID> const& accountIDs,
+    std::function<void(LedgerEntry const&)> accountProcessor)
+{
+    if (accountIDs.empty())
+    {
+        return;
+    }
+    std::vector<std::string> actIDStrKeys;
+    for (auto const& id : accountIDs)
+    {
+        actIDStrKeys.emplace_back(KeyUtils::toStrKey(id));
+    }
+    auto inList = Database::inListPlaceholders(actIDStrKeys.size());
+
+    std::string actIDStrKey, inflationDest, homeDomain, thresholds, signers;
+    soci::indicator inflationDestInd, signersInd;
+
+    LedgerEntry le;
+    le.data.type(ACCOUNT);
+    AccountEntry& account = le.data.account();
+
+    // Accounts whose signers are in the signers table, held back until
+    // those are loaded (as in loadAccount, only accounts with subentries
+    // can have some).
+    std::vector<LedgerEntry> tableSigners;
+
+    auto prep = Database::prepareStatement(
+        sess, "SELECT accountid, balance, seqnum, numsubentries, "
+              "inflationdest, homedomain, thresholds, flags, lastmodified, "
+              "signers FROM accounts WHERE accountid IN " +
+                  inList);
+    auto& st = prep.statement();
+    st.exchange(into(actIDStrKey));
+    st.exchange(into(account.balance));
+    st.exchange(into(account.seqNum));
+    st.exchange(into(account.numSubEntries));
+    st.exchange(into(inflationDest, inflationDestInd));
+    st.exchange(into(homeDomain));
+    st.exchange(into(thresholds));
+    st.exchange(into(account.flags));
+    st.exchange(into(le.lastModifiedLedgerSeq));
+    st.exchange(into(signers, signersInd));
+    for (auto const& k : actIDStrKeys)
+    {
+        st.exchange(use(k));
+    }
+    st.define_and_bind();
+    st.execute(true);
+    while (st.got_data())
+    {
+        account.accountID = KeyUtils::fromStrKey<PublicKey>(actIDStrKey);
+        account.homeDomain = homeDomain;
+        bn::decode_b64(thresholds.begin(), thresholds.end(),
+                       account.thresholds.begin());
+        if (inflationDestInd == soci::i_ok)
+        {
+            account.inflationDest.activate() =
+                KeyUtils::fromStrKey<PublicKey>(inflationDest);
+        }
+        else
+        {
+            account.inflationDest.reset();
+        }
+
+        account.signers.clear();
+        if (signersInd == soci::i_ok)
+        {
+            signersFromStr(signers, account.signers);
+            accountProcessor(le);
+        }
+        else if (account.numSubEntries != 0)
+        {
+            tableSigners.emplace_back(le);
+        }
+        else
+        {
+            accountProcessor(le);
+        }
+        st.fetch();
+    }
+
+    if (tableSigners.empty())
+    {
+        return;
+    }
+
+    std::unordered_map<AccountID, std::vector<Signer>> loaded;
+    {
+        actIDStrKeys.clear();
+        for (auto const& e : tableSigners)
+        {
+            actIDStrKeys.emplace_back(
+                KeyUtils::toStrKey(e.data.account().accountID));
+        }
+        std::string pubKey;
+        Signer signer;
+        auto prep2 = Database::prepareStatement(
+            sess, "SELECT accountid, publickey, weight FROM signers "
+                  "WHERE accountid IN " +
+                      Database::inListPlaceholders(actIDStrKeys.size()));
+        auto& st2 = prep2.statement();
+        st2.exchange(into(actIDStrKey));
+        st2.exchange(into(pubKey));
+        st2.exchange(into(signer.weight));
+        for (auto const& k : actIDStrKeys)
+        {
+            st2.exchange(use(k));
+        }
+        st2.define_and_bind();
+        st2.execute(true);
+        while (st2.got_data())
+        {
+            signer.key = KeyUtils::fromStrKey<SignerKey>(pubKey);
+            loaded[KeyUtils::fromStrKey<PublicKey>(actIDStrKey)].push_back(
+                signer);
+            st2.fetch();
+        }
+    }
+    for (auto& e : tableSigners)
+    {
+        auto& a = e.data.account();
+        auto it = loaded.find(a.accountID);
+        if (it != loaded.end())
+        {
+            a.signers.insert(a.signers.begin(), it->second.begin(),
+                             it->second.end());
+            std::sort(a.signers.begin(), a.signers.end(),
+                      &AccountFrame::signerCompare);
+        }
+        accountProcessor(e);
+    }
+}
+
 bool
 AccountFrame::exists(Database& db, LedgerKey const& key)
 {
-    if (cachedEntryExists(key, db) && getCachedEntry(key, db) != nullptr)
+    std::shared_ptr<LedgerEntry const> p;
+    if (getPendingEntry(key, p, db))
+    {
+        return p != nullptr;
+    }
+    if (getCachedEntry(key, p, db) && p)
     {
         return true;
     }
@@ -359,6 +535,12 @@ AccountFrame::storeDelete(LedgerDelta& delta, Database& db,
 {
     flushCachedEntry(key, db);
 
+    if (storePendingDelete(key, db))
+    {
+        delta.deleteEntry(key);
+        return;
+    }
+
     std::string actIDStrKey = KeyUtils::toStrKey(key.account().accountID);
     {
         auto timer = db.getDeleteTimer("account");
@@ -369,6 +551,7 @@ AccountFrame::storeDelete(LedgerDelta& delta, Database& db,
         st.define_and_bind();
         st.execute(true);
     }
+    if (!db.hasInlineAccountSigners())
     {
         auto timer = db.getDeleteTimer("signer");
         auto prep =
@@ -390,6 +573,20 @@ AccountFrame::storeUpdate(LedgerDelta& delta, Database& db, bool insert)
 
     flushCachedEntry(db);
 
+    if (storePending(db))
+    {
+        // the signers get written along with the account on flush
+        if (insert)
+        {
+            delta.addEntry(*this);
+        }
+        else
+        {
+            delta.modEntry(*this);
+        }
+        return;
+    }
+
     std::string actIDStrKey = KeyUtils::toStrKey(mAccountEntry.accountID);
     std::string sql;
 
@@ -398,8 +595,8 @@ AccountFrame::storeUpdate(LedgerDelta& delta, Database& db, bool insert)
         sql = std::string(
             "INSERT INTO accounts ( accountid, balance, seqnum, "
             "numsubentries, inflationdest, homedomain, thresholds, flags, "
-            "lastmodified ) "
-            "VALUES ( :id, :v1, :v2, :v3, :v4, :v5, :v6, :v7, :v8 )");
+            "lastmodified, signers ) "
+            "VALUES ( :id, :v1, :v2, :v3, :v4, :v5, :v6, :v7, :v8, :v9 )");
     }
     else
     {
@@ -407,7 +604,19 @@ AccountFrame::storeUpdate(LedgerDelta& delta, Database& db, bool insert)
             "UPDATE accounts SET balance = :v1, seqnum = :v2, "
             "numsubentries = :v3, "
             "inflationdest = :v4, homedomain = :v5, thresholds = :v6, "
-            "flags = :v7, lastmodified = :v8 WHERE accountid = :id");
+            "flags = :v7, lastmodified = :v8, signers = :v9 "
+            "WHERE accountid = :id");
+    }
+
+    // Inline signers are written along with the rest of the account, in the
+    // same statement.
+    bool inlineSigners = db.hasInlineAccountSigners();
+    std::string signers;
+    soci::indicator signersInd = soci::i_null;
+    if (inlineSigners)
+    {
+        signers = signersToStr(mAccountEntry.signers);
+        signersInd = soci::i_ok;
     }
 
     auto prep = db.getPreparedStatement(sql);
@@ -435,6 +644,7 @@ AccountFrame::storeUpdate(LedgerDelta& delta, Database& db, bool insert)
         st.exchange(use(thresholds, "v6"));
         st.exchange(use(mAccountEntry.flags, "v7"));
         st.exchange(use(getLastModified(), "v8"));
+        st.exchange(use(signers, signersInd, "v9"));
         st.define_and_bind();
         {
             auto timer = insert ? db.getInsertTimer("account")
@@ -456,7 +666,7 @@ AccountFrame::storeUpdate(LedgerDelta& delta, Database& db, bool insert)
         }
     }
 
-    if (mUpdateSigners)
+    if (mUpdateSigners && !inlineSigners)
     {
         applySigners(db, insert);
     }
@@ -581,6 +791,208 @@ AccountFrame::applySigners(Database& db, bool insert)
     }
 }
 
+void
+AccountFrame::storeAddBulk(soci::session& sess,
+                           std::vector<LedgerEntry> const& entries,
+                           bool inlineSigners)
+{
+    size_t n = entries.size();
+    if (n == 0)
+    {
+        return;
+    }
+    std::vector<std::string> actIDStrKeys(n), inflationDestStrKeys(n),
+        homeDomains(n), thresholds(n), signers(n);
+    std::vector<soci::indicator> inflationInds(n, soci::i_null);
+    std::vector<soci::indicator> signersInds(
+        n, inlineSigners ? soci::i_ok : soci::i_null);
+    std::vector<size_t> signerAccounts;
+    std::vector<std::string> signerStrKeys;
+    std::vector<uint32_t> signerWeights;
+    for (size_t i = 0; i < n; ++i)
+    {
+        auto const& account = entries[i].data.account();
+        actIDStrKeys[i] = KeyUtils::toStrKey(account.accountID);
+        if (account.inflationDest)
+        {
+            inflationDestStrKeys[i] =
+                KeyUtils::toStrKey(*account.inflationDest);
+            inflationInds[i] = soci::i_ok;
+        }
+        homeDomains[i] = account.homeDomain;
+        thresholds[i] = bn::encode_b64(account.thresholds);
+        if (inlineSigners)
+        {
+            signers[i] = signersToStr(account.signers);
+            continue;
+        }
+        for (auto const& s : account.signers)
+        {
+            signerAccounts.push_back(i);
+            signerStrKeys.push_back(KeyUtils::toStrKey(s.key));
+            signerWeights.push_back(s.weight);
+        }
+    }
+
+    {
+        Database::executeBatched(
+            sess, n, 10,
+            [](size_t rows) {
+                return "INSERT INTO accounts ( accountid, balance, seqnum, "
+                       "numsubentries, inflationdest, homedomain, "
+                       "thresholds, flags, lastmodified, signers ) VALUES " +
+                       Database::valuesPlaceholders(rows, 10);
+            },
+            [&](soci::statement& st, size_t i) {
+                auto const& account = entries[i].data.account();
+                st.exchange(use(actIDStrKeys[i]));
+                st.exchange(use(account.balance));
+                st.exchange(use(account.seqNum));
+                st.exchange(use(account.numSubEntries));
+                st.exchange(use(inflationDestStrKeys[i], inflationInds[i]));
+                st.exchange(use(homeDomains[i]));
+                st.exchange(use(thresholds[i]));
+                st.exchange(use(account.flags));
+                st.exchange(use(entries[i].lastModifiedLedgerSeq));
+                st.exchange(use(signers[i], signersInds[i]));
+            });
+    }
+    if (!signerStrKeys.empty())
+    {
+        Database::executeBatched(
+            sess, signerStrKeys.size(), 3,
+            [](size_t rows) {
+                return "INSERT INTO signers (accountid,publickey,weight) "
+                       "VALUES " +
+                       Database::valuesPlaceholders(rows, 3);
+            },
+            [&](soci::statement& st, size_t i) {
+                st.exchange(use(actIDStrKeys[signerAccounts[i]]));
+                st.exchange(use(signerStrKeys[i]));
+                st.exchange(use(signerWeights[i]));
+            });
+    }
+}
+
+void
+AccountFrame::storeDeleteBulk(soci::session& sess,
+                              std::vector<LedgerKey> const& keys)
+{
+    if (keys.empty())
+    {
+        return;
+    }
+    std::vector<std::string> actIDStrKeys;
+    for (auto const& key : keys)
+    {
+        actIDStrKeys.emplace_back(KeyUtils::toStrKey(key.account().accountID));
+    }
+    auto bindRow = [&actIDStrKeys](soci::statement& st, size_t i) {
+        st.exchange(use(actIDStrKeys[i]));
+    };
+    {
+        Database::executeBatched(sess, keys.size(), 1,
+                                 [](size_t rows) {
+                                     return "DELETE FROM accounts WHERE "
+                                            "accountid IN " +
+                                            Database::inListPlaceholders(rows);
+                                 },
+                                 bindRow);
+    }
+    {
+        Database::executeBatched(sess, keys.size(), 1,
+                                 [](size_t rows) {
+                                     return "DELETE FROM signers WHERE "
+                                            "accountid IN " +
+                                            Database::inListPlaceholders(rows);
+                                 },
+                                 bindRow);
+    }
+}
+
+void
+AccountFrame::migrateSigners(Database& db, bool toInline)
+{
+    auto& sess = db.getSession();
+    std::string actIDStrKey, signersStr;
+    if (toInline)
+    {
+        std::map<std::string, Signers> signers;
+        {
+            std::string pubKey;
+            Signer signer;
+            soci::statement st =
+                (sess.prepare << "SELECT accountid, publickey, weight "
+                                 "FROM signers",
+                 into(actIDStrKey), into(pubKey), into(signer.weight));
+            st.execute(true);
+            while (st.got_data())
+            {
+                signer.key = KeyUtils::fromStrKey<SignerKey>(pubKey);
+                signers[actIDStrKey].push_back(signer);
+                st.fetch();
+            }
+        }
+
+        sess << "UPDATE accounts SET signers = '' WHERE signers IS NULL";
+        soci::statement st =
+            (sess.prepare << "UPDATE accounts SET signers = :s "
+                             "WHERE accountid = :id",
+             use(signersStr), use(actIDStrKey));
+        for (auto& s : signers)
+        {
+            std::sort(s.second.begin(), s.second.end(),
+                      &AccountFrame::signerCompare);
+            actIDStrKey = s.first;
+            signersStr = signersToStr(s.second);
+            st.execute(true);
+        }
+        sess << "DELETE FROM signers";
+    }
+    else
+    {
+        std::vector<std::string> actIDStrKeys, signerStrKeys;
+        std::vector<uint32_t> weights;
+        {
+            soci::statement st =
+                (sess.prepare << "SELECT accountid, signers FROM accounts "
+                                 "WHERE signers IS NOT NULL AND signers <> ''",
+                 into(actIDStrKey), into(signersStr));
+            st.execute(true);
+            while (st.got_data())
+            {
+                Signers signers;
+                signersFromStr(signersStr, signers);
+                for (auto const& signer : signers)
+                {
+                    actIDStrKeys.emplace_back(actIDStrKey);
+                    signerStrKeys.emplace_back(KeyUtils::toStrKey(signer.key));
+                    weights.emplace_back(signer.weight);
+                }
+                st.fetch();
+            }
+        }
+
+        sess << "DELETE FROM signers";
+        if (!actIDStrKeys.empty())
+        {
+            Database::executeBatched(
+                sess, actIDStrKeys.size(), 3,
+                [](size_t rows) {
+                    return "INSERT INTO signers (accountid,publickey,weight) "
+                           "VALUES " +
+                           Database::valuesPlaceholders(rows, 3);
+                },
+                [&](soci::statement& st, size_t i) {
+                    st.exchange(use(actIDStrKeys[i]));
+                    st.exchange(use(signerStrKeys[i]));
+                    st.exchange(use(weights[i]));
+                });
+        }
+        sess << "UPDATE accounts SET signers = NULL";
+    }
+}
+
 void
 AccountFrame::storeChange(LedgerDelta& delta, Database& db)
 {
@@ -598,6 +1010,13 @@ AccountFrame::processForInflation(
     std::function<bool(AccountFrame::InflationVotes const&)> inflationProcessor,
     int maxWinners, Database& db)
 {
+    // the vote is counted by the database, which needs to see the balances
+    // changed so far in the ledger
+    if (db.getLedgerStateBuffer().isActive())
+    {
+        db.getLedgerStateBuffer().flush(db, ACCOUNT);
+    }
+
     soci::session& session = db.getSession();
 
     InflationVotes v;
@@ -120,12 +120,31 @@ class AccountFrame : public EntryFrame
     static bool exists(Database& db, LedgerKey const& key);
     static uint64_t countObjects(soci::session& sess);
 
+    // bulk helpers for applying buckets: insert `entries`, none of which may
+    // exist yet, with their signers inline or in the signers table, or
+    // delete the entries with the given keys, with multi-row statements
+    static void storeAddBulk(soci::session& sess,
+                             std::vector<LedgerEntry> const& entries,
+                             bool inlineSigners);
+    static void storeDeleteBulk(soci::session& sess,
+                                std::vector<LedgerKey> const& keys);
+
     // database utilities
     static AccountFrame::pointer
     loadAccount(LedgerDelta& delta, AccountID const& accountID, Database& db);
     static AccountFrame::pointer loadAccount(AccountID const& accountID,
                                              Database& db);
 
+    // loads the given accounts, with their signers, through `sess`, which need
+    // not be the main session
+    static void
+    loadAccounts(soci::session& sess, std::vector<AccountID> const& accountIDs,
+                 std::function<void(LedgerEntry const&)> accountProcessor);
+
+    // Moves the signers of all accounts into the signers column of the
+    // accounts table (inline) or out of it into the signers table.
+    static void migrateSigners(Database& db, bool toInline);
+
     // compare signers, ignores weight
     static bool signerCompare(Signer const& s1, Signer const& s2);
 
@@ -78,6 +78,16 @@ DataFrame::loadData(AccountID const& accountID, std::string dataName,
 {
     DataFrame::pointer retData;
 
+    LedgerKey key;
+    key.type(DATA);
+    key.data().accountID = accountID;
+    key.data().dataName = dataName;
+    std::shared_ptr<LedgerEntry const> p;
+    if (getPendingEntry(key, p, db))
+    {
+        return p ? std::make_shared<DataFrame>(*p) : nullptr;
+    }
+
     std::string actIDStrKey = KeyUtils::toStrKey(accountID);
 
     std::string sql = dataColumnSelector;
@@ -153,6 +163,33 @@ DataFrame::loadAccountsData(AccountID const& accountID,
     });
 }
 
+void
+DataFrame::loadData(soci::session& sess,
+                    std::vector<AccountID> const& accountIDs,
+                    std::function<void(LedgerEntry const&)> dataProcessor)
+{
+    if (accountIDs.empty())
+    {
+        return;
+    }
+    std::vector<std::string> actIDStrKeys;
+    for (auto const& id : accountIDs)
+    {
+        actIDStrKeys.emplace_back(KeyUtils::toStrKey(id));
+    }
+
+    std::string sql = dataColumnSelector;
+    sql += " WHERE accountid IN ";
+    sql += Database::inListPlaceholders(actIDStrKeys.size());
+    auto prep = Database::prepareStatement(sess, sql);
+    auto& st = prep.statement();
+    for (auto const& k : actIDStrKeys)
+    {
+        st.exchange(use(k));
+    }
+    loadData(prep, dataProcessor);
+}
+
 std::unordered_map<AccountID, std::vector<DataFrame::pointer>>
 DataFrame::loadAllData(Database& db)
 {
@@ -172,6 +209,12 @@ DataFrame::loadAllData(Database& db)
 bool
 DataFrame::exists(Database& db, LedgerKey const& key)
 {
+    std::shared_ptr<LedgerEntry const> p;
+    if (getPendingEntry(key, p, db))
+    {
+        return p != nullptr;
+    }
+
     std::string actIDStrKey = KeyUtils::toStrKey(key.data().accountID);
     std::string dataName = key.data().dataName;
     int exists = 0;
@@ -205,6 +248,12 @@ DataFrame::storeDelete(LedgerDelta& delta, Database& db) const
 void
 DataFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
 {
+    if (storePendingDelete(key, db))
+    {
+        delta.deleteEntry(key);
+        return;
+    }
+
     std::string actIDStrKey = KeyUtils::toStrKey(key.data().accountID);
     std::string dataName = key.data().dataName;
     auto timer = db.getDeleteTimer("data");
@@ -218,6 +267,67 @@ DataFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
     delta.deleteEntry(key);
 }
 
+void
+DataFrame::storeAddBulk(soci::session& sess,
+                        std::vector<LedgerEntry> const& entries)
+{
+    size_t n = entries.size();
+    if (n == 0)
+    {
+        return;
+    }
+    std::vector<std::string> actIDStrKeys(n), dataNames(n), dataValues(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        auto const& data = entries[i].data.data();
+        actIDStrKeys[i] = KeyUtils::toStrKey(data.accountID);
+        dataNames[i] = data.dataName;
+        dataValues[i] = bn::encode_b64(data.dataValue);
+    }
+
+    Database::executeBatched(
+        sess, n, 4,
+        [](size_t rows) {
+            return "INSERT INTO accountdata "
+                   "(accountid,dataname,datavalue,lastmodified) VALUES " +
+                   Database::valuesPlaceholders(rows, 4);
+        },
+        [&](soci::statement& st, size_t i) {
+            st.exchange(use(actIDStrKeys[i]));
+            st.exchange(use(dataNames[i]));
+            st.exchange(use(dataValues[i]));
+            st.exchange(use(entries[i].lastModifiedLedgerSeq));
+        });
+}
+
+void
+DataFrame::storeDeleteBulk(soci::session& sess,
+                           std::vector<LedgerKey> const& keys)
+{
+    size_t n = keys.size();
+    if (n == 0)
+    {
+        return;
+    }
+    std::vector<std::string> actIDStrKeys(n), dataNames(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        actIDStrKeys[i] = KeyUtils::toStrKey(keys[i].data().accountID);
+        dataNames[i] = keys[i].data().dataName;
+    }
+
+    Database::executeBatched(
+        sess, n, 2,
+        [](size_t rows) {
+            return "DELETE FROM accountdata WHERE " +
+                   Database::anyRowCondition({"accountid", "dataname"}, rows);
+        },
+        [&](soci::statement& st, size_t i) {
+            st.exchange(use(actIDStrKeys[i]));
+            st.exchange(use(dataNames[i]));
+        });
+}
+
 void
 DataFrame::storeChange(LedgerDelta& delta, Database& db)
 {
@@ -235,6 +345,19 @@ DataFrame::storeUpdateHelper(LedgerDelta& delta, Database& db, bool insert)
 {
     touch(delta);
 
+    if (storePending(db))
+    {
+        if (insert)
+        {
+            delta.addEntry(*this);
+        }
+        else
+        {
+            delta.modEntry(*this);
+        }
+        return;
+    }
+
     std::string actIDStrKey = KeyUtils::toStrKey(mData.accountID);
     std::string dataName = mData.dataName;
     std::string dataValue = bn::encode_b64(mData.dataValue);
@@ -70,6 +70,14 @@ class DataFrame : public EntryFrame
     static bool exists(Database& db, LedgerKey const& key);
     static uint64_t countObjects(soci::session& sess);
 
+    // bulk helpers for applying buckets: insert `entries`, none of which may
+    // exist yet, or delete the entries with the given keys, with multi-row
+    // statements
+    static void storeAddBulk(soci::session& sess,
+                             std::vector<LedgerEntry> const& entries);
+    static void storeDeleteBulk(soci::session& sess,
+                                std::vector<LedgerKey> const& keys);
+
     // database utilities
     static pointer loadData(AccountID const& accountID, std::string dataName,
                             Database& db);
@@ -78,6 +86,12 @@ class DataFrame : public EntryFrame
                                  std::vector<DataFrame::pointer>& retData,
                                  Database& db);
 
+    // load the data entries of all the given accounts through `sess`, which
+    // need not be the main session
+    static void
+    loadData(soci::session& sess, std::vector<AccountID> const& accountIDs,
+             std::function<void(LedgerEntry const&)> dataProcessor);
+
     // load all data entries from the database (very slow)
     static std::unordered_map<AccountID, std::vector<DataFrame::pointer>>
     loadAllData(Database& db);
@@ -4,20 +4,28 @@
 
 #include "ledger/EntryFrame.h"
 #include "LedgerManager.h"
-#include "crypto/Hex.h"
+#include "bucket/LedgerCmp.h"
 #include "database/Database.h"
 #include "ledger/AccountFrame.h"
 #include "ledger/DataFrame.h"
 #include "ledger/LedgerDelta.h"
+#include "ledger/LedgerStateBuffer.h"
 #include "ledger/OfferFrame.h"
 #include "ledger/TrustFrame.h"
 #include "xdrpp/marshal.h"
 #include "xdrpp/printer.h"
+#include <algorithm>
+#include <set>
+#include <unordered_set>
 
 namespace stellar
 {
 using xdr::operator==;
 
+// Number of accounts per batched query when prefetching; each query binds
+// one parameter per account.
+static size_t const PREFETCH_BATCH_SIZE = 500;
+
 EntryFrame::pointer
 EntryFrame::FromXDR(LedgerEntry const& from)
 {
@@ -109,30 +117,127 @@ EntryFrame::touch(LedgerDelta const& delta)
 void
 EntryFrame::flushCachedEntry(LedgerKey const& key, Database& db)
 {
-    auto s = binToHex(xdr::xdr_to_opaque(key));
-    db.getEntryCache().erase_if_exists(s);
+    db.getEntryCache().erase(key);
 }
 
 bool
 EntryFrame::cachedEntryExists(LedgerKey const& key, Database& db)
 {
-    auto s = binToHex(xdr::xdr_to_opaque(key));
-    return db.getEntryCache().exists(s);
+    std::shared_ptr<LedgerEntry const> p;
+    return db.getEntryCache().get(key, p);
 }
 
-std::shared_ptr<LedgerEntry const>
-EntryFrame::getCachedEntry(LedgerKey const& key, Database& db)
+bool
+EntryFrame::getCachedEntry(LedgerKey const& key,
+                           std::shared_ptr<LedgerEntry const>& p, Database& db)
 {
-    auto s = binToHex(xdr::xdr_to_opaque(key));
-    return db.getEntryCache().get(s);
+    return db.getEntryCache().get(key, p);
 }
 
 void
 EntryFrame::putCachedEntry(LedgerKey const& key,
                            std::shared_ptr<LedgerEntry const> p, Database& db)
 {
-    auto s = binToHex(xdr::xdr_to_opaque(key));
-    db.getEntryCache().put(s, p);
+    db.getEntryCache().put(key, std::move(p));
+}
+
+bool
+EntryFrame::getPendingEntry(LedgerKey const& key,
+                            std::shared_ptr<LedgerEntry const>& p, Database& db)
+{
+    auto const& buffer = db.getLedgerStateBuffer();
+    return buffer.isActive() && buffer.get(key, p);
+}
+
+bool
+EntryFrame::storePendingDelete(LedgerKey const& key, Database& db)
+{
+    auto& buffer = db.getLedgerStateBuffer();
+    if (!buffer.isActive() || !LedgerStateBuffer::isBuffered(key.type()))
+    {
+        return false;
+    }
+    buffer.put(key, nullptr);
+    return true;
+}
+
+size_t
+EntryFrame::prefetch(std::vector<LedgerKey> const& keys, Database& db)
+{
+    std::vector<AccountID> accounts;
+    std::vector<AccountID> lineOwners;
+    std::unordered_set<AccountID> lineOwnerSet;
+    std::set<LedgerKey, LedgerEntryIdCmp> lines;
+    size_t misses = 0;
+    for (auto const& key : keys)
+    {
+        std::shared_ptr<LedgerEntry const> p;
+        if (getPendingEntry(key, p, db) || getCachedEntry(key, p, db))
+        {
+            continue;
+        }
+        switch (key.type())
+        {
+        case ACCOUNT:
+            accounts.emplace_back(key.account().accountID);
+            ++misses;
+            break;
+        case TRUSTLINE:
+            lines.insert(key);
+            if (lineOwnerSet.insert(key.trustLine().accountID).second)
+            {
+                lineOwners.emplace_back(key.trustLine().accountID);
+            }
+            ++misses;
+            break;
+        default:
+            break;
+        }
+    }
+
+    auto& sess = db.getSession();
+    auto timer = db.getSelectTimer("prefetch");
+    for (size_t i = 0; i < accounts.size(); i += PREFETCH_BATCH_SIZE)
+    {
+        std::vector<AccountID> batch(
+            accounts.begin() + i,
+            accounts.begin() +
+                std::min(accounts.size(), i + PREFETCH_BATCH_SIZE));
+        std::unordered_set<AccountID> found;
+        AccountFrame::loadAccounts(sess, batch, [&](LedgerEntry const& le) {
+            found.insert(le.data.account().accountID);
+            putCachedEntry(LedgerEntryKey(le),
+                           std::make_shared<LedgerEntry const>(le), db);
+        });
+        // remember the accounts that do not exist, as loadAccount would
+        for (auto const& id : batch)
+        {
+            if (found.find(id) == found.end())
+            {
+                LedgerKey key;
+                key.type(ACCOUNT);
+                key.account().accountID = id;
+                putCachedEntry(key, nullptr, db);
+            }
+        }
+    }
+    for (size_t i = 0; i < lineOwners.size(); i += PREFETCH_BATCH_SIZE)
+    {
+        std::vector<AccountID> batch(
+            lineOwners.begin() + i,
+            lineOwners.begin() +
+                std::min(lineOwners.size(), i + PREFETCH_BATCH_SIZE));
+        // this loads all the lines of the owners; keep the ones asked for
+        TrustFrame::loadLines(sess, batch, [&](LedgerEntry const& le) {
+            auto key = LedgerEntryKey(le);
+            if (lines.find(key) != lines.end())
+            {
+                putCachedEntry(key, std::make_shared<LedgerEntry const>(le),
+                               db);
+            }
+        });
+    }
+    return misses;
 }
 
 void
@@ -147,6 +252,19 @@ EntryFrame::putCachedEntry(Database& db) const
     putCachedEntry(getKey(), std::make_shared<LedgerEntry const>(mEntry), db);
 }
 
+bool
+EntryFrame::storePending(Database& db) const
+{
+    auto& buffer = db.getLedgerStateBuffer();
+    if (!buffer.isActive() ||
+        !LedgerStateBuffer::isBuffered(mEntry.data.type()))
+    {
+        return false;
+    }
+    buffer.put(getKey(), std::make_shared<LedgerEntry const>(mEntry));
+    return true;
+}
+
 void
 EntryFrame::checkAgainstDatabase(LedgerEntry const& entry, Database& db)
 {
@@ -235,6 +353,84 @@ EntryFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
     }
 }
 
+void
+EntryFrame::storeAddBulk(soci::session& sess,
+                         std::vector<LedgerEntry> const& entries,
+                         bool inlineSigners)
+{
+    if (entries.empty())
+    {
+        return;
+    }
+    switch (entries.front().data.type())
+    {
+    case ACCOUNT:
+        AccountFrame::storeAddBulk(sess, entries, inlineSigners);
+        break;
+    case TRUSTLINE:
+        TrustFrame::storeAddBulk(sess, entries);
+        break;
+    case OFFER:
+        OfferFrame::storeAddBulk(sess, entries);
+        break;
+    case DATA:
+        DataFrame::storeAddBulk(sess, entries);
+        break;
+    }
+}
+
+void
+EntryFrame::storeDeleteBulk(soci::session& sess,
+                            std::vector<LedgerKey> const& keys)
+{
+    if (keys.empty())
+    {
+        return;
+    }
+    switch (keys.front().type())
+    {
+    case ACCOUNT:
+        AccountFrame::storeDeleteBulk(sess, keys);
+        break;
+    case TRUSTLINE:
+        TrustFrame::storeDeleteBulk(sess, keys);
+        break;
+    case OFFER:
+        OfferFrame::storeDeleteBulk(sess, keys);
+        break;
+    case DATA:
+        DataFrame::storeDeleteBulk(sess, keys);
+        break;
+    }
+}
+
+bool
+EntryFrame::storeIsEmpty(soci::session& sess, LedgerEntryType type)
+{
+    std::string table;
+    switch (type)
+    {
+    case ACCOUNT:
+        table = "accounts";
+        break;
+    case TRUSTLINE:
+        table = "trustlines";
+        break;
+    case OFFER:
+        table = "offers";
+        break;
+    case DATA:
+        table = "accountdata";
+        break;
+    default:
+        abort();
+    }
+    int exists = 0;
+    sess << "SELECT EXISTS (SELECT NULL FROM " + table + ")",
+        soci::into(exists);
+    return exists == 0;
+}
+
 LedgerKey
 LedgerEntryKey(LedgerEntry const& e)
 {
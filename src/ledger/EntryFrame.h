@@ -15,6 +15,11 @@ Parent of AccountFrame, TrustFrame, OfferFrame
 These just hold the xdr LedgerEntry objects and have some associated functions
 */
 
+namespace soci
+{
+class session;
+}
+
 namespace stellar
 {
 class Database;
@@ -45,12 +50,31 @@ class EntryFrame : public NonMovableOrCopyable
     // Static helpers for working with the DB LedgerEntry cache.
     static void flushCachedEntry(LedgerKey const& key, Database& db);
     static bool cachedEntryExists(LedgerKey const& key, Database& db);
-    static std::shared_ptr<LedgerEntry const>
-    getCachedEntry(LedgerKey const& key, Database& db);
+    // Returns false on a cache miss; on a hit `p` is set, possibly to
+    // nullptr if the entry is cached as non-existent.
+    static bool getCachedEntry(LedgerKey const& key,
+                               std::shared_ptr<LedgerEntry const>& p,
+                               Database& db);
     static void putCachedEntry(LedgerKey const& key,
                                std::shared_ptr<LedgerEntry const> p,
                                Database& db);
 
+    // Static helpers for the ledger-close write buffer (LedgerStateBuffer).
+    // getPendingEntry works like getCachedEntry; storePendingDelete records
+    // a deletion and returns true if writes are being buffered for the type
+    // of `key`, and returns false (doing nothing) otherwise.
+    static bool getPendingEntry(LedgerKey const& key,
+                                std::shared_ptr<LedgerEntry const>& p,
+                                Database& db);
+    static bool storePendingDelete(LedgerKey const& key, Database& db);
+
+    // Loads the entries of `keys` that are neither pending nor cached into
+    // the entry cache with a few batched queries, so that loading them
+    // afterwards does not hit the database. Only accounts and trust lines
+    // are prefetched, and `keys` is expected to hold no duplicates. Returns
+    // the number of keys that had to be looked up in the database.
+    static size_t prefetch(std::vector<LedgerKey> const& keys, Database& db);
+
     // helpers to get/set the last modified field
     uint32 getLastModified() const;
     uint32& getLastModified();
@@ -63,6 +87,8 @@ class EntryFrame : public NonMovableOrCopyable
     // Member helpers that call cache flush/put for self.
     void flushCachedEntry(Database& db) const;
     void putCachedEntry(Database& db) const;
+    // Same as storePendingDelete, recording the current state of self.
+    bool storePending(Database& db) const;
 
     static void checkAgainstDatabase(LedgerEntry const& entry, Database& db);
 
@@ -78,6 +104,18 @@ class EntryFrame : public NonMovableOrCopyable
     static bool exists(Database& db, LedgerKey const& key);
     static void storeDelete(LedgerDelta& delta, Database& db,
                             LedgerKey const& key);
+
+    // Bulk helpers for applying buckets; all the entries (or keys) passed in
+    // one call must be of the same type. See the frames' storeAddBulk;
+    // `inlineSigners` is passed on to AccountFrame's.
+    static void storeAddBulk(soci::session& sess,
+                             std::vector<LedgerEntry> const& entries,
+                             bool inlineSigners);
+    static void storeDeleteBulk(soci::session& sess,
+                                std::vector<LedgerKey> const& keys);
+
+    // Return true if the database holds no entries of type `type`.
+    static bool storeIsEmpty(soci::session& sess, LedgerEntryType type);
 };
 
 // static helper for getting a LedgerKey from a LedgerEntry.
@@ -3,25 +3,400 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "ledger/LedgerDelta.h"
+#include "database/Database.h"
+#include "ledger/LedgerHashUtils.h"
+#include "ledger/LedgerStateBuffer.h"
+#include "ledger/OrderBook.h"
 #include "main/Application.h"
 #include "main/Config.h"
 #include "medida/meter.h"
 #include "medida/metrics_registry.h"
 #include "xdr/Stellar-ledger.h"
 #include "xdrpp/printer.h"
+#include <algorithm>
+#include <cassert>
+#include <limits>
 
 namespace stellar
 {
 using xdr::operator==;
 
+/**
+ * Records of the entries changed by an outermost LedgerDelta and the deltas
+ * nested in it, kept in a vector that only grows over the life of the
+ * outermost delta and indexed by an open-addressing hash table.
+ *
+ * A record holds the combined state of its entry, as the outermost delta
+ * sees it once all the open deltas commit: eNew, eMod, eDelete, or eNone
+ * when nothing changed it (it was only loaded, or the changes cancelled
+ * out). It also holds the scope of the innermost delta that touched it,
+ * the previous value that delta recorded, and whether that delta changed
+ * the entry.
+ *
+ * The first time a nested delta touches a record, the record is saved to
+ * the undo log. Rolling a delta back restores the records saved from where
+ * its part of the log starts, and truncates the log there. Committing a
+ * nested delta hands its records over to the outer delta, whose part of the
+ * log now includes the nested one's. What a delta changed by itself follows
+ * from the state saved when it first touched a record and the current
+ * state.
+ *
+ * The outermost delta is never rolled back into anything, and all records
+ * start out unchanged for it, so it does not use the log: once a delta
+ * commits into it, the log is truncated again. The log thus only holds the
+ * changes of the transaction being applied.
+ */
+class LedgerDelta::EntryTable
+{
+  public:
+    enum State : uint8_t
+    {
+        eNone,
+        eNew,
+        eMod,
+        eDelete
+    };
+
+    struct Value
+    {
+        EntryFrame::pointer mEntry;    // the latest value, for eNew and eMod
+        EntryFrame::pointer mPrevious; // recorded by mScope
+        uint32_t mScope{0};
+        State mState{eNone};
+        bool mModified{false}; // changed by mScope
+    };
+
+    struct Record
+    {
+        LedgerKey mKey;
+        size_t mHash;
+        Value mValue;
+        mutable uint64_t mVisit;
+
+        Record(LedgerKey const& key, size_t hash)
+            : mKey(key), mHash(hash), mVisit(0)
+        {
+        }
+    };
+
+    struct Change
+    {
+        uint32_t mRecord;
+        State mState;
+    };
+
+    EntryTable();
+
+    // innermost open scope, 0 if there is none
+    uint32_t
+    top() const
+    {
+        return mOpen.empty() ? 0 : mOpen.back();
+    }
+    uint32_t open();
+    size_t
+    logSize() const
+    {
+        return mLog.size();
+    }
+
+    // returns the record of `key` for `scope` to change
+    Value& touch(LedgerKey const& key, uint32_t scope);
+
+    // outerScope is 0 when committing the outermost scope, whose records
+    // are left as they are
+    void commit(uint32_t scope, size_t logStart, uint32_t outerScope);
+    // returns whether an offer the scope changed was rolled back
+    bool rollback(uint32_t scope, size_t logStart, Database& db);
+
+    // the changes of `scope`, new entries first, then modified and deleted
+    // ones, each sorted by key
+    std::vector<Change> getChanges(uint32_t scope, size_t logStart) const;
+
+    Record const&
+    get(uint32_t record) const
+    {
+        return mRecords[record];
+    }
+
+  private:
+    static uint32_t const EMPTY = std::numeric_limits<uint32_t>::max();
+    static uint32_t const OUTERMOST = 1; // the first scope opened
+
+    struct Undo
+    {
+        uint32_t mRecord;
+        Value mValue;
+    };
+
+    LedgerKeyHash const mHash;
+    std::vector<Record> mRecords;
+    std::vector<uint32_t> mSlots; // indices in mRecords
+    std::vector<Undo> mLog;
+    std::vector<uint32_t> mOpen;
+    uint32_t mNextScope{1};
+    mutable uint64_t mVisit{0};
+
+    static State ownState(State saved, State current);
+    uint32_t findOrInsert(LedgerKey const& key);
+    void grow();
+};
+
+uint32_t const LedgerDelta::EntryTable::EMPTY;
+uint32_t const LedgerDelta::EntryTable::OUTERMOST;
+
+namespace
+{
+ShortHashKey const&
+entryTableKey()
+{
+    static ShortHashKey const key = shortHash::randomKey();
+    return key;
+}
+}
+
+LedgerDelta::EntryTable::EntryTable() : mHash{entryTableKey()}
+{
+    grow();
+}
+
+uint32_t
+LedgerDelta::EntryTable::open()
+{
+    mOpen.push_back(mNextScope++);
+    return mOpen.back();
+}
+
+LedgerDelta::EntryTable::State
+LedgerDelta::EntryTable::ownState(State saved, State current)
+{
+    bool exists = current == eNew || current == eMod;
+    switch (saved)
+    {
+    case eNone:
+        return current;
+    case eDelete:
+        return exists ? eNew : eNone;
+    default:
+        return exists ? eMod : eDelete;
+    }
+}
+
+uint32_t
+LedgerDelta::EntryTable::findOrInsert(LedgerKey const& key)
+{
+    // keeps the load factor under 1/2, so that probe sequences stay short
+    if (mRecords.size() * 2 >= mSlots.size())
+    {
+        grow();
+    }
+    size_t hash = mHash(key);
+    size_t mask = mSlots.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        auto r = mSlots[i];
+        if (r == EMPTY)
+        {
+            r = static_cast<uint32_t>(mRecords.size());
+            mRecords.emplace_back(key, hash);
+            mSlots[i] = r;
+            return r;
+        }
+        auto const& record = mRecords[r];
+        if (record.mHash == hash && record.mKey == key)
+        {
+            return r;
+        }
+    }
+}
+
+void
+LedgerDelta::EntryTable::grow()
+{
+    std::vector<uint32_t> slots(std::max<size_t>(mSlots.size() * 2, 64),
+                                EMPTY);
+    size_t mask = slots.size() - 1;
+    for (uint32_t r = 0; r < mRecords.size(); ++r)
+    {
+        size_t i = mRecords[r].mHash & mask;
+        while (slots[i] != EMPTY)
+        {
+            i = (i + 1) & mask;
+        }
+        slots[i] = r;
+    }
+    mSlots.swap(slots);
+}
+
+LedgerDelta::EntryTable::Value&
+LedgerDelta::EntryTable::touch(LedgerKey const& key, uint32_t scope)
+{
+    auto r = findOrInsert(key);
+    auto& v = mRecords[r].mValue;
+    if (v.mScope != scope)
+    {
+        if (scope != OUTERMOST)
+        {
+            mLog.push_back(Undo{r, v});
+        }
+        v.mScope = scope;
+        v.mPrevious.reset();
+        v.mModified = false;
+    }
+    return v;
+}
+
+void
+LedgerDelta::EntryTable::commit(uint32_t scope, size_t logStart,
+                                uint32_t outerScope)
+{
+    assert(top() == scope);
+    mOpen.pop_back();
+    if (outerScope == 0)
+    {
+        return;
+    }
+
+    for (size_t i = logStart; i < mLog.size(); ++i)
+    {
+        auto const& saved = mLog[i].mValue;
+        auto& v = mRecords[mLog[i].mRecord].mValue;
+        if (v.mScope != scope)
+        {
+            // saved again by a nested delta, already handed over
+            continue;
+        }
+        bool outerTouched = saved.mScope == outerScope;
+        auto own = v.mModified ? ownState(saved.mState, v.mState) : eNone;
+        // the outer delta keeps the previous value it recorded itself, or
+        // else takes the one of the entries this delta modified or deleted
+        if (outerTouched && saved.mPrevious)
+        {
+            v.mPrevious = saved.mPrevious;
+        }
+        else if (own != eMod && own != eDelete)
+        {
+            v.mPrevious.reset();
+        }
+        v.mModified = (outerTouched && saved.mModified) || own != eNone;
+        v.mScope = outerScope;
+    }
+    if (outerScope == OUTERMOST)
+    {
+        mLog.erase(mLog.begin() + logStart, mLog.end());
+    }
+}
+
+bool
+LedgerDelta::EntryTable::rollback(uint32_t scope, size_t logStart,
+                                  Database& db)
+{
+    assert(top() == scope);
+    mOpen.pop_back();
+    bool offers = false;
+    if (scope == OUTERMOST)
+    {
+        for (auto const& record : mRecords)
+        {
+            if (record.mValue.mScope == scope && record.mValue.mModified)
+            {
+                EntryFrame::flushCachedEntry(record.mKey, db);
+                offers = offers || record.mKey.type() == OFFER;
+            }
+        }
+        return offers;
+    }
+    for (size_t i = logStart; i < mLog.size(); ++i)
+    {
+        auto const& record = mRecords[mLog[i].mRecord];
+        if (record.mValue.mScope == scope && record.mValue.mModified)
+        {
+            EntryFrame::flushCachedEntry(record.mKey, db);
+            offers = offers || record.mKey.type() == OFFER;
+        }
+    }
+    while (mLog.size() > logStart)
+    {
+        auto& undo = mLog.back();
+        mRecords[undo.mRecord].mValue = std::move(undo.mValue);
+        mLog.pop_back();
+    }
+    return offers;
+}
+
+std::vector<LedgerDelta::EntryTable::Change>
+LedgerDelta::EntryTable::getChanges(uint32_t scope, size_t logStart) const
+{
+    std::vector<Change> changes;
+    if (scope == OUTERMOST)
+    {
+        for (uint32_t r = 0; r < mRecords.size(); ++r)
+        {
+            auto const& v = mRecords[r].mValue;
+            if (v.mScope == scope && v.mModified && v.mState != eNone)
+            {
+                changes.push_back(Change{r, v.mState});
+            }
+        }
+    }
+    else
+    {
+        auto visit = ++mVisit;
+        for (size_t i = logStart; i < mLog.size(); ++i)
+        {
+            auto const& undo = mLog[i];
+            auto const& record = mRecords[undo.mRecord];
+            // the first time a record was saved is the state to compare with
+            if (record.mVisit == visit || record.mValue.mScope != scope)
+            {
+                continue;
+            }
+            record.mVisit = visit;
+            if (record.mValue.mModified)
+            {
+                auto own =
+                    ownState(undo.mValue.mState, record.mValue.mState);
+                if (own != eNone)
+                {
+                    changes.push_back(Change{undo.mRecord, own});
+                }
+            }
+        }
+    }
+
+    LedgerEntryIdCmp cmp;
+    std::sort(changes.begin(), changes.end(),
+              [this, &cmp](Change const& a, Change const& b) {
+                  if (a.mState != b.mState)
+                  {
+                      return a.mState < b.mState;
+                  }
+                  return cmp(mRecords[a.mRecord].mKey,
+                             mRecords[b.mRecord].mKey);
+              });
+    return changes;
+}
+
 LedgerDelta::LedgerDelta(LedgerDelta& outerDelta)
     : mOuterDelta(&outerDelta)
     , mHeader(&outerDelta.getHeader())
     , mCurrentHeader(outerDelta.getHeader())
     , mPreviousHeaderValue(outerDelta.getHeader())
+    , mTable(outerDelta.mTable)
+    , mScope(0)
+    , mLogStart(0)
     , mDb(outerDelta.mDb)
     , mUpdateLastModified(outerDelta.mUpdateLastModified)
+    , mStateBufferScope(mDb.getLedgerStateBuffer().isActive())
 {
+    outerDelta.checkState();
+    mScope = mTable->open();
+    mLogStart = mTable->logSize();
+    if (mStateBufferScope)
+    {
+        mDb.getLedgerStateBuffer().beginScope();
+    }
+    mDb.getOrderBook().beginScope();
 }
 
 LedgerDelta::LedgerDelta(LedgerHeader& header, Database& db,
@@ -30,8 +405,12 @@ LedgerDelta::LedgerDelta(LedgerHeader& header, Database& db,
     , mHeader(&header)
     , mCurrentHeader(header)
     , mPreviousHeaderValue(header)
+    , mTable(std::make_shared<EntryTable>())
+    , mScope(mTable->open())
+    , mLogStart(0)
     , mDb(db)
     , mUpdateLastModified(updateLastModified)
+    , mStateBufferScope(false)
 {
 }
 
@@ -69,142 +448,86 @@ LedgerDelta::checkState()
         throw std::runtime_error(
             "Invalid operation: delta is already committed");
     }
+    if (mTable->top() != mScope)
+    {
+        throw std::runtime_error(
+            "Invalid operation: delta has an open nested delta");
+    }
 }
 
 void
-LedgerDelta::addEntry(EntryFrame const& entry)
-{
-    addEntry(entry.copy());
-}
-
-void
-LedgerDelta::deleteEntry(EntryFrame const& entry)
-{
-    deleteEntry(entry.copy());
-}
-
-void
-LedgerDelta::modEntry(EntryFrame const& entry)
-{
-    modEntry(entry.copy());
-}
-
-void
-LedgerDelta::recordEntry(EntryFrame const& entry)
+LedgerDelta::checkReadable() const
 {
-    recordEntry(entry.copy());
+    // scopes are numbered in the order deltas are opened
+    if (mTable->top() > mScope)
+    {
+        throw std::runtime_error(
+            "Invalid operation: delta has an open nested delta");
+    }
 }
 
 void
-LedgerDelta::addEntry(EntryFrame::pointer entry)
+LedgerDelta::addEntry(EntryFrame const& entry)
 {
     checkState();
-    auto k = entry->getKey();
-    auto del_it = mDelete.find(k);
-    if (del_it != mDelete.end())
+    auto& v = mTable->touch(entry.getKey(), mScope);
+    if (v.mState == EntryTable::eDelete)
     {
         // delete + new is an update
-        mDelete.erase(del_it);
-        mMod[k] = entry;
+        v.mState = EntryTable::eMod;
     }
     else
     {
-        assert(mNew.find(k) == mNew.end()); // double new
-        assert(mMod.find(k) == mMod.end()); // mod + new is invalid
-        mNew[k] = entry;
+        // double new and mod + new are invalid
+        assert(v.mState == EntryTable::eNone);
+        v.mState = EntryTable::eNew;
     }
+    v.mEntry = entry.copy();
+    v.mModified = true;
 }
 
 void
-LedgerDelta::deleteEntry(EntryFrame::pointer entry)
+LedgerDelta::deleteEntry(EntryFrame const& entry)
 {
-    auto k = entry->getKey();
-    deleteEntry(k);
+    deleteEntry(entry.getKey());
 }
 
 void
 LedgerDelta::deleteEntry(LedgerKey const& k)
 {
     checkState();
-    auto new_it = mNew.find(k);
-    if (new_it != mNew.end())
-    {
-        // new + delete -> don't add it in the first place
-        mNew.erase(new_it);
-    }
-    else
-    {
-        if (mDelete.find(k) == mDelete.end())
-        {
-            mDelete.insert(k);
-        } // else already being deleted
-
-        mMod.erase(k);
-    }
+    auto& v = mTable->touch(k, mScope);
+    // new + delete -> don't add it in the first place
+    v.mState = v.mState == EntryTable::eNew ? EntryTable::eNone
+                                            : EntryTable::eDelete;
+    v.mEntry.reset();
+    v.mModified = true;
 }
 
 void
-LedgerDelta::modEntry(EntryFrame::pointer entry)
+LedgerDelta::modEntry(EntryFrame const& entry)
 {
     checkState();
-    auto k = entry->getKey();
-    auto mod_it = mMod.find(k);
-    if (mod_it != mMod.end())
-    {
-        // collapse mod
-        mod_it->second = entry;
-    }
-    else
+    auto& v = mTable->touch(entry.getKey(), mScope);
+    // collapses mods, and new + mod = new (with latest value)
+    assert(v.mState != EntryTable::eDelete); // delete + mod is illegal
+    if (v.mState == EntryTable::eNone)
     {
-        auto new_it = mNew.find(k);
-        if (new_it != mNew.end())
-        {
-            // new + mod = new (with latest value)
-            new_it->second = entry;
-        }
-        else
-        {
-            assert(mDelete.find(k) == mDelete.end()); // delete + mod is illegal
-            mMod[k] = entry;
-        }
+        v.mState = EntryTable::eMod;
     }
+    v.mEntry = entry.copy();
+    v.mModified = true;
 }
 
 void
-LedgerDelta::recordEntry(EntryFrame::pointer entry)
+LedgerDelta::recordEntry(EntryFrame const& entry)
 {
     checkState();
+    auto& v = mTable->touch(entry.getKey(), mScope);
     // keeps the old one around
-    mPrevious.insert(std::make_pair(entry->getKey(), entry));
-}
-
-void
-LedgerDelta::mergeEntries(LedgerDelta& other)
-{
-    checkState();
-
-    // propagates mPrevious for deleted & modified entries
-    for (auto& d : other.mDelete)
+    if (!v.mPrevious)
     {
-        deleteEntry(d);
-        auto it = other.mPrevious.find(d);
-        if (it != other.mPrevious.end())
-        {
-            recordEntry(*it->second);
-        }
-    }
-    for (auto& n : other.mNew)
-    {
-        addEntry(n.second);
-    }
-    for (auto& m : other.mMod)
-    {
-        modEntry(m.second);
-        auto it = other.mPrevious.find(m.first);
-        if (it != other.mPrevious.end())
-        {
-            recordEntry(*it->second);
-        }
+        v.mPrevious = entry.copy();
     }
 }
 
@@ -219,11 +542,16 @@ LedgerDelta::commit()
         throw std::runtime_error("unexpected header state");
     }
 
+    mTable->commit(mScope, mLogStart, mOuterDelta ? mOuterDelta->mScope : 0);
+    if (mStateBufferScope)
+    {
+        mDb.getLedgerStateBuffer().commitScope();
+    }
     if (mOuterDelta)
     {
-        mOuterDelta->mergeEntries(*this);
-        mOuterDelta = nullptr;
+        mDb.getOrderBook().commitScope();
     }
+    mOuterDelta = nullptr;
     *mHeader = mCurrentHeader.mHeader;
     mHeader = nullptr;
 }
@@ -234,29 +562,32 @@ LedgerDelta::rollback()
     checkState();
     mHeader = nullptr;
 
-    for (auto& d : mDelete)
+    if (mStateBufferScope)
     {
-        EntryFrame::flushCachedEntry(d, mDb);
+        mDb.getLedgerStateBuffer().rollbackScope();
     }
-    for (auto& n : mNew)
+
+    bool offersChanged = mTable->rollback(mScope, mLogStart, mDb);
+    if (mOuterDelta)
     {
-        EntryFrame::flushCachedEntry(n.first, mDb);
+        mDb.getOrderBook().rollbackScope();
     }
-    for (auto& m : mMod)
+    else if (offersChanged)
     {
-        EntryFrame::flushCachedEntry(m.first, mDb);
+        // the outermost delta has no scope in the book to roll back, so the
+        // book cannot tell what it changed
+        mDb.getOrderBook().clear();
     }
 }
 
 void
 LedgerDelta::addCurrentMeta(LedgerEntryChanges& changes,
-                            LedgerKey const& key) const
+                            EntryFrame::pointer const& previous) const
 {
-    auto it = mPrevious.find(key);
-    if (it != mPrevious.end())
+    if (previous)
     {
         // if the old value is from a previous ledger we emit it
-        auto const& e = it->second->mEntry;
+        auto const& e = previous->mEntry;
         if (e.lastModifiedLedgerSeq != mCurrentHeader.mHeader.ledgerSeq)
         {
             changes.emplace_back(LEDGER_ENTRY_STATE);
@@ -268,25 +599,30 @@ LedgerDelta::addCurrentMeta(LedgerEntryChanges& changes,
 LedgerEntryChanges
 LedgerDelta::getChanges() const
 {
+    checkReadable();
     LedgerEntryChanges changes;
 
-    for (auto const& k : mNew)
-    {
-        changes.emplace_back(LEDGER_ENTRY_CREATED);
-        changes.back().created() = k.second->mEntry;
-    }
-    for (auto const& k : mMod)
-    {
-        addCurrentMeta(changes, k.first);
-        changes.emplace_back(LEDGER_ENTRY_UPDATED);
-        changes.back().updated() = k.second->mEntry;
-    }
-
-    for (auto const& k : mDelete)
+    for (auto const& c : mTable->getChanges(mScope, mLogStart))
     {
-        addCurrentMeta(changes, k);
-        changes.emplace_back(LEDGER_ENTRY_REMOVED);
-        changes.back().removed() = k;
+        auto const& record = mTable->get(c.mRecord);
+        auto const& v = record.mValue;
+        switch (c.mState)
+        {
+        case EntryTable::eNew:
+            changes.emplace_back(LEDGER_ENTRY_CREATED);
+            changes.back().created() = v.mEntry->mEntry;
+            break;
+        case EntryTable::eMod:
+            addCurrentMeta(changes, v.mPrevious);
+            changes.emplace_back(LEDGER_ENTRY_UPDATED);
+            changes.back().updated() = v.mEntry->mEntry;
+            break;
+        default:
+            addCurrentMeta(changes, v.mPrevious);
+            changes.emplace_back(LEDGER_ENTRY_REMOVED);
+            changes.back().removed() = record.mKey;
+            break;
+        }
     }
 
     return changes;
@@ -295,17 +631,15 @@ LedgerDelta::getChanges() const
 std::vector<LedgerEntry>
 LedgerDelta::getLiveEntries() const
 {
+    checkReadable();
     std::vector<LedgerEntry> live;
 
-    live.reserve(mNew.size() + mMod.size());
-
-    for (auto const& k : mNew)
-    {
-        live.push_back(k.second->mEntry);
-    }
-    for (auto const& k : mMod)
+    for (auto const& c : mTable->getChanges(mScope, mLogStart))
     {
-        live.push_back(k.second->mEntry);
+        if (c.mState != EntryTable::eDelete)
+        {
+            live.push_back(mTable->get(c.mRecord).mValue.mEntry->mEntry);
+        }
     }
 
     return live;
@@ -314,13 +648,15 @@ LedgerDelta::getLiveEntries() const
 std::vector<LedgerKey>
 LedgerDelta::getDeadEntries() const
 {
+    checkReadable();
     std::vector<LedgerKey> dead;
 
-    dead.reserve(mDelete.size());
-
-    for (auto const& k : mDelete)
+    for (auto const& c : mTable->getChanges(mScope, mLogStart))
     {
-        dead.push_back(k);
+        if (c.mState == EntryTable::eDelete)
+        {
+            dead.push_back(mTable->get(c.mRecord).mKey);
+        }
     }
     return dead;
 }
@@ -334,82 +670,33 @@ LedgerDelta::updateLastModified() const
 void
 LedgerDelta::markMeters(Application& app) const
 {
-    for (auto const& ke : mNew)
-    {
-        switch (ke.first.type())
-        {
-        case ACCOUNT:
-            app.getMetrics()
-                .NewMeter({"ledger", "account", "add"}, "entry")
-                .Mark();
-            break;
-        case TRUSTLINE:
-            app.getMetrics()
-                .NewMeter({"ledger", "trust", "add"}, "entry")
-                .Mark();
-            break;
-        case OFFER:
-            app.getMetrics()
-                .NewMeter({"ledger", "offer", "add"}, "entry")
-                .Mark();
-            break;
-        case DATA:
-            app.getMetrics()
-                .NewMeter({"ledger", "data", "add"}, "entry")
-                .Mark();
-            break;
-        }
-    }
-
-    for (auto const& ke : mMod)
-    {
-        switch (ke.first.type())
-        {
-        case ACCOUNT:
-            app.getMetrics()
-                .NewMeter({"ledger", "account", "modify"}, "entry")
-                .Mark();
-            break;
-        case TRUSTLINE:
-            app.getMetrics()
-                .NewMeter({"ledger", "trust", "modify"}, "entry")
-                .Mark();
-            break;
-        case OFFER:
-            app.getMetrics()
-                .NewMeter({"ledger", "offer", "modify"}, "entry")
-                .Mark();
-            break;
-        case DATA:
-            app.getMetrics()
-                .NewMeter({"ledger", "data", "modify"}, "entry")
-                .Mark();
-            break;
-        }
-    }
-
-    for (auto const& ke : mDelete)
+    checkReadable();
+    for (auto const& c : mTable->getChanges(mScope, mLogStart))
     {
-        switch (ke.type())
+        char const* action = c.mState == EntryTable::eNew
+                                 ? "add"
+                                 : c.mState == EntryTable::eMod ? "modify"
+                                                                : "delete";
+        switch (mTable->get(c.mRecord).mKey.type())
         {
         case ACCOUNT:
             app.getMetrics()
-                .NewMeter({"ledger", "account", "delete"}, "entry")
+                .NewMeter({"ledger", "account", action}, "entry")
                 .Mark();
             break;
         case TRUSTLINE:
             app.getMetrics()
-                .NewMeter({"ledger", "trust", "delete"}, "entry")
+                .NewMeter({"ledger", "trust", action}, "entry")
                 .Mark();
             break;
         case OFFER:
             app.getMetrics()
-                .NewMeter({"ledger", "offer", "delete"}, "entry")
+                .NewMeter({"ledger", "offer", action}, "entry")
                 .Mark();
             break;
         case DATA:
             app.getMetrics()
-                .NewMeter({"ledger", "data", "delete"}, "entry")
+                .NewMeter({"ledger", "data", action}, "entry")
                 .Mark();
             break;
         }
@@ -9,6 +9,7 @@
 #include "ledger/LedgerHeaderFrame.h"
 #include "xdrpp/marshal.h"
 #include <map>
+#include <memory>
 #include <set>
 
 namespace stellar
@@ -18,8 +19,12 @@ class Database;
 
 class LedgerDelta
 {
-    typedef std::map<LedgerKey, EntryFrame::pointer, LedgerEntryIdCmp>
-        KeyEntryMap;
+    // Changes are tracked in a single table shared by the outermost delta
+    // and all the deltas nested in it: each key has one record holding its
+    // combined state, and a nested delta is a scope in the table's undo log.
+    // Committing a nested delta leaves the records as they are, and rolling
+    // it back replays its part of the log; see LedgerDelta.cpp.
+    class EntryTable;
 
     LedgerDelta*
         mOuterDelta;       // set when this delta is nested inside another delta
@@ -30,28 +35,25 @@ class LedgerDelta
     LedgerHeaderFrame mCurrentHeader;
     LedgerHeader mPreviousHeaderValue;
     // ledger entries
-    KeyEntryMap mNew;
-    KeyEntryMap mMod;
-    std::set<LedgerKey, LedgerEntryIdCmp> mDelete;
-    KeyEntryMap mPrevious;
+    std::shared_ptr<EntryTable> mTable;
+    uint32_t mScope;  // identifies this delta in mTable
+    size_t mLogStart; // where the undo log of this delta starts
 
-    Database& mDb; // Used strictly for rollback of db entry cache.
+    Database& mDb; // Used for rollback of db entry cache and state buffer.
 
     bool mUpdateLastModified;
 
-    void checkState();
-    void addEntry(EntryFrame::pointer entry);
-    void deleteEntry(EntryFrame::pointer entry);
-    void modEntry(EntryFrame::pointer entry);
-    void recordEntry(EntryFrame::pointer entry);
+    // set when this delta opened a scope in the database's
+    // LedgerStateBuffer, to close along with the delta
+    bool mStateBufferScope;
 
-    // merge "other" into current ledgerDelta
-    void mergeEntries(LedgerDelta& other);
+    void checkState();
+    void checkReadable() const;
 
     // helper method that adds a meta entry to "changes"
     // with the previous value of an entry if needed
     void addCurrentMeta(LedgerEntryChanges& changes,
-                        LedgerKey const& key) const;
+                        EntryFrame::pointer const& previous) const;
 
   public:
     // keeps an internal reference to the outerDelta,
@@ -71,7 +73,8 @@ class LedgerDelta
     LedgerHeader const& getHeader() const;
     LedgerHeaderFrame& getHeaderFrame();
 
-    // methods to register changes in the ledger entries
+    // methods to register changes in the ledger entries; they can only be
+    // called on the innermost open delta
     void addEntry(EntryFrame const& entry);
     void deleteEntry(EntryFrame const& entry);
     void deleteEntry(LedgerKey const& key);
@@ -85,6 +88,9 @@ class LedgerDelta
 
     bool updateLastModified() const;
 
+    // The methods below describe the changes made by this delta (including
+    // the ones committed into it). They are valid while it is the innermost
+    // open delta, and for the outermost delta also once it is committed.
     void markMeters(Application& app) const;
 
     std::vector<LedgerEntry> getLiveEntries() const;
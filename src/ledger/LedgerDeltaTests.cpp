@@ -10,6 +10,7 @@
 #include "lib/catch.hpp"
 #include "main/Application.h"
 #include "test/test.h"
+#include "util/Logging.h"
 #include "util/Timer.h"
 
 using namespace stellar;
@@ -331,3 +332,118 @@ TEST_CASE("Ledger delta", "[ledger][ledgerdelta]")
         }
     }
 }
+
+TEST_CASE("Ledger delta nesting", "[ledger][ledgerdelta]")
+{
+    Config cfg(getTestConfig());
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    LedgerDelta delta(app->getLedgerManager().getCurrentLedgerHeader(),
+                      app->getDatabase());
+    delta.getHeader().ledgerSeq++;
+    auto entries = LedgerTestUtils::generateValidAccountEntries(2);
+    std::vector<AccountFrame::pointer> accounts;
+    for (auto const& a : entries)
+    {
+        LedgerEntry le;
+        le.data.type(ACCOUNT);
+        le.data.account() = a;
+        accounts.emplace_back(std::make_shared<AccountFrame>(le));
+    }
+    delta.addEntry(*accounts[0]);
+
+    {
+        LedgerDelta delta2(delta);
+        {
+            LedgerDelta delta3(delta2);
+            // only the innermost delta can be changed
+            REQUIRE_THROWS_AS(delta2.modEntry(*accounts[0]),
+                              std::runtime_error);
+            REQUIRE_THROWS_AS(delta2.getChanges(), std::runtime_error);
+
+            // the outer delta created the entry, this one modifies it
+            delta3.modEntry(*accounts[0]);
+            delta3.addEntry(*accounts[1]);
+            auto changes = delta3.getChanges();
+            REQUIRE(changes.size() == 2);
+            REQUIRE(changes[0].type() == LEDGER_ENTRY_CREATED);
+            REQUIRE(changes[1].type() == LEDGER_ENTRY_UPDATED);
+            delta3.commit();
+        }
+        REQUIRE(delta2.getChanges().size() == 2);
+        {
+            LedgerDelta delta3(delta2);
+            delta3.deleteEntry(*accounts[1]);
+            REQUIRE(delta3.getChanges().size() == 1);
+            REQUIRE(delta3.getChanges()[0].type() == LEDGER_ENTRY_REMOVED);
+        }
+        // rolled back, nothing changed
+        REQUIRE(delta2.getChanges().size() == 2);
+        delta2.deleteEntry(*accounts[1]);
+        // new + delete cancel out
+        REQUIRE(delta2.getChanges().size() == 1);
+        delta2.commit();
+    }
+
+    auto changes = delta.getChanges();
+    REQUIRE(changes.size() == 1);
+    REQUIRE(changes[0].type() == LEDGER_ENTRY_CREATED);
+    delta.commit();
+    REQUIRE(delta.getLiveEntries().size() == 1);
+    REQUIRE(delta.getDeadEntries().empty());
+}
+
+TEST_CASE("Ledger delta nested commit and rollback benchmarking",
+          "[ledgerdelta][bench][hide]")
+{
+    Config cfg(getTestConfig());
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+
+    size_t const nbAccounts = 1000;
+    size_t const nbTx = 20000;
+    size_t const nbOps = 5;
+    std::vector<AccountFrame::pointer> accounts;
+    for (auto const& a :
+         LedgerTestUtils::generateValidAccountEntries(nbAccounts))
+    {
+        LedgerEntry le;
+        le.data.type(ACCOUNT);
+        le.data.account() = a;
+        accounts.emplace_back(std::make_shared<AccountFrame>(le));
+    }
+
+    LedgerDelta delta(app->getLedgerManager().getCurrentLedgerHeader(),
+                      app->getDatabase());
+    LOG(INFO) << "Benchmarking " << nbTx << " transactions of " << nbOps
+              << " operations in nested deltas";
+    {
+        TIMED_SCOPE(timerBlkObj, "nested deltas");
+        for (size_t i = 0; i < nbTx; ++i)
+        {
+            LedgerDelta txDelta(delta);
+            for (size_t j = 0; j < nbOps; ++j)
+            {
+                LedgerDelta opDelta(txDelta);
+                auto const& a = accounts[(i * nbOps + j) % nbAccounts];
+                opDelta.recordEntry(*a);
+                opDelta.modEntry(*a);
+                opDelta.getChanges();
+                opDelta.commit();
+            }
+            // one transaction in four fails
+            if (i % 4 == 0)
+            {
+                txDelta.rollback();
+            }
+            else
+            {
+                txDelta.commit();
+            }
+        }
+    }
+    REQUIRE(delta.getLiveEntries().size() <= nbAccounts);
+}
@@ -0,0 +1,29 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerHashUtils.h"
+#include "xdrpp/marshal.h"
+
+namespace stellar
+{
+
+size_t
+LedgerKeyHash::operator()(LedgerKey const& key) const
+{
+    // Room for the largest key, a DATA key with a 64-byte name, so that
+    // hashing does not allocate.
+    uint32_t buf[32];
+    size_t sz = xdr::xdr_size(key);
+    if (sz > sizeof(buf))
+    {
+        auto bin = xdr::xdr_to_opaque(key);
+        return static_cast<size_t>(shortHash::computeHash(mKey, bin));
+    }
+    char* begin = reinterpret_cast<char*>(buf);
+    xdr::xdr_put p(begin, begin + sz);
+    xdr::xdr_argpack_archive(p, key);
+    return static_cast<size_t>(
+        shortHash::computeHash(mKey, ByteSlice(begin, sz)));
+}
+}
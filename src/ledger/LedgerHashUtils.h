@@ -0,0 +1,22 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/ShortHash.h"
+#include "overlay/StellarXDR.h"
+
+namespace stellar
+{
+
+// Hashes a LedgerKey for hash tables, as the keyed short hash of its whole
+// XDR. Keys are chosen by whoever submits transactions, so tables holding
+// them should use a random key (see shortHash::randomKey) to keep their
+// placement unpredictable and collisions out of an attacker's reach.
+struct LedgerKeyHash
+{
+    ShortHashKey mKey;
+    size_t operator()(LedgerKey const& key) const;
+};
+}
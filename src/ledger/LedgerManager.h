@@ -13,6 +13,7 @@ namespace stellar
 class LedgerHeaderFrame;
 class LedgerCloseData;
 class Database;
+class TxValidationMemo;
 
 /**
  * LedgerManager maintains, in memory, a logical pair of ledgers:
@@ -128,6 +129,10 @@ class LedgerManager
 
     virtual Database& getDatabase() = 0;
 
+    // Outcomes of checking transactions against the last closed ledger,
+    // dropped whenever a ledger closes.
+    virtual TxValidationMemo& getTxValidationMemo() = 0;
+
     // Called by application lifecycle events, system startup.
     virtual void startNewLedger() = 0;
 
@@ -7,6 +7,7 @@
 #include "OfferFrame.h"
 #include "TrustFrame.h"
 #include "bucket/BucketManager.h"
+#include "bucket/LedgerCmp.h"
 #include "crypto/Hex.h"
 #include "crypto/KeyUtils.h"
 #include "crypto/SHA.h"
@@ -16,8 +17,10 @@
 #include "herder/LedgerCloseData.h"
 #include "herder/TxSetFrame.h"
 #include "history/HistoryManager.h"
+#include "ledger/EntryFrame.h"
 #include "ledger/LedgerDelta.h"
 #include "ledger/LedgerHeaderFrame.h"
+#include "ledger/LedgerStateBuffer.h"
 #include "main/Application.h"
 #include "main/Config.h"
 #include "overlay/OverlayManager.h"
@@ -26,12 +29,14 @@
 #include "util/make_unique.h"
 
 #include "medida/counter.h"
+#include "medida/histogram.h"
 #include "medida/meter.h"
 #include "medida/metrics_registry.h"
 #include "medida/timer.h"
 #include "xdrpp/printer.h"
 #include "xdrpp/types.h"
 
+#include <algorithm>
 #include <chrono>
 #include <sstream>
 
@@ -103,6 +108,18 @@ LedgerManagerImpl::LedgerManagerImpl(Application& app)
     , mTransactionApply(
           app.getMetrics().NewTimer({"ledger", "transaction", "apply"}))
     , mLedgerClose(app.getMetrics().NewTimer({"ledger", "ledger", "close"}))
+    , mLedgerCloseApply(
+          app.getMetrics().NewTimer({"ledger", "close", "apply"}))
+    , mLedgerCloseBucketJoin(
+          app.getMetrics().NewTimer({"ledger", "close", "bucket-join"}))
+    , mLedgerCloseCommit(
+          app.getMetrics().NewTimer({"ledger", "close", "commit"}))
+    , mLedgerEntryFlush(
+          app.getMetrics().NewTimer({"ledger", "entry", "flush"}))
+    , mLedgerPrefetch(
+          app.getMetrics().NewTimer({"ledger", "prefetch", "load"}))
+    , mLedgerPrefetchHitRatio(
+          app.getMetrics().NewHistogram({"ledger", "prefetch", "hit-ratio"}))
     , mLedgerAgeClosed(app.getMetrics().NewTimer({"ledger", "age", "closed"}))
     , mLedgerAge(
           app.getMetrics().NewCounter({"ledger", "age", "current-seconds"}))
@@ -114,6 +131,7 @@ LedgerManagerImpl::LedgerManagerImpl(Application& app)
     , mLastStateChange(mApp.getClock().now())
     , mSyncingLedgersSize(
           app.getMetrics().NewCounter({"ledger", "memory", "syncing-ledgers"}))
+    , mTxValidationMemo(app.getMetrics())
     , mState(LM_BOOTING_STATE)
 
 {
@@ -180,7 +198,9 @@ LedgerManagerImpl::startNewLedger()
     mCurrentLedger = make_shared<LedgerHeaderFrame>(genesisHeader);
     CLOG(INFO, "Ledger") << "Established genesis ledger, closing";
     CLOG(INFO, "Ledger") << "Root account seed: " << skey.getStrKeySeed();
-    closeLedgerHelper(delta);
+    auto batch = mApp.getBucketManager().prepareBatch(delta.getLiveEntries(),
+                                                      delta.getDeadEntries());
+    closeLedgerHelper(delta, batch);
 }
 
 void
@@ -267,6 +287,12 @@ LedgerManagerImpl::getDatabase()
     return mApp.getDatabase();
 }
 
+TxValidationMemo&
+LedgerManagerImpl::getTxValidationMemo()
+{
+    return mTxValidationMemo;
+}
+
 int64_t
 LedgerManagerImpl::getTxFee() const
 {
@@ -695,11 +721,22 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
 
     LedgerDelta ledgerDelta(mCurrentLedger->mHeader, getDatabase());
 
+    // entries changed by the ledger are kept in memory until it is applied,
+    // and only their final state written out
+    auto& stateBuffer = getDatabase().getLedgerStateBuffer();
+    LedgerStateBuffer::Activation bufferWrites(stateBuffer);
+
     // the transaction set that was agreed upon by consensus
     // was sorted by hash; we reorder it so that transactions are
     // sorted such that sequence numbers are respected
     vector<TransactionFramePtr> txs = ledgerData.mTxSet->sortForApply();
 
+    // load what the transactions are going to need with a few queries
+    // rather than one by one as they get applied
+    prefetchLedgerEntries(txs);
+
+    auto applyTime = mLedgerCloseApply.TimeScope();
+
     // first, charge fees
     processFeesSeqNums(txs, ledgerDelta);
 
@@ -746,11 +783,26 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
         }
         }
     }
+    applyTime.Stop();
+
+    // The changes of the ledger are final: make them, in the background,
+    // into the bucket that goes to the bucket list while they are written to
+    // the database. closeLedgerHelper waits for it, as the bucket list hash
+    // goes in the header.
+    auto batch = mApp.getBucketManager().prepareBatch(
+        ledgerDelta.getLiveEntries(), ledgerDelta.getDeadEntries());
+
+    {
+        auto flushTime = mLedgerEntryFlush.TimeScope();
+        stateBuffer.flush(getDatabase());
+        stateBuffer.deactivate();
+    }
 
     ledgerDelta.checkAgainstDatabase(mApp);
 
     ledgerDelta.commit();
-    closeLedgerHelper(ledgerDelta);
+    auto commitTime = mLedgerCloseCommit.TimeScope();
+    closeLedgerHelper(ledgerDelta, batch);
 
     // The next 4 steps happen in a relatively non-obvious, subtle order.
     // This is unfortunate and it would be nice if we could make it not
@@ -872,6 +924,38 @@ LedgerManagerImpl::advanceLedgerPointers()
     mCurrentLedger = make_shared<LedgerHeaderFrame>(mLastClosedLedger);
     CLOG(DEBUG, "Ledger") << "New current ledger: seq="
                           << mCurrentLedger->mHeader.ledgerSeq;
+
+    // entries would no longer match anyway, but don't keep them around
+    mTxValidationMemo.clear();
+}
+
+void
+LedgerManagerImpl::prefetchLedgerEntries(
+    std::vector<TransactionFramePtr> const& txs)
+{
+    auto prefetchTime = mLedgerPrefetch.TimeScope();
+    std::vector<LedgerKey> keys;
+    for (auto const& tx : txs)
+    {
+        tx->insertLedgerKeysToPrefetch(keys);
+    }
+    std::sort(keys.begin(), keys.end(), LedgerEntryIdCmp());
+    keys.erase(std::unique(keys.begin(), keys.end(),
+                           [](LedgerKey const& a, LedgerKey const& b) {
+                               return !LedgerEntryIdCmp()(a, b);
+                           }),
+               keys.end());
+    if (keys.empty())
+    {
+        return;
+    }
+
+    auto loaded = EntryFrame::prefetch(keys, getDatabase());
+    // percentage of the keys that were already in memory
+    mLedgerPrefetchHitRatio.Update(100 * (keys.size() - loaded) /
+                                   keys.size());
+    CLOG(DEBUG, "Ledger") << "Prefetched " << loaded << " of " << keys.size()
+                          << " ledger entries";
 }
 
 void
@@ -946,12 +1030,20 @@ LedgerManagerImpl::applyTransactions(std::vector<TransactionFramePtr>& txs,
 }
 
 void
-LedgerManagerImpl::closeLedgerHelper(LedgerDelta const& delta)
+LedgerManagerImpl::closeLedgerHelper(
+    LedgerDelta const& delta,
+    std::shared_future<std::shared_ptr<Bucket>> const& batch)
 {
     delta.markMeters(mApp);
+    {
+        // The bucket list hash goes in the header, whose hash the next
+        // ledger builds on, so the close can't return without the bucket:
+        // only the entry flush overlaps with making it.
+        auto joinTime = mLedgerCloseBucketJoin.TimeScope();
+        batch.wait();
+    }
     mApp.getBucketManager().addBatch(mApp, mCurrentLedger->mHeader.ledgerSeq,
-                                     delta.getLiveEntries(),
-                                     delta.getDeadEntries());
+                                     batch);
 
     mApp.getBucketManager().snapshotLedger(mCurrentLedger->mHeader);
 
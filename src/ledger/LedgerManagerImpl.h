@@ -10,8 +10,10 @@
 #include "ledger/LedgerManager.h"
 #include "main/PersistentState.h"
 #include "transactions/TransactionFrame.h"
+#include "transactions/TxValidationMemo.h"
 #include "util/Timer.h"
 #include "xdr/Stellar-ledger.h"
+#include <future>
 #include <string>
 
 /*
@@ -24,11 +26,13 @@ namespace medida
 {
 class Timer;
 class Counter;
+class Histogram;
 }
 
 namespace stellar
 {
 class Application;
+class Bucket;
 class Database;
 class LedgerDelta;
 
@@ -40,6 +44,15 @@ class LedgerManagerImpl : public LedgerManager
     Application& mApp;
     medida::Timer& mTransactionApply;
     medida::Timer& mLedgerClose;
+    // stages of closeLedger; the bucket of the ledger is made while its
+    // entries are flushed (see BucketManager::prepareBatch) and joined
+    // before the header is stored
+    medida::Timer& mLedgerCloseApply;
+    medida::Timer& mLedgerCloseBucketJoin;
+    medida::Timer& mLedgerCloseCommit;
+    medida::Timer& mLedgerEntryFlush;
+    medida::Timer& mLedgerPrefetch;
+    medida::Histogram& mLedgerPrefetchHitRatio;
     medida::Timer& mLedgerAgeClosed;
     medida::Counter& mLedgerAge;
     medida::Counter& mLedgerStateCurrent;
@@ -51,17 +64,22 @@ class LedgerManagerImpl : public LedgerManager
 
     std::vector<LedgerCloseData> mSyncingLedgers;
 
+    TxValidationMemo mTxValidationMemo;
+
     void historyCaughtup(asio::error_code const& ec,
                          HistoryManager::CatchupMode mode,
                          LedgerHeaderHistoryEntry const& lastClosed);
 
+    void prefetchLedgerEntries(std::vector<TransactionFramePtr> const& txs);
     void processFeesSeqNums(std::vector<TransactionFramePtr>& txs,
                             LedgerDelta& delta);
     void applyTransactions(std::vector<TransactionFramePtr>& txs,
                            LedgerDelta& ledgerDelta,
                            TransactionResultSet& txResultSet);
 
-    void closeLedgerHelper(LedgerDelta const& delta);
+    void
+    closeLedgerHelper(LedgerDelta const& delta,
+                      std::shared_future<std::shared_ptr<Bucket>> const& batch);
     void advanceLedgerPointers();
 
     State mState;
@@ -94,6 +112,7 @@ class LedgerManagerImpl : public LedgerManager
     uint32_t getCurrentLedgerVersion() const override;
 
     Database& getDatabase() override;
+    TxValidationMemo& getTxValidationMemo() override;
 
     void startCatchUp(uint32_t initLedger, HistoryManager::CatchupMode resume,
                       bool manualCatchup = false) override;
@@ -0,0 +1,165 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerStateBuffer.h"
+#include "database/Database.h"
+#include "ledger/EntryFrame.h"
+#include <cassert>
+
+namespace stellar
+{
+
+LedgerStateBuffer::Activation::Activation(LedgerStateBuffer& buffer)
+    : mBuffer(buffer)
+{
+    mBuffer.activate();
+}
+
+LedgerStateBuffer::Activation::~Activation()
+{
+    if (mBuffer.isActive())
+    {
+        mBuffer.deactivate();
+    }
+}
+
+void
+LedgerStateBuffer::activate()
+{
+    assert(!mActive);
+    assert(mEntries.empty() && mScopes.empty());
+    mActive = true;
+}
+
+void
+LedgerStateBuffer::deactivate()
+{
+    mActive = false;
+    mEntries.clear();
+    mScopes.clear();
+}
+
+bool
+LedgerStateBuffer::isBuffered(LedgerEntryType type)
+{
+    return type != OFFER;
+}
+
+bool
+LedgerStateBuffer::get(LedgerKey const& key, EntryPtr& entry) const
+{
+    auto it = mEntries.find(key);
+    if (it == mEntries.end())
+    {
+        return false;
+    }
+    entry = it->second;
+    return true;
+}
+
+void
+LedgerStateBuffer::put(LedgerKey const& key, EntryPtr entry)
+{
+    assert(mActive && isBuffered(key.type()));
+    auto it = mEntries.find(key);
+    if (!mScopes.empty())
+    {
+        // only the state at the time the scope was opened matters
+        Undo undo{it != mEntries.end(), nullptr};
+        if (undo.mPending)
+        {
+            undo.mEntry = it->second;
+        }
+        mScopes.back().emplace(key, std::move(undo));
+    }
+    if (it != mEntries.end())
+    {
+        it->second = std::move(entry);
+    }
+    else
+    {
+        mEntries.emplace(key, std::move(entry));
+    }
+}
+
+void
+LedgerStateBuffer::beginScope()
+{
+    assert(mActive);
+    mScopes.emplace_back();
+}
+
+void
+LedgerStateBuffer::commitScope()
+{
+    assert(!mScopes.empty());
+    auto scope = std::move(mScopes.back());
+    mScopes.pop_back();
+    if (!mScopes.empty())
+    {
+        // keys the outer scope already saw keep their older state
+        auto& outer = mScopes.back();
+        for (auto& u : scope)
+        {
+            outer.emplace(u.first, std::move(u.second));
+        }
+    }
+}
+
+void
+LedgerStateBuffer::rollbackScope()
+{
+    assert(!mScopes.empty());
+    for (auto const& u : mScopes.back())
+    {
+        if (u.second.mPending)
+        {
+            mEntries[u.first] = u.second.mEntry;
+        }
+        else
+        {
+            mEntries.erase(u.first);
+        }
+    }
+    mScopes.pop_back();
+}
+
+void
+LedgerStateBuffer::flush(Database& db) const
+{
+    for (auto type : {ACCOUNT, TRUSTLINE, DATA})
+    {
+        flush(db, type);
+    }
+}
+
+void
+LedgerStateBuffer::flush(Database& db, LedgerEntryType type) const
+{
+    std::vector<LedgerKey> keys;
+    std::vector<LedgerEntry> live;
+    for (auto const& e : mEntries)
+    {
+        if (e.first.type() == type)
+        {
+            keys.emplace_back(e.first);
+            if (e.second)
+            {
+                live.emplace_back(*e.second);
+            }
+        }
+    }
+    if (keys.empty())
+    {
+        return;
+    }
+
+    // Rows are replaced wholesale, which also takes care of the signers of
+    // accounts.
+    auto timer = db.getUpdateTimer("ledger-state-flush");
+    auto& sess = db.getSession();
+    EntryFrame::storeDeleteBulk(sess, keys);
+    EntryFrame::storeAddBulk(sess, live, db.hasInlineAccountSigners());
+}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "bucket/LedgerCmp.h"
+#include "overlay/StellarXDR.h"
+#include "util/NonCopyable.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace stellar
+{
+class Database;
+
+/**
+ * Write-back buffer for the ledger entries changed while closing a ledger.
+ *
+ * While the buffer is active, the frames' store methods record the new
+ * state of an entry here (nullptr for a deletion) rather than writing it to
+ * the database, and their loaders read it back from here before looking at
+ * the entry cache or the database. However many transactions touch an entry
+ * over a ledger, flush() only writes its final state, using a few multi-row
+ * statements per table.
+ *
+ * Changes are scoped like the LedgerDeltas that make them: a nested delta
+ * opens a scope, and rolling it back restores the pending state the buffer
+ * had when it was opened.
+ *
+ * Offers are not buffered, as the order book is read with range queries
+ * that only the database can answer.
+ *
+ * The buffer is only used from the main thread.
+ */
+class LedgerStateBuffer : NonMovableOrCopyable
+{
+  public:
+    typedef std::shared_ptr<LedgerEntry const> EntryPtr;
+
+    // Activates a buffer for its lifetime; whatever has not been flushed
+    // when it goes away (an exception while closing a ledger) is dropped.
+    class Activation : NonMovableOrCopyable
+    {
+        LedgerStateBuffer& mBuffer;
+
+      public:
+        explicit Activation(LedgerStateBuffer& buffer);
+        ~Activation();
+    };
+
+    bool
+    isActive() const
+    {
+        return mActive;
+    }
+    void activate();
+    void deactivate();
+
+    static bool isBuffered(LedgerEntryType type);
+
+    // Sets `entry` and returns true if `key` has a pending change; `entry`
+    // is then nullptr if the change is a deletion.
+    bool get(LedgerKey const& key, EntryPtr& entry) const;
+    void put(LedgerKey const& key, EntryPtr entry);
+
+    void beginScope();
+    void commitScope();
+    void rollbackScope();
+
+    // Writes the pending changes (only those of `type` for the second
+    // form) to the database. They stay pending, as the database transaction
+    // the writes happen in may still be rolled back; flushing them again is
+    // harmless.
+    void flush(Database& db) const;
+    void flush(Database& db, LedgerEntryType type) const;
+
+    size_t
+    size() const
+    {
+        return mEntries.size();
+    }
+
+  private:
+    typedef std::map<LedgerKey, EntryPtr, LedgerEntryIdCmp> EntryMap;
+
+    // Pending state of a key when a scope was opened, to restore on
+    // rollback; mPending is false if the key had no pending change.
+    struct Undo
+    {
+        bool mPending;
+        EntryPtr mEntry;
+    };
+    typedef std::map<LedgerKey, Undo, LedgerEntryIdCmp> UndoMap;
+
+    bool mActive{false};
+    EntryMap mEntries;
+    std::vector<UndoMap> mScopes;
+};
+}
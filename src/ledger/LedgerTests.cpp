@@ -5,9 +5,12 @@
 #include "LedgerTestUtils.h"
 #include "database/Database.h"
 #include "ledger/AccountFrame.h"
+#include "ledger/DataFrame.h"
 #include "ledger/EntryFrame.h"
 #include "ledger/LedgerDelta.h"
 #include "ledger/LedgerManager.h"
+#include "ledger/LedgerStateBuffer.h"
+#include "ledger/TrustFrame.h"
 #include "lib/catch.hpp"
 #include "main/Application.h"
 #include "main/Config.h"
@@ -15,6 +18,7 @@
 #include "util/Logging.h"
 #include "util/Timer.h"
 #include "util/types.h"
+#include <algorithm>
 #include <xdrpp/autocheck.h>
 
 using namespace stellar;
@@ -137,3 +141,273 @@ TEST_CASE("DB cache interaction with transactions", "[ledger][dbcache]")
 
     CHECK(balance0 == acc->getAccount().balance);
 }
+
+TEST_CASE("ledger state buffer", "[ledger][statebuffer]")
+{
+    Config cfg(getTestConfig());
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+    auto& db = app->getDatabase();
+    auto& buffer = db.getLedgerStateBuffer();
+
+    auto countRows = [&db]() {
+        auto& sess = db.getSession();
+        return AccountFrame::countObjects(sess) +
+               TrustFrame::countObjects(sess) + DataFrame::countObjects(sess);
+    };
+    auto const rowsBefore = countRows();
+
+    LedgerDelta delta(app->getLedgerManager().getCurrentLedgerHeader(), db);
+    LedgerStateBuffer::Activation bufferWrites(buffer);
+
+    std::vector<EntryFrame::pointer> entries;
+    {
+        LedgerDelta txDelta(delta);
+        for (auto const& le : LedgerTestUtils::generateValidLedgerEntries(50))
+        {
+            auto e = EntryFrame::FromXDR(le);
+            if (le.data.type() == OFFER || EntryFrame::exists(db, e->getKey()))
+            {
+                continue;
+            }
+            e->storeAdd(txDelta, db);
+            entries.emplace_back(e);
+        }
+        txDelta.commit();
+    }
+    REQUIRE(buffer.size() == entries.size());
+    // Nothing was written, but the entries can be read back.
+    REQUIRE(countRows() == rowsBefore);
+    for (auto const& e : entries)
+    {
+        REQUIRE(EntryFrame::exists(db, e->getKey()));
+    }
+
+    SECTION("rolled back changes are dropped")
+    {
+        {
+            LedgerDelta txDelta(delta);
+            for (auto const& e : entries)
+            {
+                e->storeDelete(txDelta, db);
+                REQUIRE(!EntryFrame::exists(db, e->getKey()));
+            }
+        }
+        REQUIRE(buffer.size() == entries.size());
+        for (auto const& e : entries)
+        {
+            REQUIRE(EntryFrame::exists(db, e->getKey()));
+        }
+    }
+
+    SECTION("flush writes the final state of each entry")
+    {
+        auto deleted = entries.back();
+        entries.pop_back();
+        {
+            LedgerDelta txDelta(delta);
+            deleted->storeDelete(txDelta, db);
+            txDelta.commit();
+        }
+        buffer.flush(db);
+        buffer.deactivate();
+
+        REQUIRE(countRows() == rowsBefore + entries.size());
+        REQUIRE(!EntryFrame::exists(db, deleted->getKey()));
+        for (auto const& e : entries)
+        {
+            REQUIRE_NOTHROW(EntryFrame::checkAgainstDatabase(e->mEntry, db));
+        }
+    }
+}
+
+TEST_CASE("ledger entry prefetch", "[ledger][prefetch]")
+{
+    Config cfg(getTestConfig());
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+    auto& db = app->getDatabase();
+
+    std::vector<LedgerKey> keys;
+    {
+        LedgerDelta delta(app->getLedgerManager().getCurrentLedgerHeader(),
+                          db);
+        for (auto const& le : LedgerTestUtils::generateValidLedgerEntries(50))
+        {
+            auto e = EntryFrame::FromXDR(le);
+            if (le.data.type() == OFFER || le.data.type() == DATA ||
+                EntryFrame::exists(db, e->getKey()))
+            {
+                continue;
+            }
+            e->storeAdd(delta, db);
+            keys.emplace_back(e->getKey());
+        }
+    }
+    LedgerKey missing;
+    missing.type(ACCOUNT);
+    missing.account().accountID.ed25519()[0] = 0xff;
+    keys.emplace_back(missing);
+
+    db.getEntryCache().clear();
+    REQUIRE(EntryFrame::prefetch(keys, db) == keys.size());
+    for (auto const& k : keys)
+    {
+        REQUIRE(EntryFrame::cachedEntryExists(k, db));
+    }
+    // Everything is in memory now.
+    REQUIRE(EntryFrame::prefetch(keys, db) == 0);
+    REQUIRE(!EntryFrame::exists(db, missing));
+}
+
+namespace
+{
+using xdr::operator==;
+
+std::vector<AccountEntry>
+storeAccountsWithSigners(Application& app, size_t n)
+{
+    auto& db = app.getDatabase();
+    LedgerDelta delta(app.getLedgerManager().getCurrentLedgerHeader(), db);
+    std::vector<AccountEntry> accounts;
+    for (auto const& a : LedgerTestUtils::generateValidAccountEntries(n))
+    {
+        LedgerEntry le;
+        le.data.type(ACCOUNT);
+        le.data.account() = a;
+        AccountFrame af(le);
+        if (EntryFrame::exists(db, af.getKey()))
+        {
+            continue;
+        }
+        af.storeAdd(delta, db);
+        accounts.emplace_back(a);
+    }
+    return accounts;
+}
+
+void
+checkAccounts(Database& db, std::vector<AccountEntry> const& accounts)
+{
+    db.getEntryCache().clear();
+    std::vector<AccountID> ids;
+    for (auto const& a : accounts)
+    {
+        auto af = AccountFrame::loadAccount(a.accountID, db);
+        REQUIRE(af);
+        REQUIRE(af->getAccount() == a);
+        ids.emplace_back(a.accountID);
+    }
+
+    size_t n = 0;
+    AccountFrame::loadAccounts(
+        db.getSession(), ids, [&](LedgerEntry const& le) {
+            auto it = std::find_if(
+                accounts.begin(), accounts.end(), [&](AccountEntry const& a) {
+                    return a.accountID == le.data.account().accountID;
+                });
+            REQUIRE(it != accounts.end());
+            REQUIRE(*it == le.data.account());
+            ++n;
+        });
+    REQUIRE(n == accounts.size());
+}
+
+void
+checkSignersLayout(bool inlineSigners)
+{
+    Config cfg(getTestConfig());
+    cfg.INLINE_ACCOUNT_SIGNERS = inlineSigners;
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+    auto& db = app->getDatabase();
+    REQUIRE(db.hasInlineAccountSigners() == inlineSigners);
+
+    auto accounts = storeAccountsWithSigners(*app, 50);
+    checkAccounts(db, accounts);
+
+    // rows read the same whichever way they were written
+    AccountFrame::migrateSigners(db, !inlineSigners);
+    checkAccounts(db, accounts);
+    AccountFrame::migrateSigners(db, inlineSigners);
+    checkAccounts(db, accounts);
+
+    LedgerDelta delta(app->getLedgerManager().getCurrentLedgerHeader(), db);
+    for (auto& a : accounts)
+    {
+        auto af = AccountFrame::loadAccount(a.accountID, db);
+        if (a.signers.empty())
+        {
+            continue;
+        }
+        a.signers.pop_back();
+        a.numSubEntries--;
+        af->getAccount().signers = a.signers;
+        af->getAccount().numSubEntries = a.numSubEntries;
+        af->setUpdateSigners();
+        af->storeChange(delta, db);
+    }
+    checkAccounts(db, accounts);
+}
+}
+
+TEST_CASE("account signers storage", "[ledger][signers]")
+{
+    SECTION("in the signers table")
+    {
+        checkSignersLayout(false);
+    }
+    SECTION("inline")
+    {
+        checkSignersLayout(true);
+    }
+}
+
+TEST_CASE("account signers storage benchmarking", "[ledger][bench][hide]")
+{
+    size_t const nbAccounts = 5000;
+    size_t const nbRounds = 10;
+    for (bool inlineSigners : {false, true})
+    {
+        Config cfg(getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE));
+        cfg.INLINE_ACCOUNT_SIGNERS = inlineSigners;
+        VirtualClock clock;
+        Application::pointer app = Application::create(clock, cfg);
+        app->start();
+        auto& db = app->getDatabase();
+
+        LOG(INFO) << "Benchmarking " << nbAccounts << " accounts with signers "
+                  << (inlineSigners ? "inline" : "in the signers table");
+        std::vector<AccountEntry> accounts;
+        {
+            TIMED_SCOPE(timerBlkObj, "store");
+            accounts = storeAccountsWithSigners(*app, nbAccounts);
+        }
+        {
+            TIMED_SCOPE(timerBlkObj, "load");
+            for (size_t i = 0; i < nbRounds; ++i)
+            {
+                db.getEntryCache().clear();
+                for (auto const& a : accounts)
+                {
+                    AccountFrame::loadAccount(a.accountID, db);
+                }
+            }
+        }
+        {
+            TIMED_SCOPE(timerBlkObj, "update");
+            LedgerDelta delta(app->getLedgerManager().getCurrentLedgerHeader(),
+                              db);
+            for (auto const& a : accounts)
+            {
+                auto af = AccountFrame::loadAccount(a.accountID, db);
+                af->getAccount().balance++;
+                af->setUpdateSigners();
+                af->storeChange(delta, db);
+            }
+        }
+    }
+}
@@ -8,6 +8,7 @@
 #include "crypto/SHA.h"
 #include "crypto/SecretKey.h"
 #include "database/Database.h"
+#include "ledger/OrderBook.h"
 #include "transactions/ManageOfferOpFrame.h"
 #include "util/types.h"
 
@@ -257,9 +258,32 @@ OfferFrame::loadOffers(StatementContext& prep,
 }
 
 void
-OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
-                           Asset const& selling, Asset const& buying,
+OfferFrame::loadBestOffers(size_t numOffers, Asset const& selling,
+                           Asset const& buying, OfferFrame const* after,
                            vector<OfferFrame::pointer>& retOffers, Database& db)
+{
+    loadOffersByAssetPair(selling, buying, true, numOffers, after,
+                          [&retOffers](LedgerEntry const& of) {
+                              retOffers.emplace_back(
+                                  make_shared<OfferFrame>(of));
+                          },
+                          db);
+}
+
+void
+OfferFrame::loadOffers(Asset const& selling, Asset const& buying,
+                       std::function<void(LedgerEntry const&)> offerProcessor,
+                       Database& db)
+{
+    loadOffersByAssetPair(selling, buying, false, 0, nullptr, offerProcessor,
+                          db);
+}
+
+void
+OfferFrame::loadOffersByAssetPair(
+    Asset const& selling, Asset const& buying, bool limit, size_t numOffers,
+    OfferFrame const* after,
+    std::function<void(LedgerEntry const&)> offerProcessor, Database& db)
 {
     std::string sql = offerColumnSelector;
 
@@ -271,7 +295,8 @@ OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
 
     if (selling.type() == ASSET_TYPE_NATIVE)
     {
-        sql += " WHERE sellingassettype = 0 AND sellingissuer IS NULL";
+        sql += " WHERE sellingassettype = 0 AND sellingassetcode IS NULL AND "
+               "sellingissuer IS NULL";
     }
     else
     {
@@ -298,7 +323,8 @@ OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
 
     if (buying.type() == ASSET_TYPE_NATIVE)
     {
-        sql += " AND buyingassettype = 0 AND buyingissuer IS NULL";
+        sql += " AND buyingassettype = 0 AND buyingassetcode IS NULL AND "
+               "buyingissuer IS NULL";
     }
     else
     {
@@ -321,9 +347,24 @@ OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
         sql += " AND buyingassetcode = :gcur AND buyingissuer = :gi";
     }
 
+    // Pages start right after the last offer of the previous one (keyset
+    // pagination), which the (asset pair, price, offerid) index finds
+    // directly, however deep into the book that is. Spelled out as the
+    // bundled sqlite has no row values for "(price, offerid) > (:p, :id)".
+    double afterPrice = 0;
+    if (after)
+    {
+        afterPrice = after->computePrice();
+        sql += " AND price >= :ap AND (price > :ap2 OR offerid > :aid)";
+    }
+
     // price is an approximation of the actual n/d (truncated math, 15 digits)
     // ordering by offerid gives precendence to older offers for fairness
-    sql += " ORDER BY price, offerid LIMIT :n OFFSET :o";
+    sql += " ORDER BY price, offerid";
+    if (limit)
+    {
+        sql += " LIMIT :n";
+    }
 
     auto prep = db.getPreparedStatement(sql);
     auto& st = prep.statement();
@@ -340,13 +381,20 @@ OfferFrame::loadBestOffers(size_t numOffers, size_t offset,
         st.exchange(use(buyingIssuerStrKey));
     }
 
-    st.exchange(use(numOffers));
-    st.exchange(use(offset));
+    if (after)
+    {
+        st.exchange(use(afterPrice));
+        st.exchange(use(afterPrice));
+        st.exchange(use(after->getOffer().offerID));
+    }
+
+    if (limit)
+    {
+        st.exchange(use(numOffers));
+    }
 
     auto timer = db.getSelectTimer("offer");
-    loadOffers(prep, [&retOffers](LedgerEntry const& of) {
-        retOffers.emplace_back(make_shared<OfferFrame>(of));
-    });
+    loadOffers(prep, offerProcessor);
 }
 
 void
@@ -369,6 +417,27 @@ OfferFrame::loadOffers(AccountID const& accountID,
     });
 }
 
+void
+OfferFrame::loadOffers(soci::session& sess,
+                       std::vector<uint64_t> const& offerIDs,
+                       std::function<void(LedgerEntry const&)> offerProcessor)
+{
+    if (offerIDs.empty())
+    {
+        return;
+    }
+    std::string sql = offerColumnSelector;
+    sql += " WHERE offerid IN ";
+    sql += Database::inListPlaceholders(offerIDs.size());
+    auto prep = Database::prepareStatement(sess, sql);
+    auto& st = prep.statement();
+    for (auto const& id : offerIDs)
+    {
+        st.exchange(use(id));
+    }
+    loadOffers(prep, offerProcessor);
+}
+
 std::unordered_map<AccountID, std::vector<OfferFrame::pointer>>
 OfferFrame::loadAllOffers(Database& db)
 {
@@ -426,9 +495,108 @@ OfferFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
     st.exchange(use(key.offer().offerID));
     st.define_and_bind();
     st.execute(true);
+    db.getOrderBook().deleteOffer(key.offer().offerID);
     delta.deleteEntry(key);
 }
 
+// Columns of an asset in the offers table; the code and issuer are null for
+// the native asset.
+static void
+getAssetFields(Asset const& asset, unsigned int& assetType,
+               std::string& assetCode, std::string& issuerStrKey,
+               soci::indicator& ind)
+{
+    assetType = asset.type();
+    ind = soci::i_null;
+    if (assetType == ASSET_TYPE_CREDIT_ALPHANUM4)
+    {
+        issuerStrKey = KeyUtils::toStrKey(asset.alphaNum4().issuer);
+        assetCodeToStr(asset.alphaNum4().assetCode, assetCode);
+        ind = soci::i_ok;
+    }
+    else if (assetType == ASSET_TYPE_CREDIT_ALPHANUM12)
+    {
+        issuerStrKey = KeyUtils::toStrKey(asset.alphaNum12().issuer);
+        assetCodeToStr(asset.alphaNum12().assetCode, assetCode);
+        ind = soci::i_ok;
+    }
+}
+
+void
+OfferFrame::storeAddBulk(soci::session& sess,
+                         std::vector<LedgerEntry> const& entries)
+{
+    size_t n = entries.size();
+    if (n == 0)
+    {
+        return;
+    }
+    std::vector<std::string> actIDStrKeys(n), sellingAssetCodes(n),
+        sellingIssuerStrKeys(n), buyingAssetCodes(n), buyingIssuerStrKeys(n);
+    std::vector<unsigned int> sellingTypes(n), buyingTypes(n);
+    std::vector<soci::indicator> sellingInds(n), buyingInds(n);
+    std::vector<double> prices(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        auto const& oe = entries[i].data.offer();
+        if (!isValid(oe))
+        {
+            throw std::runtime_error("Invalid asset");
+        }
+        actIDStrKeys[i] = KeyUtils::toStrKey(oe.sellerID);
+        getAssetFields(oe.selling, sellingTypes[i], sellingAssetCodes[i],
+                       sellingIssuerStrKeys[i], sellingInds[i]);
+        getAssetFields(oe.buying, buyingTypes[i], buyingAssetCodes[i],
+                       buyingIssuerStrKeys[i], buyingInds[i]);
+        prices[i] = double(oe.price.n) / double(oe.price.d);
+    }
+
+    Database::executeBatched(
+        sess, n, 14,
+        [](size_t rows) {
+            return "INSERT INTO offers (sellerid,offerid,"
+                   "sellingassettype,sellingassetcode,sellingissuer,"
+                   "buyingassettype,buyingassetcode,buyingissuer,"
+                   "amount,pricen,priced,price,flags,lastmodified) VALUES " +
+                   Database::valuesPlaceholders(rows, 14);
+        },
+        [&](soci::statement& st, size_t i) {
+            auto const& oe = entries[i].data.offer();
+            st.exchange(use(actIDStrKeys[i]));
+            st.exchange(use(oe.offerID));
+            st.exchange(use(sellingTypes[i]));
+            st.exchange(use(sellingAssetCodes[i], sellingInds[i]));
+            st.exchange(use(sellingIssuerStrKeys[i], sellingInds[i]));
+            st.exchange(use(buyingTypes[i]));
+            st.exchange(use(buyingAssetCodes[i], buyingInds[i]));
+            st.exchange(use(buyingIssuerStrKeys[i], buyingInds[i]));
+            st.exchange(use(oe.amount));
+            st.exchange(use(oe.price.n));
+            st.exchange(use(oe.price.d));
+            st.exchange(use(prices[i]));
+            st.exchange(use(oe.flags));
+            st.exchange(use(entries[i].lastModifiedLedgerSeq));
+        });
+}
+
+void
+OfferFrame::storeDeleteBulk(soci::session& sess,
+                            std::vector<LedgerKey> const& keys)
+{
+    if (keys.empty())
+    {
+        return;
+    }
+    Database::executeBatched(sess, keys.size(), 1,
+                             [](size_t rows) {
+                                 return "DELETE FROM offers WHERE offerid IN " +
+                                        Database::inListPlaceholders(rows);
+                             },
+                             [&keys](soci::statement& st, size_t i) {
+                                 st.exchange(use(keys[i].offer().offerID));
+                             });
+}
+
 double
 OfferFrame::computePrice() const
 {
@@ -459,41 +627,14 @@ OfferFrame::storeUpdateHelper(LedgerDelta& delta, Database& db, bool insert)
 
     std::string actIDStrKey = KeyUtils::toStrKey(mOffer.sellerID);
 
-    unsigned int sellingType = mOffer.selling.type();
-    unsigned int buyingType = mOffer.buying.type();
+    unsigned int sellingType, buyingType;
     std::string sellingIssuerStrKey, buyingIssuerStrKey;
     std::string sellingAssetCode, buyingAssetCode;
-    soci::indicator selling_ind = soci::i_null, buying_ind = soci::i_null;
-
-    if (sellingType == ASSET_TYPE_CREDIT_ALPHANUM4)
-    {
-        sellingIssuerStrKey =
-            KeyUtils::toStrKey(mOffer.selling.alphaNum4().issuer);
-        assetCodeToStr(mOffer.selling.alphaNum4().assetCode, sellingAssetCode);
-        selling_ind = soci::i_ok;
-    }
-    else if (sellingType == ASSET_TYPE_CREDIT_ALPHANUM12)
-    {
-        sellingIssuerStrKey =
-            KeyUtils::toStrKey(mOffer.selling.alphaNum12().issuer);
-        assetCodeToStr(mOffer.selling.alphaNum12().assetCode, sellingAssetCode);
-        selling_ind = soci::i_ok;
-    }
-
-    if (buyingType == ASSET_TYPE_CREDIT_ALPHANUM4)
-    {
-        buyingIssuerStrKey =
-            KeyUtils::toStrKey(mOffer.buying.alphaNum4().issuer);
-        assetCodeToStr(mOffer.buying.alphaNum4().assetCode, buyingAssetCode);
-        buying_ind = soci::i_ok;
-    }
-    else if (buyingType == ASSET_TYPE_CREDIT_ALPHANUM12)
-    {
-        buyingIssuerStrKey =
-            KeyUtils::toStrKey(mOffer.buying.alphaNum12().issuer);
-        assetCodeToStr(mOffer.buying.alphaNum12().assetCode, buyingAssetCode);
-        buying_ind = soci::i_ok;
-    }
+    soci::indicator selling_ind, buying_ind;
+    getAssetFields(mOffer.selling, sellingType, sellingAssetCode,
+                   sellingIssuerStrKey, selling_ind);
+    getAssetFields(mOffer.buying, buyingType, buyingAssetCode,
+                   buyingIssuerStrKey, buying_ind);
 
     string sql;
 
@@ -545,6 +686,7 @@ OfferFrame::storeUpdateHelper(LedgerDelta& delta, Database& db, bool insert)
     {
         throw std::runtime_error("could not update SQL");
     }
+    db.getOrderBook().storeOffer(mEntry);
 
     if (insert)
     {
@@ -564,5 +706,6 @@ OfferFrame::dropAll(Database& db)
     db.getSession() << kSQLCreateStatement2;
     db.getSession() << kSQLCreateStatement3;
     db.getSession() << kSQLCreateStatement4;
+    db.getOrderBook().clear();
 }
 }
@@ -24,6 +24,11 @@ class OfferFrame : public EntryFrame
     loadOffers(StatementContext& prep,
                std::function<void(LedgerEntry const&)> offerProcessor);
 
+    static void loadOffersByAssetPair(
+        Asset const& selling, Asset const& buying, bool limit,
+        size_t numOffers, OfferFrame const* after,
+        std::function<void(LedgerEntry const&)> offerProcessor, Database& db);
+
     double computePrice() const;
 
     OfferEntry& mOffer;
@@ -84,19 +89,41 @@ class OfferFrame : public EntryFrame
     static bool exists(Database& db, LedgerKey const& key);
     static uint64_t countObjects(soci::session& sess);
 
+    // bulk helpers for applying buckets: insert `entries`, none of which may
+    // exist yet, or delete the entries with the given keys, with multi-row
+    // statements
+    static void storeAddBulk(soci::session& sess,
+                             std::vector<LedgerEntry> const& entries);
+    static void storeDeleteBulk(soci::session& sess,
+                                std::vector<LedgerKey> const& keys);
+
     // database utilities
     static pointer loadOffer(AccountID const& accountID, uint64_t offerID,
                              Database& db, LedgerDelta* delta = nullptr);
 
-    static void loadBestOffers(size_t numOffers, size_t offset,
-                               Asset const& pays, Asset const& gets,
+    // load up to `numOffers` offers selling `selling` for `buying`, best
+    // first, starting after `after` if it is not null
+    static void loadBestOffers(size_t numOffers, Asset const& selling,
+                               Asset const& buying, OfferFrame const* after,
                                std::vector<OfferFrame::pointer>& retOffers,
                                Database& db);
 
+    // load all the offers selling `selling` for `buying`, best first
+    static void
+    loadOffers(Asset const& selling, Asset const& buying,
+               std::function<void(LedgerEntry const&)> offerProcessor,
+               Database& db);
+
     static void loadOffers(AccountID const& accountID,
                            std::vector<OfferFrame::pointer>& retOffers,
                            Database& db);
 
+    // load the offers with the given IDs through `sess`, which need not be
+    // the main session
+    static void
+    loadOffers(soci::session& sess, std::vector<uint64_t> const& offerIDs,
+               std::function<void(LedgerEntry const&)> offerProcessor);
+
     // load all offers from the database (very slow)
     static std::unordered_map<AccountID, std::vector<OfferFrame::pointer>>
     loadAllOffers(Database& db);
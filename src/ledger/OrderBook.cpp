@@ -0,0 +1,275 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/OrderBook.h"
+#include "bucket/LedgerCmp.h"
+#include "database/Database.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+#include <cassert>
+
+namespace stellar
+{
+
+using xdr::operator<;
+
+bool
+OrderBook::AssetPairCmp::operator()(AssetPair const& a,
+                                    AssetPair const& b) const
+{
+    if (a.first < b.first)
+    {
+        return true;
+    }
+    if (b.first < a.first)
+    {
+        return false;
+    }
+    return a.second < b.second;
+}
+
+bool
+OrderBook::OfferKey::operator<(OfferKey const& other) const
+{
+    if (mPrice != other.mPrice)
+    {
+        return mPrice < other.mPrice;
+    }
+    return mOfferID < other.mOfferID;
+}
+
+OrderBook::OrderBook(medida::MetricsRegistry& metrics, bool enabled)
+    : mEnabled(enabled)
+    , mLoadTimer(metrics.NewTimer({"order-book", "pair", "load"}))
+{
+}
+
+OrderBook::OfferKey
+OrderBook::getKey(OfferEntry const& offer)
+{
+    // must be computed the same way as the price column the database orders
+    // by (see OfferFrame::computePrice) for both orders to agree
+    return OfferKey{double(offer.price.n) / double(offer.price.d),
+                    offer.offerID};
+}
+
+void
+OrderBook::loadBestOffers(size_t numOffers, Asset const& selling,
+                          Asset const& buying, OfferFrame const* after,
+                          std::vector<OfferFrame::pointer>& retOffers,
+                          Database& db)
+{
+    if (!mEnabled)
+    {
+        throw std::runtime_error("in-memory order book is disabled");
+    }
+
+    auto& offers = getOffers(selling, buying, db);
+    auto it = after ? offers.upper_bound(getKey(after->getOffer()))
+                    : offers.begin();
+    for (; it != offers.end() && numOffers > 0; ++it, --numOffers)
+    {
+        retOffers.emplace_back(std::make_shared<OfferFrame>(it->second));
+    }
+}
+
+OrderBook::Offers&
+OrderBook::getOffers(Asset const& selling, Asset const& buying, Database& db)
+{
+    AssetPair pair(selling, buying);
+    auto it = mPairs.find(pair);
+    if (it != mPairs.end())
+    {
+        return it->second;
+    }
+
+    it = mPairs.emplace(pair, Offers()).first;
+    try
+    {
+        auto timer = mLoadTimer.TimeScope();
+        OfferFrame::loadOffers(selling, buying,
+                               [this, it](LedgerEntry const& le) {
+                                   auto key = getKey(le.data.offer());
+                                   it->second.emplace(key, le);
+                                   mIndex[key.mOfferID] = Location{it, key};
+                               },
+                               db);
+    }
+    catch (...)
+    {
+        evict(pair);
+        throw;
+    }
+
+    if (!mScopes.empty())
+    {
+        mScopes.back().mLoaded.emplace_back(pair);
+    }
+    return it->second;
+}
+
+void
+OrderBook::storeOffer(LedgerEntry const& offer)
+{
+    if (!mEnabled)
+    {
+        return;
+    }
+
+    auto const& oe = offer.data.offer();
+    bool loaded = mPairs.find(AssetPair(oe.selling, oe.buying)) != mPairs.end();
+    if (!loaded && mIndex.find(oe.offerID) == mIndex.end())
+    {
+        // the book does not cover this offer, before or after the change
+        return;
+    }
+    saveUndo(oe.offerID);
+    erase(oe.offerID);
+    insert(offer);
+}
+
+void
+OrderBook::deleteOffer(uint64_t offerID)
+{
+    if (mIndex.find(offerID) == mIndex.end())
+    {
+        return;
+    }
+    saveUndo(offerID);
+    erase(offerID);
+}
+
+void
+OrderBook::beginScope()
+{
+    if (mEnabled)
+    {
+        mScopes.emplace_back();
+    }
+}
+
+void
+OrderBook::commitScope()
+{
+    if (!mEnabled)
+    {
+        return;
+    }
+    assert(!mScopes.empty());
+    auto scope = std::move(mScopes.back());
+    mScopes.pop_back();
+    if (!mScopes.empty())
+    {
+        // offers the outer scope already saw keep their older state
+        auto& outer = mScopes.back();
+        for (auto& u : scope.mUndo)
+        {
+            outer.mUndo.emplace(u.first, std::move(u.second));
+        }
+        outer.mLoaded.insert(outer.mLoaded.end(), scope.mLoaded.begin(),
+                             scope.mLoaded.end());
+    }
+}
+
+void
+OrderBook::rollbackScope()
+{
+    if (!mEnabled)
+    {
+        return;
+    }
+    assert(!mScopes.empty());
+    auto scope = std::move(mScopes.back());
+    mScopes.pop_back();
+
+    for (auto const& pair : scope.mLoaded)
+    {
+        evict(pair);
+    }
+    for (auto const& u : scope.mUndo)
+    {
+        erase(u.first);
+        if (u.second.mPresent)
+        {
+            insert(u.second.mEntry);
+        }
+    }
+}
+
+void
+OrderBook::clear()
+{
+    mPairs.clear();
+    mIndex.clear();
+    for (auto& s : mScopes)
+    {
+        s.mUndo.clear();
+        s.mLoaded.clear();
+    }
+}
+
+void
+OrderBook::saveUndo(uint64_t offerID)
+{
+    if (mScopes.empty())
+    {
+        return;
+    }
+    auto& undo = mScopes.back().mUndo;
+    if (undo.find(offerID) != undo.end())
+    {
+        return;
+    }
+    auto it = mIndex.find(offerID);
+    if (it != mIndex.end())
+    {
+        undo.emplace(offerID,
+                     Undo{true, it->second.mPair->second.at(it->second.mKey)});
+    }
+    else
+    {
+        undo.emplace(offerID, Undo{false, LedgerEntry()});
+    }
+}
+
+void
+OrderBook::insert(LedgerEntry const& offer)
+{
+    auto const& oe = offer.data.offer();
+    auto it = mPairs.find(AssetPair(oe.selling, oe.buying));
+    if (it == mPairs.end())
+    {
+        return;
+    }
+    auto key = getKey(oe);
+    it->second.emplace(key, offer);
+    mIndex[oe.offerID] = Location{it, key};
+}
+
+void
+OrderBook::erase(uint64_t offerID)
+{
+    auto it = mIndex.find(offerID);
+    if (it != mIndex.end())
+    {
+        it->second.mPair->second.erase(it->second.mKey);
+        mIndex.erase(it);
+    }
+}
+
+void
+OrderBook::evict(AssetPair const& pair)
+{
+    auto it = mPairs.find(pair);
+    if (it == mPairs.end())
+    {
+        return;
+    }
+    for (auto const& o : it->second)
+    {
+        mIndex.erase(o.first.mOfferID);
+    }
+    mPairs.erase(it);
+}
+}
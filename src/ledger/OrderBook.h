@@ -0,0 +1,135 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/OfferFrame.h"
+#include "overlay/StellarXDR.h"
+#include "util/NonCopyable.h"
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace medida
+{
+class MetricsRegistry;
+class Timer;
+}
+
+namespace stellar
+{
+class Database;
+
+/**
+ * In-memory copy of the offers of the asset pairs offers get crossed on,
+ * kept in the order they are crossed in: by price, then by offer ID, like
+ * OfferFrame::loadBestOffers.
+ *
+ * A pair is loaded from the database the first time its offers are asked
+ * for (so the book is rebuilt lazily after a restart); from then on it is
+ * kept in step with the offers table by OfferFrame's store methods.
+ *
+ * Changes are scoped like the LedgerDeltas that make them, and thus like
+ * the database transactions that go with those: rolling back a nested delta
+ * restores the offers it changed, and drops the pairs loaded while it was
+ * open as they were read from state that is gone. Anything that changes the
+ * offers table behind the book's back (applying buckets, rolling back an
+ * outermost delta) clears the book instead.
+ *
+ * When disabled, the book holds nothing and all its methods but
+ * loadBestOffers are no-ops. It is only used from the main thread.
+ */
+class OrderBook : NonMovableOrCopyable
+{
+  public:
+    OrderBook(medida::MetricsRegistry& metrics, bool enabled);
+
+    bool
+    isEnabled() const
+    {
+        return mEnabled;
+    }
+
+    // Appends to `retOffers` up to `numOffers` offers selling `selling` for
+    // `buying`, best first, starting after `after` if it is not null.
+    void loadBestOffers(size_t numOffers, Asset const& selling,
+                        Asset const& buying, OfferFrame const* after,
+                        std::vector<OfferFrame::pointer>& retOffers,
+                        Database& db);
+
+    // Record that `offer` was stored to, or the offer with ID `offerID`
+    // deleted from, the database.
+    void storeOffer(LedgerEntry const& offer);
+    void deleteOffer(uint64_t offerID);
+
+    void beginScope();
+    void commitScope();
+    void rollbackScope();
+
+    void clear();
+
+    // number of offers held
+    size_t
+    size() const
+    {
+        return mIndex.size();
+    }
+
+  private:
+    // selling, buying
+    typedef std::pair<Asset, Asset> AssetPair;
+
+    struct AssetPairCmp
+    {
+        bool operator()(AssetPair const& a, AssetPair const& b) const;
+    };
+
+    struct OfferKey
+    {
+        double mPrice;
+        uint64_t mOfferID;
+
+        bool operator<(OfferKey const& other) const;
+    };
+
+    typedef std::map<OfferKey, LedgerEntry> Offers;
+    typedef std::map<AssetPair, Offers, AssetPairCmp> Pairs;
+
+    struct Location
+    {
+        Pairs::iterator mPair;
+        OfferKey mKey;
+    };
+
+    // State of an offer in the book when a scope first changed it, to
+    // restore on rollback; mPresent is false if the book did not have it.
+    struct Undo
+    {
+        bool mPresent;
+        LedgerEntry mEntry;
+    };
+
+    struct Scope
+    {
+        std::map<uint64_t, Undo> mUndo;
+        std::vector<AssetPair> mLoaded;
+    };
+
+    bool const mEnabled;
+    Pairs mPairs;
+    std::unordered_map<uint64_t, Location> mIndex;
+    std::vector<Scope> mScopes;
+    medida::Timer& mLoadTimer;
+
+    static OfferKey getKey(OfferEntry const& offer);
+
+    Offers& getOffers(Asset const& selling, Asset const& buying,
+                      Database& db);
+    void saveUndo(uint64_t offerID);
+    void insert(LedgerEntry const& offer);
+    void erase(uint64_t offerID);
+    void evict(AssetPair const& pair);
+};
+}
@@ -173,7 +173,12 @@ TrustFrame::isValid() const
 bool
 TrustFrame::exists(Database& db, LedgerKey const& key)
 {
-    if (cachedEntryExists(key, db) && getCachedEntry(key, db) != nullptr)
+    std::shared_ptr<LedgerEntry const> p;
+    if (getPendingEntry(key, p, db))
+    {
+        return p != nullptr;
+    }
+    if (getCachedEntry(key, p, db) && p)
     {
         return true;
     }
@@ -214,6 +219,12 @@ TrustFrame::storeDelete(LedgerDelta& delta, Database& db, LedgerKey const& key)
 {
     flushCachedEntry(key, db);
 
+    if (storePendingDelete(key, db))
+    {
+        delta.deleteEntry(key);
+        return;
+    }
+
     std::string actIDStrKey, issuerStrKey, assetCode;
     getKeyFields(key, actIDStrKey, issuerStrKey, assetCode);
 
@@ -241,6 +252,12 @@ TrustFrame::storeChange(LedgerDelta& delta, Database& db)
 
     touch(delta);
 
+    if (storePending(db))
+    {
+        delta.modEntry(*this);
+        return;
+    }
+
     std::string actIDStrKey, issuerStrKey, assetCode;
     getKeyFields(key, actIDStrKey, issuerStrKey, assetCode);
 
@@ -285,6 +302,12 @@ TrustFrame::storeAdd(LedgerDelta& delta, Database& db)
 
     touch(delta);
 
+    if (storePending(db))
+    {
+        delta.addEntry(*this);
+        return;
+    }
+
     std::string actIDStrKey, issuerStrKey, assetCode;
     unsigned int assetType = getKey().trustLine().asset.type();
     getKeyFields(getKey(), actIDStrKey, issuerStrKey, assetCode);
@@ -317,6 +340,79 @@ TrustFrame::storeAdd(LedgerDelta& delta, Database& db)
     delta.addEntry(*this);
 }
 
+void
+TrustFrame::storeAddBulk(soci::session& sess,
+                         std::vector<LedgerEntry> const& entries)
+{
+    size_t n = entries.size();
+    if (n == 0)
+    {
+        return;
+    }
+    std::vector<std::string> actIDStrKeys(n), issuerStrKeys(n), assetCodes(n);
+    std::vector<unsigned int> assetTypes(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        auto const& tl = entries[i].data.trustLine();
+        if (!isValid(tl))
+        {
+            throw std::runtime_error("Invalid TrustEntry");
+        }
+        auto key = LedgerEntryKey(entries[i]);
+        getKeyFields(key, actIDStrKeys[i], issuerStrKeys[i], assetCodes[i]);
+        assetTypes[i] = tl.asset.type();
+    }
+
+    Database::executeBatched(
+        sess, n, 8,
+        [](size_t rows) {
+            return "INSERT INTO trustlines "
+                   "(accountid, assettype, issuer, assetcode, balance, tlimit, "
+                   "flags, lastmodified) VALUES " +
+                   Database::valuesPlaceholders(rows, 8);
+        },
+        [&](soci::statement& st, size_t i) {
+            auto const& tl = entries[i].data.trustLine();
+            st.exchange(use(actIDStrKeys[i]));
+            st.exchange(use(assetTypes[i]));
+            st.exchange(use(issuerStrKeys[i]));
+            st.exchange(use(assetCodes[i]));
+            st.exchange(use(tl.balance));
+            st.exchange(use(tl.limit));
+            st.exchange(use(tl.flags));
+            st.exchange(use(entries[i].lastModifiedLedgerSeq));
+        });
+}
+
+void
+TrustFrame::storeDeleteBulk(soci::session& sess,
+                            std::vector<LedgerKey> const& keys)
+{
+    size_t n = keys.size();
+    if (n == 0)
+    {
+        return;
+    }
+    std::vector<std::string> actIDStrKeys(n), issuerStrKeys(n), assetCodes(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        getKeyFields(keys[i], actIDStrKeys[i], issuerStrKeys[i], assetCodes[i]);
+    }
+
+    Database::executeBatched(
+        sess, n, 3,
+        [](size_t rows) {
+            return "DELETE FROM trustlines WHERE " +
+                   Database::anyRowCondition(
+                       {"accountid", "issuer", "assetcode"}, rows);
+        },
+        [&](soci::statement& st, size_t i) {
+            st.exchange(use(actIDStrKeys[i]));
+            st.exchange(use(issuerStrKeys[i]));
+            st.exchange(use(assetCodes[i]));
+        });
+}
+
 static const char* trustLineColumnSelector =
     "SELECT "
     "accountid,assettype,issuer,assetcode,tlimit,balance,flags,lastmodified "
@@ -358,18 +454,20 @@ TrustFrame::loadTrustLine(AccountID const& accountID, Asset const& asset,
     key.type(TRUSTLINE);
     key.trustLine().accountID = accountID;
     key.trustLine().asset = asset;
-    if (cachedEntryExists(key, db))
+    std::shared_ptr<LedgerEntry const> p;
+    if (getPendingEntry(key, p, db) || (getCachedEntry(key, p, db) && p))
     {
-        auto p = getCachedEntry(key, db);
-        if (p)
+        if (!p)
         {
-            pointer ret = std::make_shared<TrustFrame>(*p);
-            if (delta)
-            {
-                delta->recordEntry(*ret);
-            }
-            return ret;
+            // deleted earlier in the ledger
+            return nullptr;
         }
+        pointer ret = std::make_shared<TrustFrame>(*p);
+        if (delta)
+        {
+            delta->recordEntry(*ret);
+        }
+        return ret;
     }
 
     std::string accStr, issuerStr, assetStr;
@@ -501,6 +599,33 @@ TrustFrame::loadLines(AccountID const& accountID,
     });
 }
 
+void
+TrustFrame::loadLines(soci::session& sess,
+                      std::vector<AccountID> const& accountIDs,
+                      std::function<void(LedgerEntry const&)> trustProcessor)
+{
+    if (accountIDs.empty())
+    {
+        return;
+    }
+    std::vector<std::string> actIDStrKeys;
+    for (auto const& id : accountIDs)
+    {
+        actIDStrKeys.emplace_back(KeyUtils::toStrKey(id));
+    }
+
+    auto query = std::string(trustLineColumnSelector);
+    query += " WHERE accountid IN ";
+    query += Database::inListPlaceholders(actIDStrKeys.size());
+    auto prep = Database::prepareStatement(sess, query);
+    auto& st = prep.statement();
+    for (auto const& k : actIDStrKeys)
+    {
+        st.exchange(use(k));
+    }
+    loadLines(prep, trustProcessor);
+}
+
 std::unordered_map<AccountID, std::vector<TrustFrame::pointer>>
 TrustFrame::loadAllLines(Database& db)
 {
@@ -66,6 +66,14 @@ class TrustFrame : public EntryFrame
     static bool exists(Database& db, LedgerKey const& key);
     static uint64_t countObjects(soci::session& sess);
 
+    // bulk helpers for applying buckets: insert `entries`, none of which may
+    // exist yet, or delete the entries with the given keys, with multi-row
+    // statements
+    static void storeAddBulk(soci::session& sess,
+                             std::vector<LedgerEntry> const& entries);
+    static void storeDeleteBulk(soci::session& sess,
+                                std::vector<LedgerKey> const& keys);
+
     // returns the specified trustline or a generated one for issuers
     static pointer loadTrustLine(AccountID const& accountID, Asset const& asset,
                                  Database& db, LedgerDelta* delta = nullptr);
@@ -80,6 +88,12 @@ class TrustFrame : public EntryFrame
                           std::vector<TrustFrame::pointer>& retLines,
                           Database& db);
 
+    // loads the trust lines of all the given accounts through `sess`, which
+    // need not be the main session
+    static void
+    loadLines(soci::session& sess, std::vector<AccountID> const& accountIDs,
+              std::function<void(LedgerEntry const&)> trustProcessor);
+
     // loads ALL trust lines from the database (very slow!)
     static std::unordered_map<AccountID, std::vector<TrustFrame::pointer>>
     loadAllLines(Database& db);
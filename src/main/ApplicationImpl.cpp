@@ -38,6 +38,7 @@
 #include "util/TmpDir.h"
 #include "util/make_unique.h"
 
+#include <exception>
 #include <set>
 #include <string>
 
@@ -59,6 +60,12 @@ ApplicationImpl::ApplicationImpl(VirtualClock& clock, Config const& cfg)
     , mAppStateCurrent(mMetrics->NewCounter({"app", "state", "current"}))
     , mAppStateChanges(mMetrics->NewTimer({"app", "state", "changes"}))
     , mLastStateChange(clock.now())
+    , mVerifySigHit(
+          mMetrics->NewMeter({"crypto", "verify", "hit"}, "signature"))
+    , mVerifySigMiss(
+          mMetrics->NewMeter({"crypto", "verify", "miss"}, "signature"))
+    , mVerifySigTotal(
+          mMetrics->NewMeter({"crypto", "verify", "total"}, "signature"))
 {
 #ifdef SIGQUIT
     mStopSignals.add(SIGQUIT);
@@ -71,6 +78,10 @@ ApplicationImpl::ApplicationImpl(VirtualClock& clock, Config const& cfg)
 
     mNetworkID = sha256(mConfig.NETWORK_PASSPHRASE);
 
+    PubKeyUtils::resizeVerifySigCache(mConfig.VERIFY_SIG_CACHE_SIZE);
+    PubKeyUtils::getVerifySigCacheCounts(mLastVerifySigHits,
+                                         mLastVerifySigMisses);
+
     unsigned t = std::thread::hardware_concurrency();
     LOG(DEBUG) << "Application constructing "
                << "(worker threads: " << t << ")";
@@ -413,9 +424,49 @@ void
 ApplicationImpl::checkDB()
 {
     getClock().getIOService().post([this] {
-        checkDBAgainstBuckets(this->getMetrics(), this->getBucketManager(),
-                              this->getDatabase(),
-                              this->getBucketManager().getBucketList());
+        auto buckets = getBucketManager().getBucketList().getBuckets();
+        auto& db = getDatabase();
+        if (!db.canUsePool())
+        {
+            checkDBAgainstBuckets(getMetrics(), buckets, db.getSession());
+            return;
+        }
+
+        // Open a read transaction on a pooled connection and read through it
+        // once here, on the main thread, to pin its snapshot of the database
+        // to the ledger the buckets were taken at. The check itself then
+        // runs on a worker thread, and any failure is rethrown on the main
+        // thread as if the check had run there.
+        auto sess = std::make_shared<soci::session>(db.getPool());
+        auto tx = std::make_shared<soci::transaction>(*sess);
+        int nStates = 0;
+        *sess << "SELECT COUNT(*) FROM storestate", soci::into(nStates);
+
+        getWorkerIOService().post([this, buckets, sess, tx]() mutable {
+            std::exception_ptr err;
+            try
+            {
+                checkDBAgainstBuckets(getMetrics(), buckets, *sess);
+            }
+            catch (...)
+            {
+                err = std::current_exception();
+            }
+            // Give the connection back to the pool before reporting, so
+            // that it is free again by the time the main thread hears of it.
+            tx->rollback();
+            tx.reset();
+            sess.reset();
+            getClock().getIOService().post([this, err]() {
+                getMetrics()
+                    .NewMeter({"bucket", "checkdb", "finished"}, "check")
+                    .Mark();
+                if (err)
+                {
+                    std::rethrow_exception(err);
+                }
+            });
+        });
     });
 }
 
@@ -514,17 +565,16 @@ ApplicationImpl::syncOwnMetrics()
         mLastStateChange = now;
     }
 
-    // Flush crypto pure-global-cache stats. They don't belong
-    // to a single app instance but first one to flush will claim
-    // them.
-    uint64_t vhit = 0, vmiss = 0, vignore = 0;
-    PubKeyUtils::flushVerifySigCacheCounts(vhit, vmiss, vignore);
-    mMetrics->NewMeter({"crypto", "verify", "hit"}, "signature").Mark(vhit);
-    mMetrics->NewMeter({"crypto", "verify", "miss"}, "signature").Mark(vmiss);
-    mMetrics->NewMeter({"crypto", "verify", "ignore"}, "signature")
-        .Mark(vignore);
-    mMetrics->NewMeter({"crypto", "verify", "total"}, "signature")
-        .Mark(vhit + vmiss + vignore);
+    // The verify-sig cache doesn't belong to a single app instance: each
+    // one reports what the cache did since it last looked.
+    uint64_t vhit = 0, vmiss = 0;
+    PubKeyUtils::getVerifySigCacheCounts(vhit, vmiss);
+    mVerifySigHit.Mark(vhit - mLastVerifySigHits);
+    mVerifySigMiss.Mark(vmiss - mLastVerifySigMisses);
+    mVerifySigTotal.Mark(vhit + vmiss - mLastVerifySigHits -
+                         mLastVerifySigMisses);
+    mLastVerifySigHits = vhit;
+    mLastVerifySigMisses = vmiss;
 
     // Similarly, flush global process-table stats.
     mMetrics->NewCounter({"process", "memory", "handles"})
@@ -14,6 +14,7 @@
 namespace medida
 {
 class Counter;
+class Meter;
 class Timer;
 }
 
@@ -146,6 +147,12 @@ class ApplicationImpl : public Application
     medida::Timer& mAppStateChanges;
     VirtualClock::time_point mLastStateChange;
 
+    medida::Meter& mVerifySigHit;
+    medida::Meter& mVerifySigMiss;
+    medida::Meter& mVerifySigTotal;
+    uint64_t mLastVerifySigHits;
+    uint64_t mLastVerifySigMisses;
+
     Hash mNetworkID;
 
     void shutdownMainIOService();
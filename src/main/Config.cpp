@@ -49,6 +49,7 @@ Config::Config() : NODE_SEED(SecretKey::random())
 
     LOG_FILE_PATH = "stellar-core.%datetime{%Y.%M.%d-%H:%m:%s}.log";
     BUCKET_DIR_PATH = "buckets";
+    COMPRESS_BUCKETS = false;
 
     DESIRED_BASE_FEE = 100;
     DESIRED_MAX_TX_PER_LEDGER = 50;
@@ -64,6 +65,11 @@ Config::Config() : NODE_SEED(SecretKey::random())
     MINIMUM_IDLE_PERCENT = 0;
 
     MAX_CONCURRENT_SUBPROCESSES = 16;
+    BUCKET_MERGE_THREADS = 0;
+    ENTRY_CACHE_BYTES = 32 * 1024 * 1024;
+    VERIFY_SIG_CACHE_SIZE = 65536;
+    IN_MEMORY_ORDER_BOOK = true;
+    INLINE_ACCOUNT_SIGNERS = true;
     PARANOID_MODE = false;
     NODE_IS_VALIDATOR = false;
 
@@ -372,6 +378,21 @@ Config::load(std::string const& filename)
                 }
                 BUCKET_DIR_PATH = item.second->as<std::string>()->value();
             }
+            else if (item.first == "COMPRESS_BUCKETS")
+            {
+                if (!item.second->as<bool>())
+                {
+                    throw std::invalid_argument("invalid COMPRESS_BUCKETS");
+                }
+                COMPRESS_BUCKETS = item.second->as<bool>()->value();
+#ifndef USE_ZLIB
+                if (COMPRESS_BUCKETS)
+                {
+                    throw std::invalid_argument(
+                        "COMPRESS_BUCKETS needs a build with zlib");
+                }
+#endif
+            }
             else if (item.first == "NODE_NAMES")
             {
                 if (!item.second->is_array())
@@ -502,6 +523,57 @@ Config::load(std::string const& filename)
                 MAX_CONCURRENT_SUBPROCESSES =
                     (size_t)item.second->as<int64_t>()->value();
             }
+            else if (item.first == "BUCKET_MERGE_THREADS")
+            {
+                // one thread is always held back from the deep levels, so
+                // there must be at least two
+                if (!item.second->as<int64_t>() ||
+                    item.second->as<int64_t>()->value() < 0 ||
+                    item.second->as<int64_t>()->value() == 1)
+                {
+                    throw std::invalid_argument("invalid BUCKET_MERGE_THREADS");
+                }
+                BUCKET_MERGE_THREADS =
+                    (size_t)item.second->as<int64_t>()->value();
+            }
+            else if (item.first == "ENTRY_CACHE_BYTES")
+            {
+                if (!item.second->as<int64_t>() ||
+                    item.second->as<int64_t>()->value() < 0)
+                {
+                    throw std::invalid_argument("invalid ENTRY_CACHE_BYTES");
+                }
+                ENTRY_CACHE_BYTES =
+                    (size_t)item.second->as<int64_t>()->value();
+            }
+            else if (item.first == "VERIFY_SIG_CACHE_SIZE")
+            {
+                if (!item.second->as<int64_t>() ||
+                    item.second->as<int64_t>()->value() < 0)
+                {
+                    throw std::invalid_argument(
+                        "invalid VERIFY_SIG_CACHE_SIZE");
+                }
+                VERIFY_SIG_CACHE_SIZE =
+                    (size_t)item.second->as<int64_t>()->value();
+            }
+            else if (item.first == "IN_MEMORY_ORDER_BOOK")
+            {
+                if (!item.second->as<bool>())
+                {
+                    throw std::invalid_argument("invalid IN_MEMORY_ORDER_BOOK");
+                }
+                IN_MEMORY_ORDER_BOOK = item.second->as<bool>()->value();
+            }
+            else if (item.first == "INLINE_ACCOUNT_SIGNERS")
+            {
+                if (!item.second->as<bool>())
+                {
+                    throw std::invalid_argument(
+                        "invalid INLINE_ACCOUNT_SIGNERS");
+                }
+                INLINE_ACCOUNT_SIGNERS = item.second->as<bool>()->value();
+            }
             else if (item.first == "MINIMUM_IDLE_PERCENT")
             {
                 if (!item.second->as<int64_t>() ||
@@ -125,6 +125,9 @@ class Config : public std::enable_shared_from_this<Config>
     std::string VERSION_STR;
     std::string LOG_FILE_PATH;
     std::string BUCKET_DIR_PATH;
+    // Whether buckets written locally are stored block-compressed. Bucket
+    // hashes and published buckets are unaffected. Needs USE_ZLIB.
+    bool COMPRESS_BUCKETS;
     uint32_t DESIRED_BASE_FEE;     // in stroops
     uint32_t DESIRED_BASE_RESERVE; // in stroops
     uint32_t DESIRED_MAX_TX_PER_LEDGER;
@@ -158,6 +161,27 @@ class Config : public std::enable_shared_from_this<Config>
     // process-management config
     size_t MAX_CONCURRENT_SUBPROCESSES;
 
+    // Number of threads dedicated to merging buckets in the BucketList. 0
+    // means one per hardware thread, with a minimum of 2; otherwise it must
+    // be at least 2.
+    size_t BUCKET_MERGE_THREADS;
+
+    // Memory budget, in bytes, of the cache of ledger entries loaded from
+    // the database.
+    size_t ENTRY_CACHE_BYTES;
+
+    // Number of signature verification outcomes cached. The cache is shared
+    // by the whole process.
+    size_t VERIFY_SIG_CACHE_SIZE;
+
+    // Whether offers are crossed from an in-memory copy of the order book
+    // rather than by paging through the offers table.
+    bool IN_MEMORY_ORDER_BOOK;
+
+    // Whether the signers of accounts are stored inline in the accounts
+    // table rather than in a table of their own.
+    bool INLINE_ACCOUNT_SIGNERS;
+
     // Setting this causes all sorts of extra checks to occur
     // the overhead may cause slower systems to not perform as fast
     // as the rest of the network, caution is advised when using this.
@@ -3,6 +3,7 @@
 #include "transactions/SignatureUtils.h"
 #include "util/Fs.h"
 #include "util/XDRStream.h"
+#include <fstream>
 #include <iostream>
 #include <regex>
 #include <xdrpp/printer.h>
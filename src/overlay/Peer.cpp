@@ -750,22 +750,30 @@ Peer::recvTransaction(StellarMessage const& msg)
         mApp.getNetworkID(), msg.transaction());
     if (transaction)
     {
-        // add it to our current set
-        // and make sure it is valid
-        auto recvRes = mApp.getHerder().recvTransaction(transaction);
-
-        if (recvRes == Herder::TX_STATUS_PENDING ||
-            recvRes == Herder::TX_STATUS_DUPLICATE)
-        {
-            // record that this peer sent us this transaction
-            mApp.getOverlayManager().recvFloodedMsg(msg, shared_from_this());
-
-            if (recvRes == Herder::TX_STATUS_PENDING)
-            {
-                // if it's a new transaction, broadcast it
-                mApp.getOverlayManager().broadcastMessage(msg);
-            }
-        }
+        // add it to our current set once its signatures are checked, and
+        // make sure it is valid; we may have dropped the peer by then
+        Application& app = mApp;
+        std::weak_ptr<Peer> weak = shared_from_this();
+        app.getHerder().recvTransaction(
+            transaction,
+            [&app, weak, msg](Herder::TransactionSubmitStatus recvRes) {
+                if (recvRes == Herder::TX_STATUS_PENDING ||
+                    recvRes == Herder::TX_STATUS_DUPLICATE)
+                {
+                    // record that this peer sent us this transaction
+                    auto self = weak.lock();
+                    if (self)
+                    {
+                        app.getOverlayManager().recvFloodedMsg(msg, self);
+                    }
+
+                    if (recvRes == Herder::TX_STATUS_PENDING)
+                    {
+                        // if it's a new transaction, broadcast it
+                        app.getOverlayManager().broadcastMessage(msg);
+                    }
+                }
+            });
     }
 }
 
@@ -25,6 +25,24 @@ AllowTrustOpFrame::getNeededThreshold() const
     return mSourceAccount->getLowThreshold();
 }
 
+Asset
+AllowTrustOpFrame::getAsset() const
+{
+    Asset ci;
+    ci.type(mAllowTrust.asset.type());
+    if (mAllowTrust.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM4)
+    {
+        ci.alphaNum4().assetCode = mAllowTrust.asset.assetCode4();
+        ci.alphaNum4().issuer = getSourceID();
+    }
+    else if (mAllowTrust.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM12)
+    {
+        ci.alphaNum12().assetCode = mAllowTrust.asset.assetCode12();
+        ci.alphaNum12().issuer = getSourceID();
+    }
+    return ci;
+}
+
 bool
 AllowTrustOpFrame::doApply(Application& app, LedgerDelta& delta,
                            LedgerManager& ledgerManager)
@@ -65,18 +83,7 @@ AllowTrustOpFrame::doApply(Application& app, LedgerDelta& delta,
         return false;
     }
 
-    Asset ci;
-    ci.type(mAllowTrust.asset.type());
-    if (mAllowTrust.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM4)
-    {
-        ci.alphaNum4().assetCode = mAllowTrust.asset.assetCode4();
-        ci.alphaNum4().issuer = getSourceID();
-    }
-    else if (mAllowTrust.asset.type() == ASSET_TYPE_CREDIT_ALPHANUM12)
-    {
-        ci.alphaNum12().assetCode = mAllowTrust.asset.assetCode12();
-        ci.alphaNum12().issuer = getSourceID();
-    }
+    Asset ci = getAsset();
 
     Database& db = ledgerManager.getDatabase();
     TrustFrame::pointer trustLine;
@@ -141,4 +148,13 @@ AllowTrustOpFrame::doCheckValid(Application& app)
 
     return true;
 }
+
+void
+AllowTrustOpFrame::insertLedgerKeysToPrefetch(
+    std::vector<LedgerKey>& keys) const
+{
+    OperationFrame::insertLedgerKeysToPrefetch(keys);
+    // only the trust line is loaded, not the trustor's account
+    addTrustLineKey(keys, mAllowTrust.trustor, getAsset());
+}
 }
@@ -19,6 +19,9 @@ class AllowTrustOpFrame : public OperationFrame
 
     AllowTrustOp const& mAllowTrust;
 
+    // the asset of the trust line, which the source account issues
+    Asset getAsset() const;
+
   public:
     AllowTrustOpFrame(Operation const& op, OperationResult& res,
                       TransactionFrame& parentTx);
@@ -26,6 +29,8 @@ class AllowTrustOpFrame : public OperationFrame
     bool doApply(Application& app, LedgerDelta& delta,
                  LedgerManager& ledgerManager) override;
     bool doCheckValid(Application& app) override;
+    void
+    insertLedgerKeysToPrefetch(std::vector<LedgerKey>& keys) const override;
 
     static AllowTrustResultCode
     getInnerCode(OperationResult const& res)
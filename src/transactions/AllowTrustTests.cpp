@@ -10,9 +10,11 @@
 #include "test/TxTests.h"
 #include "test/test.h"
 #include "util/Timer.h"
+#include <algorithm>
 
 using namespace stellar;
 using namespace stellar::txtest;
+using xdr::operator==;
 
 TEST_CASE("allow trust", "[tx][allowtrust]")
 {
@@ -72,6 +74,30 @@ TEST_CASE("allow trust", "[tx][allowtrust]")
         }
     }
 
+    SECTION("prefetches the trust line")
+    {
+        auto tx = createAllowTrust(app.getNetworkID(), gateway, a1,
+                                   gateway.getLastSequenceNumber() + 1, "IDR",
+                                   true);
+        std::vector<LedgerKey> keys;
+        tx->insertLedgerKeysToPrefetch(keys);
+
+        LedgerKey line;
+        line.type(TRUSTLINE);
+        line.trustLine().accountID = a1.getPublicKey();
+        line.trustLine().asset = idrCur;
+        LedgerKey account;
+        account.type(ACCOUNT);
+        account.account().accountID = a1.getPublicKey();
+        auto has = [&keys](LedgerKey const& key) {
+            return std::any_of(
+                keys.begin(), keys.end(),
+                [&key](LedgerKey const& k) { return k == key; });
+        };
+        REQUIRE(has(line));
+        REQUIRE(!has(account));
+    }
+
     SECTION("allow trust not required with payment")
     {
         a1.changeTrust(idrCur, trustLineLimit);
@@ -124,4 +124,12 @@ CreateAccountOpFrame::doCheckValid(Application& app)
 
     return true;
 }
+
+void
+CreateAccountOpFrame::insertLedgerKeysToPrefetch(
+    std::vector<LedgerKey>& keys) const
+{
+    OperationFrame::insertLedgerKeysToPrefetch(keys);
+    addAccountKey(keys, mCreateAccount.destination);
+}
 }
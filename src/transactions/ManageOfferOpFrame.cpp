@@ -303,7 +303,7 @@ ManageOfferOpFrame::doApply(Application& app, LedgerDelta& delta,
             if (wheat.type() == ASSET_TYPE_NATIVE)
             {
                 mSourceAccount->getAccount().balance += wheatReceived;
-                mSourceAccount->storeChange(delta, db);
+                mSourceAccount->storeChange(tempDelta, db);
             }
             else
             {
@@ -313,13 +313,13 @@ ManageOfferOpFrame::doApply(Application& app, LedgerDelta& delta,
                     throw std::runtime_error("offer claimed over limit");
                 }
 
-                mWheatLineA->storeChange(delta, db);
+                mWheatLineA->storeChange(tempDelta, db);
             }
 
             if (sheep.type() == ASSET_TYPE_NATIVE)
             {
                 mSourceAccount->getAccount().balance -= sheepSent;
-                mSourceAccount->storeChange(delta, db);
+                mSourceAccount->storeChange(tempDelta, db);
             }
             else
             {
@@ -328,7 +328,7 @@ ManageOfferOpFrame::doApply(Application& app, LedgerDelta& delta,
                     // this would indicate a bug in OfferExchange
                     throw std::runtime_error("offer sold more than balance");
                 }
-                mSheepLineA->storeChange(delta, db);
+                mSheepLineA->storeChange(tempDelta, db);
             }
         }
 
@@ -451,4 +451,13 @@ ManageOfferOpFrame::buildOffer(AccountID const& account,
     o.flags = flags;
     return o;
 }
+
+void
+ManageOfferOpFrame::insertLedgerKeysToPrefetch(
+    std::vector<LedgerKey>& keys) const
+{
+    OperationFrame::insertLedgerKeysToPrefetch(keys);
+    addTrustLineKey(keys, getSourceID(), mManageOffer.selling);
+    addTrustLineKey(keys, getSourceID(), mManageOffer.buying);
+}
 }
@@ -117,4 +117,11 @@ MergeOpFrame::doCheckValid(Application& app)
     }
     return true;
 }
+
+void
+MergeOpFrame::insertLedgerKeysToPrefetch(std::vector<LedgerKey>& keys) const
+{
+    OperationFrame::insertLedgerKeysToPrefetch(keys);
+    addAccountKey(keys, mOperation.body.destination());
+}
 }
@@ -6,6 +6,7 @@
 #include "database/Database.h"
 #include "ledger/LedgerDelta.h"
 #include "ledger/LedgerManager.h"
+#include "ledger/OrderBook.h"
 #include "ledger/TrustFrame.h"
 #include "util/Logging.h"
 
@@ -250,17 +251,32 @@ OfferExchange::convertWithOffers(
     wheatReceived = 0;
 
     Database& db = mLedgerManager.getDatabase();
+    OrderBook& book = db.getOrderBook();
 
-    size_t offerOffset = 0;
+    // Offers are loaded from the last one loaded on: the ones before it were
+    // all either taken or skipped.
+    OfferFrame::pointer lastOffer;
 
     bool needMore = (maxWheatReceive > 0 && maxSheepSend > 0);
 
     while (needMore)
     {
         std::vector<OfferFrame::pointer> retList;
-        OfferFrame::loadBestOffers(5, offerOffset, wheat, sheep, retList, db);
+        if (book.isEnabled())
+        {
+            book.loadBestOffers(5, wheat, sheep, lastOffer.get(), retList,
+                                db);
+        }
+        else
+        {
+            OfferFrame::loadBestOffers(5, wheat, sheep, lastOffer.get(),
+                                       retList, db);
+        }
 
-        offerOffset += retList.size();
+        if (!retList.empty())
+        {
+            lastOffer = retList.back();
+        }
 
         for (auto& wheatOffer : retList)
         {
@@ -288,9 +304,6 @@ OfferExchange::convertWithOffers(
             switch (cor)
             {
             case eOfferTaken:
-                assert(offerOffset > 0);
-                offerOffset--; // adjust offset as an offer was deleted
-                break;
             case eOfferPartial:
                 break;
             case eOfferCantConvert:
@@ -2,7 +2,11 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 #include "database/Database.h"
+#include "ledger/LedgerDelta.h"
 #include "ledger/LedgerManager.h"
+#include "ledger/LedgerTestUtils.h"
+#include "ledger/OfferFrame.h"
+#include "ledger/OrderBook.h"
 #include "lib/catch.hpp"
 #include "lib/util/uint128_t.h"
 #include "main/Application.h"
@@ -1688,3 +1692,222 @@ TEST_CASE("Exchange", "[offers]")
         }
     }
 }
+
+TEST_CASE("order book follows the offers table", "[offers][orderbook]")
+{
+    Config const& cfg = getTestConfig();
+    VirtualClock clock;
+    Application::pointer app = Application::create(clock, cfg);
+    app->start();
+    auto& db = app->getDatabase();
+    auto& book = db.getOrderBook();
+    REQUIRE(book.isEnabled());
+
+    auto issuer = getAccount("issuer");
+    Asset selling = makeAsset(issuer, "IDR");
+    Asset buying = makeAsset(issuer, "USD");
+
+    auto offers = LedgerTestUtils::generateValidOfferEntries(60);
+    LedgerDelta delta(app->getLedgerManager().getCurrentLedgerHeader(), db);
+    auto store = [&](LedgerDelta& d, size_t i, bool insert) {
+        auto& oe = offers[i];
+        oe.offerID = i + 1;
+        oe.selling = selling;
+        oe.buying = buying;
+        // a few prices shared by many offers, so that offer IDs matter
+        oe.price = Price{static_cast<int32_t>(1 + i % 7), 3};
+        LedgerEntry le;
+        le.data.type(OFFER);
+        le.data.offer() = oe;
+        OfferFrame offer(le);
+        if (insert)
+        {
+            offer.storeAdd(d, db);
+        }
+        else
+        {
+            offer.storeChange(d, db);
+        }
+    };
+    auto checkBook = [&]() {
+        std::vector<OfferFrame::pointer> fromBook, fromDb, fromDbPages;
+        OfferFrame::pointer last;
+        // page through both to exercise the cursors
+        do
+        {
+            auto n = fromBook.size();
+            book.loadBestOffers(7, selling, buying, last.get(), fromBook, db);
+            last = fromBook.size() > n ? fromBook.back() : nullptr;
+        } while (last);
+        do
+        {
+            auto n = fromDbPages.size();
+            OfferFrame::loadBestOffers(7, selling, buying, last.get(),
+                                       fromDbPages, db);
+            last = fromDbPages.size() > n ? fromDbPages.back() : nullptr;
+        } while (last);
+        OfferFrame::loadBestOffers(offers.size(), selling, buying, nullptr,
+                                   fromDb, db);
+        REQUIRE(fromBook.size() == fromDb.size());
+        REQUIRE(fromDbPages.size() == fromDb.size());
+        for (size_t i = 0; i < fromDb.size(); ++i)
+        {
+            REQUIRE(fromBook[i]->getOfferID() == fromDb[i]->getOfferID());
+            REQUIRE(fromDbPages[i]->getOfferID() == fromDb[i]->getOfferID());
+            REQUIRE(fromBook[i]->getAmount() == fromDb[i]->getAmount());
+            REQUIRE(fromBook[i]->getPrice() == fromDb[i]->getPrice());
+        }
+        return fromDb.size();
+    };
+
+    for (size_t i = 0; i < 40; ++i)
+    {
+        store(delta, i, true);
+    }
+    REQUIRE(book.size() == 0);
+    REQUIRE(checkBook() == 40);
+    REQUIRE(book.size() == 40);
+
+    auto changeOffers = [&](LedgerDelta& d) {
+        for (size_t i = 40; i < offers.size(); ++i)
+        {
+            store(d, i, true);
+        }
+        for (size_t i = 0; i < 10; ++i)
+        {
+            offers[i].amount += 1;
+            store(d, i, false);
+        }
+        for (size_t i = 10; i < 20; ++i)
+        {
+            LedgerKey key;
+            key.type(OFFER);
+            key.offer().sellerID = offers[i].sellerID;
+            key.offer().offerID = offers[i].offerID;
+            OfferFrame::storeDelete(d, db, key);
+        }
+    };
+
+    SECTION("rollback")
+    {
+        {
+            soci::transaction sqlTx(db.getSession());
+            LedgerDelta txDelta(delta);
+            changeOffers(txDelta);
+            REQUIRE(checkBook() == 50);
+        }
+        REQUIRE(checkBook() == 40);
+    }
+    SECTION("nested commit then rollback")
+    {
+        {
+            soci::transaction sqlTx(db.getSession());
+            LedgerDelta txDelta(delta);
+            {
+                soci::transaction opSqlTx(db.getSession());
+                LedgerDelta opDelta(txDelta);
+                changeOffers(opDelta);
+                opSqlTx.commit();
+                opDelta.commit();
+            }
+            REQUIRE(checkBook() == 50);
+        }
+        REQUIRE(checkBook() == 40);
+    }
+    SECTION("commit")
+    {
+        {
+            soci::transaction sqlTx(db.getSession());
+            LedgerDelta txDelta(delta);
+            changeOffers(txDelta);
+            sqlTx.commit();
+            txDelta.commit();
+        }
+        REQUIRE(checkBook() == 50);
+    }
+    SECTION("pair loaded in a rolled back delta")
+    {
+        book.clear();
+        {
+            soci::transaction sqlTx(db.getSession());
+            LedgerDelta txDelta(delta);
+            changeOffers(txDelta);
+            REQUIRE(checkBook() == 50);
+        }
+        // what was loaded came from rolled back state
+        REQUIRE(book.size() == 0);
+        REQUIRE(checkBook() == 40);
+    }
+}
+
+namespace
+{
+void
+benchOfferCrossing(bool inMemoryOrderBook)
+{
+    Config cfg(getTestConfig());
+    cfg.IN_MEMORY_ORDER_BOOK = inMemoryOrderBook;
+    VirtualClock clock;
+    ApplicationEditableVersion app(clock, cfg);
+    app.start();
+
+    size_t const nbSellers = 10;
+    size_t const nbOffersPerSeller = 1000;
+    int64_t const offerAmount = 100;
+    int64_t const txfee = app.getLedgerManager().getTxFee();
+
+    auto root = TestAccount::createRoot(app);
+    auto gateway = root.create("gateway", 1000000000000);
+    Asset xlm;
+    xlm.type(ASSET_TYPE_NATIVE);
+    Asset usd = makeAsset(gateway, "USD");
+
+    auto sellerBalance =
+        app.getLedgerManager().getMinBalance(nbOffersPerSeller + 1) +
+        (nbOffersPerSeller + 10) * txfee;
+    for (size_t i = 0; i < nbSellers; ++i)
+    {
+        auto seller = root.create("seller" + std::to_string(i), sellerBalance);
+        seller.changeTrust(usd, nbOffersPerSeller * offerAmount);
+        gateway.pay(seller, usd, nbOffersPerSeller * offerAmount);
+        for (size_t j = 0; j < nbOffersPerSeller; ++j)
+        {
+            // between 1 and 1.5 XLM per USD
+            seller.manageOffer(0, usd, xlm,
+                               Price{static_cast<int32_t>(100 + j % 50), 100},
+                               offerAmount);
+        }
+    }
+
+    // offers up to 2 XLM per USD, for more than there is on offer
+    size_t const nbOffers = nbSellers * nbOffersPerSeller;
+    int64_t const buyAmount = 3 * nbOffers * offerAmount;
+    auto buyer = root.create("buyer", app.getLedgerManager().getMinBalance(2) +
+                                          buyAmount + 10 * txfee);
+    buyer.changeTrust(usd, buyAmount);
+
+    LOG(INFO) << "Benchmarking crossing " << nbOffers << " offers "
+              << (inMemoryOrderBook ? "from the in-memory order book"
+                                    : "from the database");
+    {
+        TIMED_SCOPE(timerBlkObj, "offer crossing");
+        buyer.manageOffer(0, xlm, usd, Price{1, 2}, buyAmount);
+    }
+    REQUIRE(app.getDatabase().getOrderBook().size() <= 1);
+    std::vector<OfferFrame::pointer> left;
+    OfferFrame::loadBestOffers(1, usd, xlm, nullptr, left, app.getDatabase());
+    REQUIRE(left.empty());
+}
+}
+
+TEST_CASE("offer crossing benchmarking", "[offers][bench][hide]")
+{
+    SECTION("in-memory order book")
+    {
+        benchOfferCrossing(true);
+    }
+    SECTION("database")
+    {
+        benchOfferCrossing(false);
+    }
+}
@@ -109,6 +109,36 @@ OperationFrame::getSourceID() const
                                     : mParentTx.getEnvelope().tx.sourceAccount;
 }
 
+void
+OperationFrame::addAccountKey(std::vector<LedgerKey>& keys,
+                              AccountID const& accountID)
+{
+    keys.emplace_back();
+    keys.back().type(ACCOUNT);
+    keys.back().account().accountID = accountID;
+}
+
+void
+OperationFrame::addTrustLineKey(std::vector<LedgerKey>& keys,
+                                AccountID const& accountID,
+                                Asset const& asset)
+{
+    if (asset.type() == ASSET_TYPE_NATIVE)
+    {
+        return;
+    }
+    keys.emplace_back();
+    keys.back().type(TRUSTLINE);
+    keys.back().trustLine().accountID = accountID;
+    keys.back().trustLine().asset = asset;
+}
+
+void
+OperationFrame::insertLedgerKeysToPrefetch(std::vector<LedgerKey>& keys) const
+{
+    addAccountKey(keys, getSourceID());
+}
+
 bool
 OperationFrame::loadAccount(LedgerDelta* delta, Database& db)
 {
@@ -39,6 +39,14 @@ class OperationFrame
                          LedgerManager& ledgerManager) = 0;
     virtual int32_t getNeededThreshold() const;
 
+    // helpers for insertLedgerKeysToPrefetch; no key is added for the
+    // trust line of the native asset
+    static void addAccountKey(std::vector<LedgerKey>& keys,
+                              AccountID const& accountID);
+    static void addTrustLineKey(std::vector<LedgerKey>& keys,
+                                AccountID const& accountID,
+                                Asset const& asset);
+
   public:
     static std::shared_ptr<OperationFrame>
     makeHelper(Operation const& op, OperationResult& res,
@@ -82,6 +90,12 @@ class OperationFrame
     bool apply(SignatureChecker& signatureChecker, LedgerDelta& delta,
                Application& app);
 
+    // Appends the keys of the ledger entries that applying this operation
+    // is expected to load, so that they can be prefetched in bulk. Keys may
+    // be repeated. The default is the source account.
+    virtual void
+    insertLedgerKeysToPrefetch(std::vector<LedgerKey>& keys) const;
+
     Operation const&
     getOperation() const
     {
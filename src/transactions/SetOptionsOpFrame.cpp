@@ -310,4 +310,15 @@ SetOptionsOpFrame::doCheckValid(Application& app)
 
     return true;
 }
+
+void
+SetOptionsOpFrame::insertLedgerKeysToPrefetch(
+    std::vector<LedgerKey>& keys) const
+{
+    OperationFrame::insertLedgerKeysToPrefetch(keys);
+    if (mSetOptions.inflationDest)
+    {
+        addAccountKey(keys, *mSetOptions.inflationDest);
+    }
+}
 }
@@ -25,6 +25,8 @@ class SetOptionsOpFrame : public OperationFrame
     bool doApply(Application& app, LedgerDelta& delta,
                  LedgerManager& ledgerManager) override;
     bool doCheckValid(Application& app) override;
+    void
+    insertLedgerKeysToPrefetch(std::vector<LedgerKey>& keys) const override;
 
     static SetOptionsResultCode
     getInnerCode(OperationResult const& res)
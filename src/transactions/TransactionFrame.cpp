@@ -7,6 +7,7 @@
 #include "OperationFrame.h"
 #include "crypto/Hex.h"
 #include "crypto/SHA.h"
+#include "crypto/SecretKey.h"
 #include "crypto/SignerKey.h"
 #include "database/Database.h"
 #include "herder/TxSetFrame.h"
@@ -14,6 +15,7 @@
 #include "main/Application.h"
 #include "transactions/SignatureChecker.h"
 #include "transactions/SignatureUtils.h"
+#include "transactions/TxValidationMemo.h"
 #include "util/Algoritm.h"
 #include "util/Logging.h"
 #include "util/XDRStream.h"
@@ -166,6 +168,16 @@ TransactionFrame::loadAccount(LedgerDelta* delta, Database& db,
     {
         res = AccountFrame::loadAccount(*delta, accountID, db);
     }
+    else if (mAccountSnapshot)
+    {
+        auto it = mAccountSnapshot->find(accountID);
+        assert(it != mAccountSnapshot->end());
+        if (it->second)
+        {
+            // a copy, as loadAccount would return
+            res = std::make_shared<AccountFrame>(*it->second);
+        }
+    }
     else
     {
         res = AccountFrame::loadAccount(accountID, db);
@@ -203,6 +215,25 @@ TransactionFrame::resetResults()
     getResult().feeCharged = getFee();
 }
 
+bool
+TransactionFrame::checkSeqNum(Application& app, SequenceNumber current)
+{
+    if (current == 0)
+    {
+        current = mSigningAccount->getSeqNum();
+    }
+
+    if (current + 1 != mEnvelope.tx.seqNum)
+    {
+        app.getMetrics()
+            .NewMeter({"transaction", "invalid", "bad-seq"}, "transaction")
+            .Mark();
+        getResult().result.code(txBAD_SEQ);
+        return false;
+    }
+    return true;
+}
+
 bool
 TransactionFrame::commonValid(SignatureChecker& signatureChecker,
                               Application& app, LedgerDelta* delta,
@@ -264,21 +295,9 @@ TransactionFrame::commonValid(SignatureChecker& signatureChecker,
     }
 
     // when applying, the account's sequence number is updated when taking fees
-    if (!applying)
+    if (!applying && !checkSeqNum(app, current))
     {
-        if (current == 0)
-        {
-            current = mSigningAccount->getSeqNum();
-        }
-
-        if (current + 1 != mEnvelope.tx.seqNum)
-        {
-            app.getMetrics()
-                .NewMeter({"transaction", "invalid", "bad-seq"}, "transaction")
-                .Mark();
-            getResult().result.code(txBAD_SEQ);
-            return false;
-        }
+        return false;
     }
 
     if (app.getLedgerManager().getCurrentLedgerVersion() != 7 && !checkSignature(signatureChecker, *mSigningAccount,
@@ -306,6 +325,58 @@ TransactionFrame::commonValid(SignatureChecker& signatureChecker,
     return true;
 }
 
+void
+TransactionFrame::insertLedgerKeysToPrefetch(std::vector<LedgerKey>& keys)
+{
+    if (mOperations.size() != mEnvelope.tx.operations.size())
+    {
+        // operations are only bound once the transaction is validated or
+        // applied, which resets them anyway
+        resetResults();
+    }
+    keys.emplace_back();
+    keys.back().type(ACCOUNT);
+    keys.back().account().accountID = getSourceID();
+    for (auto const& op : mOperations)
+    {
+        op->insertLedgerKeysToPrefetch(keys);
+    }
+}
+
+void
+TransactionFrame::insertSigningAccounts(std::vector<AccountID>& accounts) const
+{
+    accounts.emplace_back(getSourceID());
+    for (auto const& op : mEnvelope.tx.operations)
+    {
+        if (op.sourceAccount)
+        {
+            accounts.emplace_back(*op.sourceAccount);
+        }
+    }
+}
+
+void
+TransactionFrame::insertSignatureChecks(
+    std::vector<SignerKey> const& keys,
+    std::vector<PubKeyUtils::VerifySigRequest>& checks) const
+{
+    auto const& contentsHash = getContentsHash();
+    for (auto const& sig : mEnvelope.signatures)
+    {
+        for (auto const& k : keys)
+        {
+            if (k.type() == SIGNER_KEY_TYPE_ED25519 &&
+                SignatureUtils::doesHintMatch(k.ed25519(), sig.hint))
+            {
+                checks.emplace_back(PubKeyUtils::VerifySigRequest{
+                    KeyUtils::convertKey<PublicKey>(k), sig.signature,
+                    contentsHash});
+            }
+        }
+    }
+}
+
 void
 TransactionFrame::processFeeSeqNum(LedgerDelta& delta,
                                    LedgerManager& ledgerManager)
@@ -419,10 +490,96 @@ TransactionFrame::removeAccountSigner(const AccountFrame::pointer& account,
 }
 
 bool
-TransactionFrame::checkValid(Application& app, SequenceNumber current)
+TransactionFrame::checkValid(Application& app, SequenceNumber current,
+                             AccountSnapshot const& accounts,
+                             TxValidationMemo* memo)
+{
+    mAccountSnapshot = &accounts;
+    try
+    {
+        bool res = checkValid(app, current, memo);
+        mAccountSnapshot = nullptr;
+        return res;
+    }
+    catch (...)
+    {
+        mAccountSnapshot = nullptr;
+        throw;
+    }
+}
+
+bool
+TransactionFrame::checkValid(Application& app, SequenceNumber current,
+                             TxValidationMemo* memo)
 {
     resetSigningAccount();
     resetResults();
+    if (!memo)
+    {
+        return checkValidUncached(app, current);
+    }
+
+    auto const& lclHash =
+        app.getLedgerManager().getLastClosedLedgerHeader().hash;
+    TransactionResultCode code;
+    if (memo->get(getFullHash(), lclHash, code))
+    {
+        return checkValidMemoized(app, current, code);
+    }
+    bool res = checkValidUncached(app, current);
+    if (getResultCode() != txBAD_SEQ)
+    {
+        memo->put(getFullHash(), lclHash, getResultCode());
+    }
+    return res;
+}
+
+// replays what checkValidUncached does given the code it returned, which
+// is everything but the sequence number check
+bool
+TransactionFrame::checkValidMemoized(Application& app, SequenceNumber current,
+                                     TransactionResultCode code)
+{
+    switch (code)
+    {
+    case txMISSING_OPERATION:
+    case txTOO_EARLY:
+    case txTOO_LATE:
+    case txINSUFFICIENT_FEE:
+    case txNO_ACCOUNT:
+        // found before getting to the sequence number
+        getResult().result.code(code);
+        return false;
+    default:
+        break;
+    }
+
+    if (!loadAccount(nullptr, app.getDatabase()))
+    {
+        // the ledger changed under the memo, which it should not; start over
+        return checkValidUncached(app, current);
+    }
+    if (!checkSeqNum(app, current))
+    {
+        return false;
+    }
+
+    switch (code)
+    {
+    case txSUCCESS:
+        return true;
+    case txFAILED:
+        markResultFailed();
+        return false;
+    default:
+        getResult().result.code(code);
+        return false;
+    }
+}
+
+bool
+TransactionFrame::checkValidUncached(Application& app, SequenceNumber current)
+{
     SignatureChecker signatureChecker{getContentsHash(), mEnvelope.signatures};
     bool res = commonValid(signatureChecker, app, nullptr, current);
     if (res)
@@ -4,6 +4,7 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "crypto/SecretKey.h"
 #include "ledger/AccountFrame.h"
 #include "ledger/LedgerManager.h"
 #include "overlay/StellarXDR.h"
@@ -11,6 +12,7 @@
 
 #include <memory>
 #include <set>
+#include <unordered_map>
 
 namespace soci
 {
@@ -28,6 +30,7 @@ class OperationFrame;
 class LedgerDelta;
 class SecretKey;
 class SignatureChecker;
+class TxValidationMemo;
 class XDROutputFileStream;
 class SHA256;
 
@@ -36,12 +39,20 @@ using TransactionFramePtr = std::shared_ptr<TransactionFrame>;
 
 class TransactionFrame
 {
+  public:
+    // Accounts by ID, nullptr for those that do not exist.
+    typedef std::unordered_map<AccountID, AccountFrame::pointer>
+        AccountSnapshot;
+
   protected:
     TransactionEnvelope mEnvelope;
     TransactionResult mResult;
 
     AccountFrame::pointer mSigningAccount;
 
+    // where checkValid loads accounts from instead of the database, if set
+    AccountSnapshot const* mAccountSnapshot{nullptr};
+
     void clearCached();
     Hash const& mNetworkID;     // used to change the way we compute signatures
     mutable Hash mContentsHash; // the hash of the contents
@@ -50,8 +61,12 @@ class TransactionFrame
     std::vector<std::shared_ptr<OperationFrame>> mOperations;
 
     bool loadAccount(LedgerDelta* delta, Database& app);
+    bool checkSeqNum(Application& app, SequenceNumber current);
     bool commonValid(SignatureChecker& signatureChecker, Application& app,
                      LedgerDelta* delta, SequenceNumber current);
+    bool checkValidUncached(Application& app, SequenceNumber current);
+    bool checkValidMemoized(Application& app, SequenceNumber current,
+                            TransactionResultCode code);
 
     void resetSigningAccount();
     void resetResults();
@@ -148,7 +163,34 @@ class TransactionFrame
     bool checkSignature(SignatureChecker& signatureChecker,
                         AccountFrame& account, int32_t neededWeight);
 
-    bool checkValid(Application& app, SequenceNumber current);
+    // With a `memo`, a transaction already checked against the last closed
+    // ledger only has its sequence number checked again; it then gets the
+    // result code it got the first time, but not the operation results.
+    bool checkValid(Application& app, SequenceNumber current,
+                    TxValidationMemo* memo = nullptr);
+
+    // Same as above, but loads the accounts from `accounts`, which must hold
+    // every account insertSigningAccounts names, rather than the database;
+    // it can then be called off the main thread while the main thread waits.
+    bool checkValid(Application& app, SequenceNumber current,
+                    AccountSnapshot const& accounts,
+                    TxValidationMemo* memo = nullptr);
+
+    // appends the keys of the ledger entries that applying this transaction
+    // is expected to load (its source account and those of its operations),
+    // so that they can be prefetched in bulk
+    void insertLedgerKeysToPrefetch(std::vector<LedgerKey>& keys);
+
+    // appends the accounts checkValid checks signatures for: the source
+    // account and those of the operations
+    void insertSigningAccounts(std::vector<AccountID>& accounts) const;
+
+    // appends a check of each signature of the envelope against each of the
+    // ed25519 `keys` whose hint it matches, so that the signatures can be
+    // verified ahead of checkValid; the checks refer to the contents hash
+    void insertSignatureChecks(
+        std::vector<SignerKey> const& keys,
+        std::vector<PubKeyUtils::VerifySigRequest>& checks) const;
 
     // collect fee, consume sequence number
     void processFeeSeqNum(LedgerDelta& delta, LedgerManager& ledgerManager);
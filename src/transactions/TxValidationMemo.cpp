@@ -0,0 +1,81 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "transactions/TxValidationMemo.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include <cassert>
+
+namespace stellar
+{
+
+size_t const TxValidationMemo::MAX_ENTRIES = 100000;
+
+TxValidationMemo::TxValidationMemo(medida::MetricsRegistry& metrics)
+    : mHits(metrics.NewMeter({"transaction", "validation-memo", "hit"},
+                             "transaction"))
+    , mMisses(metrics.NewMeter({"transaction", "validation-memo", "miss"},
+                               "transaction"))
+{
+}
+
+bool
+TxValidationMemo::get(Hash const& txHash, Hash const& lclHash,
+                      TransactionResultCode& code)
+{
+    {
+        std::lock_guard<std::mutex> guard(mMutex);
+        if (lclHash == mLedgerHash)
+        {
+            auto it = mEntries.find(txHash);
+            if (it != mEntries.end())
+            {
+                code = it->second;
+                mHits.Mark();
+                return true;
+            }
+        }
+    }
+    mMisses.Mark();
+    return false;
+}
+
+bool
+TxValidationMemo::has(Hash const& txHash, Hash const& lclHash) const
+{
+    std::lock_guard<std::mutex> guard(mMutex);
+    return lclHash == mLedgerHash && mEntries.find(txHash) != mEntries.end();
+}
+
+void
+TxValidationMemo::put(Hash const& txHash, Hash const& lclHash,
+                      TransactionResultCode code)
+{
+    assert(code != txBAD_SEQ);
+    std::lock_guard<std::mutex> guard(mMutex);
+    if (lclHash != mLedgerHash)
+    {
+        mEntries.clear();
+        mLedgerHash = lclHash;
+    }
+    if (mEntries.size() < MAX_ENTRIES)
+    {
+        mEntries[txHash] = code;
+    }
+}
+
+void
+TxValidationMemo::clear()
+{
+    std::lock_guard<std::mutex> guard(mMutex);
+    mEntries.clear();
+}
+
+size_t
+TxValidationMemo::size() const
+{
+    std::lock_guard<std::mutex> guard(mMutex);
+    return mEntries.size();
+}
+}
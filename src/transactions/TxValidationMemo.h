@@ -0,0 +1,67 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "overlay/StellarXDR.h"
+#include "util/HashOfHash.h"
+#include "util/NonCopyable.h"
+#include <mutex>
+#include <unordered_map>
+
+namespace medida
+{
+class Meter;
+class MetricsRegistry;
+}
+
+namespace stellar
+{
+
+/**
+ * Outcomes of TransactionFrame::checkValid for the transactions checked
+ * against the last closed ledger, keyed on their full hash, so that checking
+ * the same transactions again (as the herder does for every candidate
+ * transaction set of a nomination round) only redoes the sequence number
+ * check.
+ *
+ * An outcome holds for as long as the ledger does not change, that is until
+ * the next ledger closes: entries are dropped then, and those recorded
+ * against another ledger than the one asked about never match.
+ *
+ * Can be used from any thread.
+ */
+class TxValidationMemo : NonMovableOrCopyable
+{
+  public:
+    static size_t const MAX_ENTRIES;
+
+    explicit TxValidationMemo(medida::MetricsRegistry& metrics);
+
+    // Sets `code` to the result code checkValid came up with and returns
+    // true if the transaction with full hash `txHash` was checked against
+    // the ledger with hash `lclHash`.
+    bool get(Hash const& txHash, Hash const& lclHash,
+             TransactionResultCode& code);
+
+    // Same as get, but without looking at the outcome or counting a hit.
+    bool has(Hash const& txHash, Hash const& lclHash) const;
+
+    // Records an outcome other than txBAD_SEQ, which depends on where the
+    // transaction is checked from; ignored once MAX_ENTRIES are recorded.
+    void put(Hash const& txHash, Hash const& lclHash,
+             TransactionResultCode code);
+
+    void clear();
+    size_t size() const;
+
+  private:
+    mutable std::mutex mMutex;
+    Hash mLedgerHash;
+    std::unordered_map<Hash, TransactionResultCode> mEntries;
+
+    medida::Meter& mHits;
+    medida::Meter& mMisses;
+};
+}
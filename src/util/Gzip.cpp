@@ -0,0 +1,98 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/Gzip.h"
+
+#ifdef USE_ZLIB
+
+#include "util/Logging.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+#include <zlib.h>
+
+namespace stellar
+{
+
+static size_t const kGunzipBufferSize = 1024 * 1024;
+
+static void
+gunzipFileInto(gzFile in, std::FILE* out, std::string const& filenameGz,
+               std::string const& filenameOut,
+               std::function<void(ByteSlice const&)> const& onBlock)
+{
+    std::vector<char> buf(kGunzipBufferSize);
+    gzbuffer(in, static_cast<unsigned>(kGunzipBufferSize));
+    while (true)
+    {
+        int n = gzread(in, buf.data(), static_cast<unsigned>(buf.size()));
+        if (n < 0)
+        {
+            int err = 0;
+            char const* msg = gzerror(in, &err);
+            throw std::runtime_error("failed to inflate " + filenameGz + ": " +
+                                     msg);
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        if (std::fwrite(buf.data(), 1, n, out) != static_cast<size_t>(n))
+        {
+            throw std::runtime_error("failed to write " + filenameOut +
+                                     ", reason: " + std::to_string(errno));
+        }
+        onBlock(ByteSlice(buf.data(), n));
+    }
+}
+
+void
+gunzipFile(std::string const& filenameGz, std::string const& filenameOut,
+           std::function<void(ByteSlice const&)> const& onBlock)
+{
+    gzFile in = gzopen(filenameGz.c_str(), "rb");
+    if (!in)
+    {
+        throw std::runtime_error("failed to open gzip file: " + filenameGz +
+                                 ", reason: " + std::to_string(errno));
+    }
+    std::FILE* out = std::fopen(filenameOut.c_str(), "wb");
+    if (!out)
+    {
+        gzclose_r(in);
+        throw std::runtime_error("failed to open file: " + filenameOut +
+                                 ", reason: " + std::to_string(errno));
+    }
+
+    try
+    {
+        gunzipFileInto(in, out, filenameGz, filenameOut, onBlock);
+    }
+    catch (std::exception const& e)
+    {
+        CLOG(ERROR, "Fs") << e.what();
+        gzclose_r(in);
+        std::fclose(out);
+        std::remove(filenameOut.c_str());
+        throw;
+    }
+
+    // A truncated stream reads as end of file, and is only reported here.
+    int inflateResult = gzclose_r(in);
+    bool closed = std::fclose(out) == 0;
+    if (inflateResult != Z_OK || !closed)
+    {
+        std::remove(filenameOut.c_str());
+        std::string msg = inflateResult != Z_OK
+                              ? "corrupt gzip file " + filenameGz
+                              : "failed to close " + filenameOut;
+        CLOG(ERROR, "Fs") << msg;
+        throw std::runtime_error(msg);
+    }
+}
+}
+
+#endif
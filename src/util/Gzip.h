@@ -0,0 +1,23 @@
+#pragma once
+
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/ByteSlice.h"
+#include <functional>
+#include <string>
+
+namespace stellar
+{
+
+#ifdef USE_ZLIB
+// Inflate the gzip file `filenameGz` into `filenameOut` in process, passing
+// each block of inflated output to `onBlock` as it is written, so callers can
+// hash (or otherwise inspect) the output without reading it back. Throws
+// std::runtime_error if either file can't be opened or written, or if the
+// input is not a complete gzip stream; `filenameOut` is removed in that case.
+void gunzipFile(std::string const& filenameGz, std::string const& filenameOut,
+                std::function<void(ByteSlice const&)> const& onBlock);
+#endif
+}
@@ -0,0 +1,502 @@
+// Copyright 2017 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/XDRStream.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#endif
+
+namespace stellar
+{
+
+size_t const XDRInputFileStream::kDefaultBufferSize = 1024 * 1024;
+size_t const XDROutputFileStream::kBufferSize = 1024 * 1024;
+
+char const XDRBlockFormat::kMagic[4] = {'X', 'D', 'R', 'Z'};
+uint32_t const XDRBlockFormat::kVersion = 1;
+size_t const XDRBlockFormat::kBlockSize = 64 * 1024;
+size_t const XDRBlockFormat::kHeaderSize;
+size_t const XDRBlockFormat::kTrailerSize;
+
+static std::FILE*
+openFile(std::string const& filename, char const* mode)
+{
+    std::FILE* f = std::fopen(filename.c_str(), mode);
+    if (!f)
+    {
+        std::string msg("failed to open XDR file: ");
+        msg += filename;
+        msg += ", reason: ";
+        msg += std::to_string(errno);
+        throw std::runtime_error(msg);
+    }
+    // All buffering is done by the streams themselves.
+    std::setvbuf(f, nullptr, _IONBF, 0);
+    return f;
+}
+
+static bool
+seekFile(std::FILE* f, uint64_t offset, int whence = SEEK_SET)
+{
+#ifdef _WIN32
+    return _fseeki64(f, static_cast<int64_t>(offset), whence) == 0;
+#else
+    return fseeko(f, static_cast<off_t>(offset), whence) == 0;
+#endif
+}
+
+static bool
+readFully(std::FILE* f, char* buf, size_t len)
+{
+    return std::fread(buf, 1, len, f) == len;
+}
+
+static bool
+writeFully(std::FILE* f, char const* buf, size_t len)
+{
+    return std::fwrite(buf, 1, len, f) == len;
+}
+
+template <typename T>
+static T
+getLE(char const* buf)
+{
+    T v = 0;
+    for (size_t i = sizeof(T); i-- > 0;)
+    {
+        v = (v << 8) | static_cast<uint8_t>(buf[i]);
+    }
+    return v;
+}
+
+template <typename T>
+static void
+putLE(char* buf, T v)
+{
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        buf[i] = static_cast<char>(v & 0xff);
+        v >>= 8;
+    }
+}
+
+bool
+XDRBlockFormat::isBlockCompressed(std::string const& filename)
+{
+    std::FILE* f = std::fopen(filename.c_str(), "rb");
+    if (!f)
+    {
+        return false;
+    }
+    char magic[sizeof(kMagic)];
+    bool res = readFully(f, magic, sizeof(magic)) &&
+               std::equal(magic, magic + sizeof(magic), kMagic);
+    std::fclose(f);
+    return res;
+}
+
+void
+XDRInputFileStream::close()
+{
+    if (mFile)
+    {
+        std::fclose(mFile);
+        mFile = nullptr;
+    }
+    mGood = false;
+    mBufPos = mBufEnd = mBufOffset = 0;
+    mCompressed = false;
+    mBlockOffsets.clear();
+    mBlockFileOffsets.clear();
+    mNextBlock = 0;
+}
+
+void
+XDRInputFileStream::open(std::string const& filename, size_t bufferSize)
+{
+    close();
+    try
+    {
+        mFile = openFile(filename, "rb");
+        char header[XDRBlockFormat::kHeaderSize];
+        size_t got = std::fread(header, 1, sizeof(header), mFile);
+        mCompressed = got == sizeof(header) &&
+                      std::equal(header, header + 4, XDRBlockFormat::kMagic);
+        if (mCompressed)
+        {
+#ifndef USE_ZLIB
+            throw std::runtime_error(
+                "can't read block-compressed XDR file without zlib: " +
+                filename);
+#endif
+            if (getLE<uint32_t>(header + 4) != XDRBlockFormat::kVersion)
+            {
+                throw std::runtime_error(
+                    "unknown XDR block format version in " + filename);
+            }
+            readBlockIndex();
+        }
+        else if (!seekFile(mFile, 0))
+        {
+            throw std::runtime_error("failed to seek in XDR file " + filename);
+        }
+    }
+    catch (std::runtime_error& e)
+    {
+        CLOG(ERROR, "Fs") << e.what();
+        close();
+        throw;
+    }
+#if !defined(_WIN32) && !defined(__APPLE__)
+    posix_fadvise(fileno(mFile), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    mBufferSize = std::max<size_t>(bufferSize, 4);
+    mBuf.resize(mBufferSize);
+    mGood = true;
+}
+
+void
+XDRInputFileStream::readBlockIndex()
+{
+    char trailer[XDRBlockFormat::kTrailerSize];
+    if (!seekFile(mFile, 0, SEEK_END))
+    {
+        throw std::runtime_error("failed to seek in XDR file");
+    }
+#ifdef _WIN32
+    uint64_t fileSize = static_cast<uint64_t>(_ftelli64(mFile));
+#else
+    uint64_t fileSize = static_cast<uint64_t>(ftello(mFile));
+#endif
+    if (fileSize < XDRBlockFormat::kHeaderSize + sizeof(trailer) ||
+        !seekFile(mFile, fileSize - sizeof(trailer)) ||
+        !readFully(mFile, trailer, sizeof(trailer)))
+    {
+        throw xdr::xdr_runtime_error("malformed XDR block file");
+    }
+    uint64_t nBlocks = getLE<uint64_t>(trailer);
+    uint64_t indexSize = nBlocks * 16;
+    if (nBlocks > fileSize / 16 ||
+        fileSize - sizeof(trailer) - XDRBlockFormat::kHeaderSize < indexSize)
+    {
+        throw xdr::xdr_runtime_error("malformed XDR block file");
+    }
+    std::vector<char> index(static_cast<size_t>(indexSize));
+    if (!seekFile(mFile, fileSize - sizeof(trailer) - indexSize) ||
+        !readFully(mFile, index.data(), index.size()))
+    {
+        throw xdr::xdr_runtime_error("malformed XDR block file");
+    }
+    mBlockOffsets.resize(static_cast<size_t>(nBlocks));
+    mBlockFileOffsets.resize(static_cast<size_t>(nBlocks));
+    for (size_t i = 0; i < nBlocks; ++i)
+    {
+        mBlockOffsets[i] = getLE<uint64_t>(index.data() + 16 * i);
+        mBlockFileOffsets[i] = getLE<uint64_t>(index.data() + 16 * i + 8);
+    }
+    mNextBlock = 0;
+    if (nBlocks != 0 && !seekFile(mFile, mBlockFileOffsets[0]))
+    {
+        throw std::runtime_error("failed to seek in XDR file");
+    }
+}
+
+bool
+XDRInputFileStream::inflateNextBlock()
+{
+    if (mNextBlock >= mBlockOffsets.size())
+    {
+        return false;
+    }
+    char header[8];
+    if (!readFully(mFile, header, sizeof(header)))
+    {
+        throw xdr::xdr_runtime_error("malformed XDR block file");
+    }
+    uint32_t compressedSize = getLE<uint32_t>(header);
+    uint32_t rawSize = getLE<uint32_t>(header + 4);
+    mCompressedBuf.resize(compressedSize);
+    if (!readFully(mFile, mCompressedBuf.data(), compressedSize))
+    {
+        throw xdr::xdr_runtime_error("malformed XDR block file");
+    }
+    if (mBuf.size() - mBufEnd < rawSize)
+    {
+        mBuf.resize(mBufEnd + rawSize);
+    }
+#ifdef USE_ZLIB
+    uLongf len = rawSize;
+    if (uncompress(reinterpret_cast<Bytef*>(mBuf.data() + mBufEnd), &len,
+                   reinterpret_cast<Bytef const*>(mCompressedBuf.data()),
+                   compressedSize) != Z_OK ||
+        len != rawSize)
+    {
+        throw xdr::xdr_runtime_error("corrupt XDR block file");
+    }
+#else
+    throw std::runtime_error("can't inflate XDR blocks without zlib");
+#endif
+    mBufEnd += rawSize;
+    ++mNextBlock;
+    return true;
+}
+
+bool
+XDRInputFileStream::fill(size_t n)
+{
+    if (!mFile)
+    {
+        return false;
+    }
+
+    // Move the unread tail to the front of the buffer and top it up with as
+    // much of the file as fits.
+    size_t avail = mBufEnd - mBufPos;
+    if (mBufPos != 0)
+    {
+        std::memmove(mBuf.data(), mBuf.data() + mBufPos, avail);
+        mBufOffset += mBufPos;
+        mBufPos = 0;
+        mBufEnd = avail;
+    }
+    if (mBuf.size() < n)
+    {
+        mBuf.resize(n);
+    }
+    if (mCompressed)
+    {
+        // Inflate whole blocks, growing the buffer as needed.
+        while (mBufEnd < n)
+        {
+            if (!inflateNextBlock())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    while (mBufEnd < n)
+    {
+        size_t got = std::fread(mBuf.data() + mBufEnd, 1,
+                                mBuf.size() - mBufEnd, mFile);
+        if (got == 0)
+        {
+            return false;
+        }
+        mBufEnd += got;
+    }
+    return true;
+}
+
+void
+XDRInputFileStream::seek(size_t offset)
+{
+    assert(mFile);
+    mGood = true;
+    if (offset >= mBufOffset && offset <= mBufOffset + mBufEnd)
+    {
+        mBufPos = offset - mBufOffset;
+        return;
+    }
+    if (mBuf.size() > mBufferSize)
+    {
+        mBuf.resize(mBufferSize);
+    }
+    if (mCompressed)
+    {
+        // Inflate the block holding `offset`.
+        auto i = std::upper_bound(mBlockOffsets.begin(), mBlockOffsets.end(),
+                                  static_cast<uint64_t>(offset));
+        if (i == mBlockOffsets.begin())
+        {
+            mGood = false;
+            throw std::runtime_error("failed to seek in XDR file");
+        }
+        mNextBlock = (i - mBlockOffsets.begin()) - 1;
+        if (!seekFile(mFile, mBlockFileOffsets[mNextBlock]))
+        {
+            mGood = false;
+            throw std::runtime_error("failed to seek in XDR file");
+        }
+        mBufOffset = static_cast<size_t>(mBlockOffsets[mNextBlock]);
+        mBufPos = mBufEnd = 0;
+        inflateNextBlock();
+        mBufPos = std::min(offset - mBufOffset, mBufEnd);
+        return;
+    }
+    if (!seekFile(mFile, offset))
+    {
+        mGood = false;
+        throw std::runtime_error("failed to seek in XDR file");
+    }
+    mBufOffset = offset;
+    mBufPos = mBufEnd = 0;
+}
+
+XDROutputFileStream::~XDROutputFileStream()
+{
+    if (mFile)
+    {
+        if (!flush(true) || !writeBlockIndex())
+        {
+            CLOG(ERROR, "Fs") << "failed to write XDR file on close, reason: "
+                              << errno;
+        }
+        std::fclose(mFile);
+    }
+}
+
+bool
+XDROutputFileStream::writeBlock(char const* data, size_t len)
+{
+#ifndef USE_ZLIB
+    return false;
+#else
+    mCompressedBuf.resize(8 + compressBound(static_cast<uLong>(len)));
+    uLongf compressedSize = static_cast<uLongf>(mCompressedBuf.size() - 8);
+    if (compress2(reinterpret_cast<Bytef*>(mCompressedBuf.data() + 8),
+                  &compressedSize, reinterpret_cast<Bytef const*>(data),
+                  static_cast<uLong>(len), Z_BEST_SPEED) != Z_OK)
+    {
+        return false;
+    }
+    putLE<uint32_t>(mCompressedBuf.data(),
+                    static_cast<uint32_t>(compressedSize));
+    putLE<uint32_t>(mCompressedBuf.data() + 4, static_cast<uint32_t>(len));
+    size_t total = 8 + static_cast<size_t>(compressedSize);
+    if (!writeFully(mFile, mCompressedBuf.data(), total))
+    {
+        return false;
+    }
+    mBlockOffsets.push_back(mRawOffset);
+    mBlockFileOffsets.push_back(mFileOffset);
+    mRawOffset += len;
+    mFileOffset += total;
+    return true;
+#endif
+}
+
+bool
+XDROutputFileStream::writeBlockIndex()
+{
+    if (!mCompressed)
+    {
+        return true;
+    }
+    size_t nBlocks = mBlockOffsets.size();
+    std::vector<char> trailer(16 * nBlocks + XDRBlockFormat::kTrailerSize);
+    for (size_t i = 0; i < nBlocks; ++i)
+    {
+        putLE<uint64_t>(trailer.data() + 16 * i, mBlockOffsets[i]);
+        putLE<uint64_t>(trailer.data() + 16 * i + 8, mBlockFileOffsets[i]);
+    }
+    putLE<uint64_t>(trailer.data() + 16 * nBlocks, nBlocks);
+    putLE<uint64_t>(trailer.data() + 16 * nBlocks + 8, mRawOffset);
+    return writeFully(mFile, trailer.data(), trailer.size());
+}
+
+bool
+XDROutputFileStream::flush(bool final)
+{
+    if (!mGood)
+    {
+        return false;
+    }
+    if (mCompressed)
+    {
+        size_t blockSize = XDRBlockFormat::kBlockSize;
+        size_t done = 0;
+        while (mBufPos - done >= blockSize || (final && mBufPos != done))
+        {
+            size_t len = std::min(blockSize, mBufPos - done);
+            if (!writeBlock(mBuf.data() + done, len))
+            {
+                mGood = false;
+                return false;
+            }
+            done += len;
+        }
+        std::memmove(mBuf.data(), mBuf.data() + done, mBufPos - done);
+        mBufPos -= done;
+        return true;
+    }
+    if (mBufPos != 0)
+    {
+        if (std::fwrite(mBuf.data(), 1, mBufPos, mFile) != mBufPos)
+        {
+            mGood = false;
+            return false;
+        }
+        mBufPos = 0;
+    }
+    return true;
+}
+
+void
+XDROutputFileStream::close()
+{
+    if (!mFile)
+    {
+        return;
+    }
+    bool ok = flush(true) && writeBlockIndex();
+    ok = (std::fclose(mFile) == 0) && ok;
+    mFile = nullptr;
+    mGood = false;
+    if (!ok)
+    {
+        std::string msg("failed to write XDR file, reason: ");
+        msg += std::to_string(errno);
+        CLOG(ERROR, "Fs") << msg;
+        throw std::runtime_error(msg);
+    }
+}
+
+void
+XDROutputFileStream::open(std::string const& filename, bool blockCompressed)
+{
+    close();
+#ifndef USE_ZLIB
+    if (blockCompressed)
+    {
+        throw std::runtime_error(
+            "can't write block-compressed XDR file without zlib: " + filename);
+    }
+#endif
+    try
+    {
+        mFile = openFile(filename, "wb");
+    }
+    catch (std::runtime_error& e)
+    {
+        CLOG(FATAL, "Fs") << e.what();
+        throw;
+    }
+    mBuf.resize(kBufferSize);
+    mBufPos = 0;
+    mGood = true;
+    mCompressed = blockCompressed;
+    mRawOffset = 0;
+    mFileOffset = 0;
+    mBlockOffsets.clear();
+    mBlockFileOffsets.clear();
+    if (mCompressed)
+    {
+        char header[XDRBlockFormat::kHeaderSize];
+        std::copy(XDRBlockFormat::kMagic, XDRBlockFormat::kMagic + 4, header);
+        putLE<uint32_t>(header + 4, XDRBlockFormat::kVersion);
+        mGood = writeFully(mFile, header, sizeof(header));
+        mFileOffset = sizeof(header);
+    }
+}
+}
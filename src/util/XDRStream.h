@@ -7,67 +7,152 @@
 #include "crypto/ByteSlice.h"
 #include "crypto/SHA.h"
 #include "util/Logging.h"
+#include "util/NonCopyable.h"
 #include "xdrpp/marshal.h"
-#include <fstream>
+#include <algorithm>
+#include <cstdio>
 #include <string>
 #include <vector>
 
 namespace stellar
 {
 
+/**
+ * Layout of block-compressed XDR files, an optional alternative to plain
+ * files of XDR records for files that are read back locally (see
+ * XDROutputFileStream::open). The stream of records is cut into blocks of
+ * kBlockSize bytes -- regardless of record boundaries -- and each block is
+ * compressed on its own, so a reader can start at any block.
+ *
+ *   header:  magic "XDRZ", then the format version, as a 32-bit word
+ *   blocks:  per block, its compressed and uncompressed sizes as 32-bit words,
+ *            then its compressed bytes
+ *   trailer: per block, its offset in the uncompressed stream and in the
+ *            file, as 64-bit words; then the number of blocks and the size of
+ *            the uncompressed stream, as 64-bit words
+ *
+ * All words are little-endian. Offsets seen by stream users are always
+ * offsets in the uncompressed stream, and anything hashed is always the
+ * uncompressed records, so whether a file is compressed is invisible outside
+ * the streams. A plain XDR file can never start with the magic, as its first
+ * byte is a record mark with the high bit set.
+ *
+ * Blocks are deflated with zlib, so builds without it (no USE_ZLIB) can
+ * neither write nor read these files; opening one throws.
+ */
+struct XDRBlockFormat
+{
+    static char const kMagic[4];
+    static uint32_t const kVersion;
+    static size_t const kBlockSize;
+    static size_t const kHeaderSize = 8;
+    static size_t const kTrailerSize = 16;
+
+    // Return true if `filename` is a block-compressed XDR file.
+    static bool isBlockCompressed(std::string const& filename);
+};
+
 /**
  * Helper for loading a sequence of XDR objects from a file one at a time,
  * rather than all at once.
+ *
+ * The file is read in large blocks into an internal buffer and records are
+ * decoded in place from that buffer, so reading a record normally costs no
+ * system call and no copy. Streams are assumed to be read mostly
+ * sequentially and say so to the OS where possible.
+ *
+ * Block-compressed files (see XDRBlockFormat) are recognized on open and
+ * inflated into the same buffer a block at a time; `pos` and `seek` then deal
+ * in offsets of the uncompressed stream.
  */
-class XDRInputFileStream
+class XDRInputFileStream : NonCopyable
 {
-    std::ifstream mIn;
+    std::FILE* mFile{nullptr};
     std::vector<char> mBuf;
+    // mBuf[mBufPos, mBufEnd) holds unread bytes; mBuf[0] is at byte
+    // mBufOffset of the (uncompressed) stream.
+    size_t mBufPos{0};
+    size_t mBufEnd{0};
+    size_t mBufOffset{0};
+    size_t mBufferSize{kDefaultBufferSize};
+    bool mGood{false};
     int mSizeLimit;
 
+    // For block-compressed files: the uncompressed and file offsets of each
+    // block, and the next block to inflate, which the file is positioned at.
+    bool mCompressed{false};
+    std::vector<uint64_t> mBlockOffsets;
+    std::vector<uint64_t> mBlockFileOffsets;
+    size_t mNextBlock{0};
+    std::vector<char> mCompressedBuf;
+
+    void readBlockIndex();
+    bool inflateNextBlock();
+
+    // Make at least `n` unread bytes available in mBuf, reading more of the
+    // file if necessary. Returns false if the file ends first.
+    bool
+    ensure(size_t n)
+    {
+        return (mBufEnd - mBufPos >= n) || fill(n);
+    }
+    bool fill(size_t n);
+
   public:
+    // Size of the read buffer of a stream, unless specified in `open`.
+    static size_t const kDefaultBufferSize;
+
     XDRInputFileStream(int sizeLimit = 0) : mSizeLimit{sizeLimit}
     {
     }
 
-    void
-    close()
+    ~XDRInputFileStream()
     {
-        mIn.close();
+        close();
     }
 
-    void
-    open(std::string const& filename)
+    void close();
+
+    // Open `filename`, plain or block-compressed, for reading, with a read
+    // buffer of `bufferSize` bytes (grown as needed to hold any single record
+    // or block).
+    void open(std::string const& filename,
+              size_t bufferSize = kDefaultBufferSize);
+
+    operator bool() const
     {
-        mIn.open(filename, std::ifstream::binary);
-        if (!mIn)
-        {
-            std::string msg("failed to open XDR file: ");
-            msg += filename;
-            msg += ", reason: ";
-            msg += std::to_string(errno);
-            CLOG(ERROR, "Fs") << msg;
-            throw std::runtime_error(msg);
-        }
+        return mGood;
     }
 
-    operator bool() const
+    // Return the byte offset of the next record to be read.
+    size_t
+    pos() const
     {
-        return mIn.good();
+        assert(mFile);
+        return mBufOffset + mBufPos;
     }
 
-    template <typename T>
+    // Reposition the stream at byte offset `offset`, which must be the start
+    // of a record (as previously returned by `pos`). Seeking within the
+    // current buffer does not touch the file.
+    void seek(size_t offset);
+
+    // Read the next record without decoding it. On success, points `rec` at
+    // the record -- its 4-byte record mark followed by its XDR -- in the
+    // stream's buffer and sets `len` to its total size. The record stays valid
+    // only until the stream is next read or repositioned.
     bool
-    readOne(T& out)
+    readRecord(char const*& rec, size_t& len)
     {
-        char szBuf[4];
-        if (!mIn.read(szBuf, 4))
+        if (!ensure(4))
         {
+            mGood = false;
             return false;
         }
 
         // Read 4 bytes of size, big-endian, with XDR 'continuation' bit cleared
         // (high bit of high byte).
+        char const* szBuf = mBuf.data() + mBufPos;
         uint32_t sz = 0;
         sz |= static_cast<uint8_t>(szBuf[0] & '\x7f');
         sz <<= 8;
@@ -79,88 +164,175 @@ class XDRInputFileStream
 
         if (mSizeLimit != 0 && sz > mSizeLimit)
         {
+            mGood = false;
             return false;
         }
-        if (sz > mBuf.size())
+        len = 4 + static_cast<size_t>(sz);
+        if (!ensure(len))
         {
-            mBuf.resize(sz);
+            mGood = false;
+            throw xdr::xdr_runtime_error("malformed XDR file");
         }
-        if (!mIn.read(mBuf.data(), sz))
+        rec = mBuf.data() + mBufPos;
+        mBufPos += len;
+        return true;
+    }
+
+    template <typename T>
+    bool
+    readOne(T& out)
+    {
+        char const* rec;
+        size_t len;
+        if (!readRecord(rec, len))
         {
-            throw xdr::xdr_runtime_error("malformed XDR file");
+            return false;
         }
-        xdr::xdr_get g(mBuf.data(), mBuf.data() + sz);
+        xdr::xdr_get g(rec + 4, rec + len);
         xdr::xdr_argpack_archive(g, out);
         return true;
     }
 };
 
-class XDROutputFileStream
+/**
+ * Helper for writing a sequence of XDR objects to a file one at a time.
+ *
+ * Records are serialized straight into an internal buffer, which is written
+ * to the file in large blocks as it fills and when the stream is closed.
+ */
+class XDROutputFileStream : NonCopyable
 {
-    std::ofstream mOut;
+    std::FILE* mFile{nullptr};
     std::vector<char> mBuf;
+    size_t mBufPos{0};
+    bool mGood{false};
 
-  public:
-    void
-    close()
+    // For block-compressed files: the uncompressed and file offsets of the
+    // next block to write, and of every block written so far.
+    bool mCompressed{false};
+    uint64_t mRawOffset{0};
+    uint64_t mFileOffset{0};
+    std::vector<uint64_t> mBlockOffsets;
+    std::vector<uint64_t> mBlockFileOffsets;
+    std::vector<char> mCompressedBuf;
+
+    // Write out the buffer. A block-compressed stream only writes whole
+    // blocks, keeping any remainder buffered, unless `final` is set.
+    bool flush(bool final = false);
+    bool writeBlock(char const* data, size_t len);
+    bool writeBlockIndex();
+
+    // Return space for a record of `len` bytes at the end of the buffer,
+    // flushing the buffer first if necessary, or nullptr if that fails.
+    char*
+    reserve(size_t len)
     {
-        mOut.close();
+        if (mBuf.size() - mBufPos < len)
+        {
+            if (!flush())
+            {
+                return nullptr;
+            }
+            if (mBuf.size() - mBufPos < len)
+            {
+                mBuf.resize(mBufPos + len);
+            }
+        }
+        return mBuf.data() + mBufPos;
     }
 
     void
-    open(std::string const& filename)
+    commit(char const* rec, size_t len, SHA256* hasher, size_t* bytesPut)
     {
-        mOut.open(filename, std::ofstream::binary | std::ofstream::trunc);
-        if (!mOut)
+        mBufPos += len;
+        if (hasher)
+        {
+            hasher->add(ByteSlice(rec, len));
+        }
+        if (bytesPut)
         {
-            std::string msg("failed to open XDR file: ");
-            msg += filename;
-            msg += ", reason: ";
-            msg += std::to_string(errno);
-            CLOG(FATAL, "Fs") << msg;
-            throw std::runtime_error(msg);
+            *bytesPut += len;
         }
     }
 
+  public:
+    // Size of the write buffer of a stream.
+    static size_t const kBufferSize;
+
+    ~XDROutputFileStream();
+
+    // Write any buffered records and close the file. Throws if the buffered
+    // records cannot be written.
+    void close();
+
+    // Open `filename` for writing. If `blockCompressed` is set, the file is
+    // written in the block-compressed format described at XDRBlockFormat,
+    // which only XDRInputFileStream can read back.
+    void open(std::string const& filename, bool blockCompressed = false);
+
     operator bool() const
     {
-        return mOut.good();
+        return mGood;
     }
 
+    // Serialize `t` as a single record -- a 4-byte record mark followed by
+    // its XDR -- into `rec`, which must have room for `sz + 4` bytes, where
+    // `sz` is `xdr::xdr_size(t)`.
     template <typename T>
-    bool
-    writeOne(T const& t, SHA256* hasher = nullptr, size_t* bytesPut = nullptr)
+    static void
+    encodeRecord(T const& t, uint32_t sz, char* rec)
     {
-        uint32_t sz = (uint32_t)xdr::xdr_size(t);
         assert(sz < 0x80000000);
 
-        if (mBuf.size() < sz + 4)
-        {
-            mBuf.resize(sz + 4);
-        }
-
         // Write 4 bytes of size, big-endian, with XDR 'continuation' bit set on
         // high bit of high byte.
-        mBuf[0] = static_cast<char>((sz >> 24) & 0xFF) | '\x80';
-        mBuf[1] = static_cast<char>((sz >> 16) & 0xFF);
-        mBuf[2] = static_cast<char>((sz >> 8) & 0xFF);
-        mBuf[3] = static_cast<char>(sz & 0xFF);
+        rec[0] = static_cast<char>((sz >> 24) & 0xFF) | '\x80';
+        rec[1] = static_cast<char>((sz >> 16) & 0xFF);
+        rec[2] = static_cast<char>((sz >> 8) & 0xFF);
+        rec[3] = static_cast<char>(sz & 0xFF);
 
-        xdr::xdr_put p(mBuf.data() + 4, mBuf.data() + 4 + sz);
+        xdr::xdr_put p(rec + 4, rec + 4 + sz);
         xdr_argpack_archive(p, t);
+    }
 
-        if (!mOut.write(mBuf.data(), sz + 4))
+    template <typename T>
+    static void
+    encodeRecord(T const& t, std::vector<char>& out)
+    {
+        uint32_t sz = (uint32_t)xdr::xdr_size(t);
+        out.resize(static_cast<size_t>(sz) + 4);
+        encodeRecord(t, sz, out.data());
+    }
+
+    template <typename T>
+    bool
+    writeOne(T const& t, SHA256* hasher = nullptr, size_t* bytesPut = nullptr)
+    {
+        uint32_t sz = (uint32_t)xdr::xdr_size(t);
+        size_t len = static_cast<size_t>(sz) + 4;
+        char* rec = reserve(len);
+        if (!rec)
         {
             return false;
         }
-        if (hasher)
-        {
-            hasher->add(ByteSlice(mBuf.data(), sz + 4));
-        }
-        if (bytesPut)
+        encodeRecord(t, sz, rec);
+        commit(rec, len, hasher, bytesPut);
+        return true;
+    }
+
+    // Write a record previously produced by `encodeRecord` or read by
+    // XDRInputFileStream::readRecord, as is.
+    bool
+    writeRecord(char const* data, size_t len, SHA256* hasher = nullptr,
+                size_t* bytesPut = nullptr)
+    {
+        char* rec = reserve(len);
+        if (!rec)
         {
-            *bytesPut += (sz + 4);
+            return false;
         }
+        std::copy(data, data + len, rec);
+        commit(rec, len, hasher, bytesPut);
         return true;
     }
 };